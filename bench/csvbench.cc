@@ -0,0 +1,153 @@
+// Benchmark: ascii kinematics parsing, fscanf vs. mapped strtod vs. fast parser
+// ------------------------------------------------------------------------
+//
+// Compile with makefile: make csvbench && ./bench/csvbench [N lines] [file]
+
+
+// C++
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+// Own
+#include "eventinput.h"
+
+
+// Write synthetic file in the printascii.cc layout
+bool WriteSynthetic(const std::string& filename, long N) {
+
+    FILE* fp = fopen(filename.c_str(), "w");
+    if (fp == NULL) {
+        printf("Cannot open output file: %s \n", filename.c_str());
+        return false;
+    }
+    std::mt19937_64 rng(12345);
+    std::normal_distribution<double> pt(0.0, 0.5);
+    std::normal_distribution<double> pz(0.0, 1.0);
+    std::uniform_real_distribution<double> flat(0.0, 1.0);
+
+    for (long k = 0; k < N; ++k) {
+        double p[NKIN];
+        for (int j = 0; j < 6; ++j) {
+            p[j] = (j % 3 == 2) ? pz(rng) : pt(rng);
+        }
+        const int reco = flat(rng) < 0.7;
+        for (int j = 0; j < 6; ++j) {
+            p[6 + j] = reco ? p[j] * (1.0 + 0.01 * pz(rng)) : -999.0;
+        }
+        const int pid = flat(rng) < 0.5 ? 211 : 321;
+        fprintf(fp, "%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%d,%d,%d\n",
+                p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7], p[8], p[9], p[10], p[11],
+                pid, -pid, reco);
+    }
+    fclose(fp);
+
+    return true;
+}
+
+// Order dependent checksum over all values, bitwise sensitive
+struct Checksum {
+    uint64_t h = 1469598103934665603ULL;
+    long n = 0;
+    void Add(const EventRecord& ev) {
+        for (int j = 0; j < NKIN; ++j) {
+            uint64_t bits;
+            std::memcpy(&bits, &ev.mom[j], sizeof(bits));
+            h = (h ^ bits) * 1099511628211ULL;
+        }
+        h = (h ^ (uint64_t)(ev.pidCode[0] * 7 + ev.pidCode[1] * 13 + ev.reco)) * 1099511628211ULL;
+        ++n;
+    }
+};
+
+double Seconds(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// The loop deeplot used originally
+Checksum RunFscanf(const std::string& filename) {
+
+    Checksum cs;
+    FILE* fp = fopen(filename.c_str(), "r");
+    if (fp == NULL) {
+        return cs;
+    }
+    EventRecord ev;
+    double* p = ev.mom;
+    while (fscanf(fp, "%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%d,%d,%d\n",
+                  &p[0], &p[1], &p[2], &p[3], &p[4], &p[5],
+                  &p[6], &p[7], &p[8], &p[9], &p[10], &p[11],
+                  &ev.pidCode[0], &ev.pidCode[1], &ev.reco) == 15) {
+        cs.Add(ev);
+    }
+    fclose(fp);
+
+    return cs;
+}
+
+Checksum RunMapped(const std::string& filename, bool fast) {
+
+    Checksum cs;
+    KinematicsInput input;
+    input.SetFastParse(fast);
+    if (!input.OpenFile(filename)) {
+        return cs;
+    }
+    EventBlock block;
+    EventRecord ev;
+    while (input.ReadBlock(block, 4096) > 0) {
+        for (size_t i = 0; i < block.n; ++i) {
+            block.Get(i, ev);
+            cs.Add(ev);
+        }
+    }
+    return cs;
+}
+
+
+int main(int argc, char* argv[]) {
+
+    const long N = (argc > 1) ? atol(argv[1]) : 10000000;
+    const std::string filename = (argc > 2) ? argv[2] : "./data/csvbench_synthetic.csv";
+
+    printf("Writing %ld synthetic lines to %s \n", N, filename.c_str());
+    if (!WriteSynthetic(filename, N)) {
+        return EXIT_FAILURE;
+    }
+
+    // Warm up the page cache so that all methods see the same conditions
+    RunMapped(filename, true);
+
+    auto t0 = std::chrono::steady_clock::now();
+    const Checksum ref = RunFscanf(filename);
+    const double t_fscanf = Seconds(t0);
+
+    t0 = std::chrono::steady_clock::now();
+    const Checksum slow = RunMapped(filename, false);
+    const double t_slow = Seconds(t0);
+
+    t0 = std::chrono::steady_clock::now();
+    const Checksum fast = RunMapped(filename, true);
+    const double t_fast = Seconds(t0);
+
+    printf("\n");
+    printf("%-24s %10s %12s %10s %s \n", "method", "time (s)", "Mlines/s", "speedup", "checksum");
+    printf("%-24s %10.3f %12.2f %10.2f %016lx \n", "fscanf",
+           t_fscanf, ref.n / t_fscanf / 1e6, 1.0, (unsigned long)ref.h);
+    printf("%-24s %10.3f %12.2f %10.2f %016lx \n", "mmap + strtod",
+           t_slow, slow.n / t_slow / 1e6, t_fscanf / t_slow, (unsigned long)slow.h);
+    printf("%-24s %10.3f %12.2f %10.2f %016lx \n", "mmap + SIMD fast path",
+           t_fast, fast.n / t_fast / 1e6, t_fscanf / t_fast, (unsigned long)fast.h);
+    printf("\n");
+
+    if (ref.n != N || slow.n != N || fast.n != N || ref.h != slow.h || ref.h != fast.h) {
+        printf("MISMATCH: parsed values differ from the fscanf reference! \n");
+        return EXIT_FAILURE;
+    }
+    printf("All parsers agree bitwise (%ld lines) \n", N);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,298 @@
+// Synthetic tree2track samples for the benchmarks
+// ------------------------------------------------------------------------
+//
+// Compile with makefile: make gentree && ./bench/gentree [-n <events per sample>] [--seed <seed>]
+//
+// Writes, in the current directory, for all samples of deeplot:
+//
+//   ./rootdata/<sample>.root  tree2track with the branches read by printascii
+//   ./data/<sample>.csv       fiducial events as written by printascii
+//   ./output/<sample>.out     efficiency of each fiducial event as written by deepnet.py
+//
+// Events are two-body decays of a central system (mass by sample type,
+// exponential P_T, flat rapidity) with an isotropic decay, reconstructed
+// with a smooth p_T turn-on efficiency and 1% momentum smearing. The .out
+// values are this efficiency, so the corrected histograms match the generated ones.
+
+
+// C++
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+// ROOT
+#include "TFile.h"
+#include "TTree.h"
+
+// Own
+#include "eventstore.h"
+#include "kinematics.h"
+#include "profiler.h"
+#include "selection.h"
+
+
+// Same samples as in deeplot and printascii
+const char* SAMPLES[] = {
+    "tree2track_kPipmExp", "tree2track_kPipmOrexp", "tree2track_kPipmPower", "tree2track_kCohRhoToPi",
+    "tree2track_kKpkmExp", "tree2track_kKpkmOrexp", "tree2track_kKpkmPower"
+};
+const int NSAMPLES = sizeof(SAMPLES) / sizeof(SAMPLES[0]);
+
+// Tree branches in EvtColumn order (as in treeinput.cc)
+const char* BRANCHES[] = {
+    "pxMc1", "pyMc1", "pzMc1",
+    "pxMc2", "pyMc2", "pzMc2",
+    "px1",   "py1",   "pz1",
+    "px2",   "py2",   "pz2"
+};
+
+ProfileStage stagegen("generate");
+ProfileStage stagetree("write tree");
+ProfileStage stagecsv("write csv");
+ProfileStage stageout("write out");
+
+
+// Track reconstruction efficiency (smooth p_T turn-on)
+double Efficiency(double pt) {
+    return 0.95 / (1.0 + std::exp(-(pt - 0.15) / 0.03));
+}
+
+// Generator of one sample
+class SampleGenerator {
+
+public:
+    SampleGenerator(const std::string& name, uint64_t seed) : rng_(seed) {
+        kaons_ = name.find("kKpkm") != std::string::npos;
+        rho_   = name.find("kCohRho") != std::string::npos;
+        power_ = name.find("Power") != std::string::npos;
+        orexp_ = name.find("Orexp") != std::string::npos;
+        mass_  = kaons_ ? mK : mPI;
+    }
+
+    // Generated and reconstructed momenta (float as in the tree), returns the efficiency
+    double Next(float* mom, int* pidCode) {
+
+        // System mass
+        const double threshold = 2.0 * mass_ + 1e-3;
+        double M = 0.0;
+        if (rho_) {
+            do {
+                M = 0.775 + 0.5 * 0.149 * std::tan(M_PI * (flat_(rng_) - 0.5)); // Breit-Wigner
+            } while (M < threshold || M > 3.0);
+        } else if (power_) {
+            M = threshold * std::pow(1.0 - flat_(rng_), -1.0 / 3.0);
+        } else if (orexp_) {
+            M = threshold + std::abs(normal_(rng_)) * 0.6;
+        } else {
+            M = threshold - 0.5 * std::log(1.0 - flat_(rng_));
+        }
+        M = std::min(M, 10.0);
+
+        // System P_T, azimuth and rapidity
+        const double Pt  = -(rho_ ? 0.1 : 0.3) * std::log(1.0 - flat_(rng_));
+        const double phi = 2.0 * M_PI * flat_(rng_);
+        const double Y   = 2.0 * flat_(rng_) - 1.0;
+        const double mT  = std::sqrt(M * M + Pt * Pt);
+        const double P[4] = {Pt * std::cos(phi), Pt * std::sin(phi), mT * std::sinh(Y), mT * std::cosh(Y)};
+
+        // Isotropic decay in the rest frame
+        const double pstar = std::sqrt(std::max(0.0, 0.25 * M * M - mass_ * mass_));
+        const double cost  = 2.0 * flat_(rng_) - 1.0;
+        const double sint  = std::sqrt(1.0 - cost * cost);
+        const double phid  = 2.0 * M_PI * flat_(rng_);
+        const double p[3]  = {pstar * sint * std::cos(phid), pstar * sint * std::sin(phid), pstar * cost};
+
+        // Boost to the lab
+        const double b[3]  = {P[0] / P[3], P[1] / P[3], P[2] / P[3]};
+        const double b2    = b[0] * b[0] + b[1] * b[1] + b[2] * b[2];
+        const double gamma = P[3] / M;
+        const double Estar = 0.5 * M;
+        double eff = 1.0;
+        for (int t = 0; t < 2; ++t) {
+            const double s  = (t == 0) ? 1.0 : -1.0;
+            const double bp = s * (b[0] * p[0] + b[1] * p[1] + b[2] * p[2]);
+            const double k  = ((b2 > 0) ? (gamma - 1.0) * bp / b2 : 0.0) + gamma * Estar;
+            for (int j = 0; j < 3; ++j) {
+                mom[3 * t + j] = s * p[j] + k * b[j];
+            }
+            eff *= Efficiency(std::sqrt(mom[3 * t] * mom[3 * t] + mom[3 * t + 1] * mom[3 * t + 1]));
+        }
+
+        // Reconstruction
+        const bool reco = flat_(rng_) < eff;
+        for (int j = 0; j < 6; ++j) {
+            mom[6 + j] = reco ? mom[j] * (1.0 + 0.01 * normal_(rng_)) : -999.0;
+        }
+        pidCode[0] = kaons_ ?  321 :  211;
+        pidCode[1] = kaons_ ? -321 : -211;
+
+        return eff;
+    }
+
+private:
+    std::mt19937_64 rng_;
+    std::uniform_real_distribution<double> flat_{0.0, 1.0};
+    std::normal_distribution<double> normal_{0.0, 1.0};
+    bool kaons_;
+    bool rho_;
+    bool power_;
+    bool orexp_;
+    double mass_;
+};
+
+
+// One sample to ./rootdata, ./data and ./output
+bool WriteSample(const std::string& name, long N, uint64_t seed, const Selection& fiducial) {
+
+    const std::string rootfile = "./rootdata/" + name + ".root";
+    const std::string csvfile  = "./data/" + name + ".csv";
+    const std::string outfile  = "./output/" + name + ".out";
+
+    TFile f(rootfile.c_str(), "RECREATE");
+    if (f.IsZombie()) {
+        printf("Cannot open output file: %s \n", rootfile.c_str());
+        return false;
+    }
+    FILE* csv = fopen(csvfile.c_str(), "w");
+    FILE* out = fopen(outfile.c_str(), "w");
+    if (csv == NULL || out == NULL) {
+        printf("Cannot open output files: %s, %s \n", csvfile.c_str(), outfile.c_str());
+        if (csv != NULL) { fclose(csv); }
+        if (out != NULL) { fclose(out); }
+        return false;
+    }
+
+    float mom[NKIN];
+    int pidCode[2];
+    Long64_t eventNumber = 0;
+    TTree tree("tree2track", "Synthetic two-track events");
+    for (int j = 0; j < NKIN; ++j) {
+        tree.Branch(BRANCHES[j], &mom[j], (std::string(BRANCHES[j]) + "/F").c_str());
+    }
+    tree.Branch("pidCode1", &pidCode[0], "pidCode1/I");
+    tree.Branch("pidCode2", &pidCode[1], "pidCode2/I");
+    tree.Branch("eventNumber", &eventNumber, "eventNumber/L"); // Not read by printascii
+
+    SampleGenerator gen(name, seed);
+    long naccepted = 0;
+    const long BLOCK = 4096;
+    for (long k0 = 0; k0 < N; k0 += BLOCK) {
+        const long n = std::min(BLOCK, N - k0);
+        std::vector<float> moms(n * NKIN);
+        std::vector<int> pids(2 * n);
+        std::vector<double> effs(n);
+        {
+            ScopedTimer timer(stagegen);
+            for (long i = 0; i < n; ++i) {
+                effs[i] = gen.Next(&moms[i * NKIN], &pids[2 * i]);
+            }
+            timer.Add(n);
+        }
+        {
+            ScopedTimer timer(stagetree);
+            for (long i = 0; i < n; ++i) {
+                std::copy(&moms[i * NKIN], &moms[(i + 1) * NKIN], mom);
+                pidCode[0]  = pids[2 * i];
+                pidCode[1]  = pids[2 * i + 1];
+                eventNumber = k0 + i;
+                tree.Fill();
+            }
+            timer.Add(n);
+        }
+
+        // Fiducial events as printascii writes them, with their weights
+        ScopedTimer csvtimer(stagecsv);
+        long bytes = 0;
+        long m = 0;
+        std::vector<double> weights;
+        for (long i = 0; i < n; ++i) {
+            const float* p = &moms[i * NKIN];
+            const double t1[3] = {p[PX1_GEN], p[PY1_GEN], p[PZ1_GEN]};
+            const double t2[3] = {p[PX2_GEN], p[PY2_GEN], p[PZ2_GEN]};
+            if (!fiducial.Pass(t1, t2)) {
+                continue;
+            }
+            const int reco = (p[PX1_REC] > -999 && p[PX2_REC] > -999) ? 1 : 0;
+            bytes += fprintf(csv, "%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%d,%d,%d\n",
+                (double)p[0], (double)p[1], (double)p[2], (double)p[3], (double)p[4], (double)p[5],
+                (double)p[6], (double)p[7], (double)p[8], (double)p[9], (double)p[10], (double)p[11],
+                pids[2 * i], pids[2 * i + 1], reco);
+            weights.push_back(effs[i]);
+            ++m;
+        }
+        csvtimer.Add(m, bytes);
+        naccepted += m;
+
+        ScopedTimer outtimer(stageout);
+        long outbytes = 0;
+        for (size_t i = 0; i < weights.size(); ++i) {
+            outbytes += fprintf(out, "%0.6f \n", weights[i]);
+        }
+        outtimer.Add(weights.size(), outbytes);
+    }
+
+    bool ok = true;
+    {
+        ScopedTimer timer(stagetree);
+        ok = tree.Write() > 0;
+        f.Close();
+    }
+    ok = (fclose(csv) == 0) && ok;
+    ok = (fclose(out) == 0) && ok;
+
+    printf("%s:: Events = %ld, within fiducial = %ld \n", name.c_str(), N, naccepted);
+
+    return ok;
+}
+
+
+// Main function
+int main(int argc, char* argv[]) {
+
+    const long t0 = ProfileNow();
+
+    long N = 200000;
+    uint64_t seed = 12345;
+    std::string profilefile;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "-n" && i + 1 < argc) {
+            N = std::max(0L, atol(argv[++i]));
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--profile" && i + 1 < argc) {
+            profilefile = argv[++i];
+        } else {
+            printf("Usage: ./gentree [-n <events per sample>] [--seed <seed>] [--profile <file.json>] \n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    // The same cuts as printascii
+    Selection fiducial;
+    if (!fiducial.LoadDefault()) {
+        return EXIT_FAILURE;
+    }
+    fiducial.Print();
+
+    for (const char* dir : {"./rootdata", "./data", "./output"}) {
+        std::filesystem::create_directories(dir);
+    }
+
+    bool ok = true;
+    for (int s = 0; s < NSAMPLES && ok; ++s) {
+        ok = WriteSample(SAMPLES[s], N, seed + s, fiducial);
+    }
+
+    PrintProfile("gentree", ProfileNow() - t0);
+    if (!profilefile.empty()) {
+        WriteProfileJSON(profilefile, "gentree", ProfileNow() - t0);
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
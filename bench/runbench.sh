@@ -0,0 +1,37 @@
+#!/bin/bash
+#
+# Benchmark of printascii and deeplot on synthetic tree2track samples
+#
+# Run with: make bench [BENCH_EVENTS=<events per sample>] [BENCH_THREADS=<threads>]
+# or:       bench/runbench.sh [events per sample] [threads]
+#
+# Samples are generated in ./bench/work, the JSON stage reports go to
+# ./bench/results/<host>_<UTC time>/{gentree,printascii,deeplot}.json:
+# printascii (tree read, selection, .evt/.csv writing), the deeplot
+# kinematics read, the event loop (compute, fill) and the figures (render).
+
+set -e
+
+EVENTS=${1:-200000}
+THREADS=${2:-1}
+
+TOPDIR=$(cd "$(dirname "$0")/.." && pwd)
+WORKDIR=$TOPDIR/bench/work
+OUTDIR=$TOPDIR/bench/results/$(hostname -s)_$(date -u +%Y%m%dT%H%M%SZ)
+
+mkdir -p $WORKDIR $OUTDIR
+cp $TOPDIR/fiducial.cfg $WORKDIR/
+cd $WORKDIR
+
+echo "Benchmark: $EVENTS events per sample, $THREADS threads, results in $OUTDIR"
+
+# 1. Synthetic ROOT trees and weights
+$TOPDIR/bench/gentree -n $EVENTS --profile $OUTDIR/gentree.json
+
+# 2. Trees to the event store (and csv)
+$TOPDIR/printascii -t $THREADS --profile $OUTDIR/printascii.json
+
+# 3. Event loop and figures, observables always recomputed
+$TOPDIR/deeplot -t $THREADS --nocache --profile $OUTDIR/deeplot.json
+
+echo "Benchmark results: $OUTDIR"
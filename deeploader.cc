@@ -0,0 +1,136 @@
+// Training and prediction input for deepnet.py as numpy wrappable buffers
+// ------------------------------------------------------------------------
+//
+// Compile with makefile: make deeploader (-> ./deeploader.so, no ROOT needed)
+//
+// C interface for ctypes. The event store (or csv) is memory mapped and the
+// GEN or REC momenta and reco labels of the events are gathered into
+// contiguous float32 arrays, features[n][6] and labels[n][1], which numpy
+// wraps without a copy (np.ctypeslib.as_array). The arrays live until
+// deeploader_free() of the handle.
+
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Own
+#include "include/eventinput.h"
+#include "include/selection.h"
+#include "src/csvparse.cc" // Compiled as a single unit (as printascii.cc)
+#include "src/eventinput.cc"
+#include "src/eventstore.cc"
+#include "src/mmapfile.cc"
+#include "src/selection.cc"
+
+
+// Network input dimension (as in deepnet.py)
+const int NDIM = 6;
+
+// Loaded data
+struct DeepData {
+    std::vector<float> features; // [n][NDIM]
+    std::vector<float> labels;   // [n]
+};
+
+
+// Name ends with ext
+static bool HasExtension(const std::string& name, const std::string& ext) {
+    return name.size() > ext.size() && name.compare(name.size() - ext.size(), ext.size(), ext) == 0;
+}
+
+
+extern "C" {
+
+// Read ./data/<name>.{evt,csv} (or a file ending in .evt or .csv), readmode "GEN" or "REC",
+// at most maxcount events passing the cuts of cutfile (no cuts if empty),
+// returns nullptr on error
+DeepData* deeploader_load(const char* name, const char* readmode, long long maxcount, const char* cutfile) {
+
+    const auto t0 = std::chrono::steady_clock::now();
+
+    const std::string mode = (readmode != nullptr) ? readmode : "GEN";
+    if (mode != "GEN" && mode != "REC") {
+        printf("DeepLoader:: Unknown readmode %s (GEN or REC) \n", mode.c_str());
+        return nullptr;
+    }
+    const int first = (mode == "GEN") ? PX1_GEN : PX1_REC;
+
+    Selection selection;
+    const bool select = (cutfile != nullptr && cutfile[0] != '\0');
+    if (select && !selection.Load(cutfile)) {
+        return nullptr;
+    }
+
+    KinematicsInput input;
+    const std::string filename = (name != nullptr) ? name : "";
+    const bool isfile = HasExtension(filename, ".evt") || HasExtension(filename, ".csv");
+    const bool ok = isfile ? input.OpenFile(filename) : input.Open(filename);
+    if (!ok) {
+        printf("DeepLoader:: Cannot open input: %s \n", filename.c_str());
+        return nullptr;
+    }
+    const uint64_t limit = (maxcount < 0) ? UINT64_MAX : (uint64_t)maxcount;
+
+    DeepData* data = new DeepData();
+    if (input.GetEntries() > 0) {
+        const uint64_t n = std::min(limit, input.GetEntries());
+        data->features.reserve(n * NDIM);
+        data->labels.reserve(n);
+    }
+
+    EventBlock block;
+    std::vector<unsigned char> mask;
+    uint64_t n = 0;
+    while (n < limit) {
+        const size_t m = input.ReadBlock(block, select ? EVT_CHUNKSIZE : std::min<uint64_t>(EVT_CHUNKSIZE, limit - n));
+        if (m == 0) {
+            break;
+        }
+        mask.assign(m, 1);
+        if (select) {
+            selection.Select(block, mask.data(), PX1_GEN);
+        }
+        for (size_t i = 0; i < m && n < limit; ++i) {
+            if (!mask[i]) {
+                continue;
+            }
+            for (int k = 0; k < NDIM; ++k) {
+                data->features.push_back(block.mom[first + k][i]);
+            }
+            data->labels.push_back(block.reco[i]);
+            ++n;
+        }
+    }
+    if (input.Error()) {
+        printf("DeepLoader:: Error in reading: %s \n", input.GetFilename().c_str());
+        delete data;
+        return nullptr;
+    }
+
+    const double dt = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    printf("DeepLoader:: %lu events (%s) from %s in %0.2f sec \n", (unsigned long)n, mode.c_str(),
+           input.GetFilename().c_str(), dt);
+
+    return data;
+}
+
+long long deeploader_count(const DeepData* data) {
+    return (data != nullptr) ? data->labels.size() : 0;
+}
+
+float* deeploader_features(DeepData* data) {
+    return (data != nullptr) ? data->features.data() : nullptr;
+}
+
+float* deeploader_labels(DeepData* data) {
+    return (data != nullptr) ? data->labels.data() : nullptr;
+}
+
+void deeploader_free(DeepData* data) {
+    delete data;
+}
+
+}
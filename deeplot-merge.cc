@@ -0,0 +1,155 @@
+// Merge partial deeplot histograms (--first/--count, --shard) of a sample
+// ------------------------------------------------------------------------
+//
+// Compile with makefile: make deeplot-merge
+//
+// ./deeplot-merge [--noplots] [--render <processes>] <sample> [partial directories]
+//
+// Without directories, all ./figs/<sample>/partial_* are merged. The merged
+// histograms, chi2 values and figures are written to ./figs/<sample>/ as by
+// a single deeplot run over the full sample.
+
+
+#include <algorithm>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ROOT
+#include "TH1.h"
+#include "TROOT.h"
+
+// Own classes
+#include "histset.h"
+#include "plotstyle.h"
+#include "render.h"
+
+
+// Main function
+int main(int argc, char* argv[]) {
+
+    bool plots  = true;
+    int nrender = std::max(1u, std::thread::hardware_concurrency());
+    std::string sample;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--noplots") {
+            plots = false;
+        } else if (arg == "--render" && i + 1 < argc) {
+            nrender = std::max(1, atoi(argv[++i]));
+        } else if (!arg.empty() && arg[0] != '-') {
+            if (sample.empty()) {
+                sample = arg;
+            } else {
+                paths.push_back(arg);
+            }
+        } else {
+            sample.clear();
+            break;
+        }
+    }
+    if (sample.empty()) {
+        printf("Usage: ./deeplot-merge [--noplots] [--render <processes>] <sample> [partial directories] \n");
+        return EXIT_FAILURE;
+    }
+
+    // Default: all partial results of the sample
+    const std::string outpath = "./figs/" + sample;
+    if (paths.empty()) {
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(outpath, ec)) {
+            if (entry.is_directory() && entry.path().filename().string().rfind("partial_", 0) == 0) {
+                paths.push_back(entry.path().string());
+            }
+        }
+        std::sort(paths.begin(), paths.end());
+    }
+    if (paths.empty()) {
+        printf("No partial histograms in: %s \n", outpath.c_str());
+        return EXIT_FAILURE;
+    }
+
+    TH1::AddDirectory(kFALSE);
+    gROOT->SetBatch(kTRUE);
+    SetPlotStyle();
+
+    // Read and add all parts, in the order of their event ranges
+    std::vector<std::unique_ptr<HistSet>> parts;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        parts.push_back(std::unique_ptr<HistSet>(new HistSet(sample, BACKEND_ROOT)));
+        if (!parts.back()->Read(paths[i])) {
+            printf("Cannot read partial histograms: %s \n", paths[i].c_str());
+            return EXIT_FAILURE;
+        }
+    }
+    std::stable_sort(parts.begin(), parts.end(),
+        [](const std::unique_ptr<HistSet>& a, const std::unique_ptr<HistSet>& b) {
+            return a->counters.first < b->counters.first;
+        });
+
+    // Bootstrap replicas and models of the first part, parts with others are refused
+    std::shared_ptr<HistSet> histptr(new HistSet(sample, BACKEND_ROOT));
+    HistSet& hist = *histptr;
+    hist.EnableBootstrap(parts.front()->GetNBootstrap(), parts.front()->GetBootstrapSeed());
+    hist.SetModels(parts.front()->GetModels());
+    SampleCounters& sum = hist.counters;
+    sum.total = parts.front()->counters.total;
+
+    bool complete = true;
+    for (size_t i = 0; i < parts.size(); ++i) {
+        const SampleCounters& c = parts[i]->counters;
+        printf("%s:: Part %lu: events [%llu, %llu), within fiducial = %llu \n", sample.c_str(), (unsigned long)i,
+               (unsigned long long)c.first, (unsigned long long)(c.first + c.nentries), (unsigned long long)c.nfiducial);
+        if (c.total != sum.total) {
+            printf("%s:: Part %lu is from a sample of %llu events, not %llu \n", sample.c_str(), (unsigned long)i,
+                   (unsigned long long)c.total, (unsigned long long)sum.total);
+            complete = false;
+        }
+        if (c.first != sum.nentries) {
+            printf("%s:: %s at event %llu \n", sample.c_str(), (c.first > sum.nentries) ? "Gap" : "Overlap",
+                   (unsigned long long)sum.nentries);
+            complete = false;
+        }
+        if (!hist.Add(*parts[i])) {
+            printf("%s:: Part %lu was run with other bootstrap replicas or models than part 0, nothing merged \n",
+                   sample.c_str(), (unsigned long)i);
+            return EXIT_FAILURE;
+        }
+        sum.nentries   = std::max<uint64_t>(sum.nentries, c.first + c.nentries);
+        sum.nfiducial += c.nfiducial;
+    }
+    if (sum.nentries != sum.total) {
+        printf("%s:: Parts cover events [0, %llu) of %llu \n", sample.c_str(),
+               (unsigned long long)sum.nentries, (unsigned long long)sum.total);
+        complete = false;
+    }
+    if (!complete) {
+        printf("%s:: WARNING: merged result does not match a single run over the sample \n", sample.c_str());
+    }
+    printf("%s:: Events read = %llu, within fiducial = %llu \n", sample.c_str(),
+           (unsigned long long)sum.nentries, (unsigned long long)sum.nfiducial);
+
+    hist.Chi2();
+    if (!hist.Write(outpath)) {
+        return EXIT_FAILURE;
+    }
+
+    if (plots) {
+        RenderQueue renderqueue;
+        for (size_t i = 0; i < hist.GetNFigures(); ++i) {
+            renderqueue.Push([histptr, i]() {
+                histptr->SaveFig(i);
+            });
+        }
+        printf("Rendering %lu figures with %d processes \n", (unsigned long)renderqueue.Size(), nrender);
+        if (!renderqueue.Run(nrender)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return complete ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -7,10 +7,20 @@
 // mikael.mieskolainen@cern.ch, 23/07/2018
 
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
 #include <iostream>
-#include <fstream>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
 
 // ROOT
 #include "TLorentzVector.h"
@@ -23,45 +33,319 @@
 
 // Own classes
 #include "tripletclass.h"
+#include "histset.h"
+#include "eventinput.h"
+#include "kinematics.h"
+#include "mlp.h"
+#include "obscache.h"
+#include "pipeline.h"
+#include "plotstyle.h"
+#include "profiler.h"
+#include "render.h"
+#include "selection.h"
+#include "treeinput.h"
+#include "weightstore.h"
 
 
-const double PI = 3.14159265359;
-
 // Maximum event count cut (for quick testing)
 const int MAXEVENTS = 100000000;
 
-
-// Particle mass
-const double mPI = 0.139570;
-const double mK  = 0.493677;
+// Number of events read at a time by one worker
+const size_t BLOCKSIZE = 4096;
 
 
 // ****************** FIDUCIAL DEFINITION ******************
 // We cut events here for the DeepEfficiency training phase
 // Note that these should be kept the same as in the training
-// phase, or more tight.
-const double FID_PT  = 0.1; // track pt
-const double FID_ETA = 0.9; // track eta
+// phase, or more tight. Cuts are read from ./fiducial.cfg
+// (or --cuts <file>), shared with printascii.
+Selection fiducial;
+std::string cutfile; // --cuts, ./fiducial.cfg (or the built-in default) if empty
+
+// Cuts of printascii (./fiducial.cfg), which define the events of ./data/<sample>
+// and thus the event index of the weights. The --root tree reader applies these,
+// --cuts are applied after the weights are joined, as with the ./data input.
+Selection preselection;
 // *********************************************************
 
 
-bool Processor(const std::string& PREDICTFILE);
-void SetROOTStyle();
-void SetPlotStyle();
-void PlotFilled(TH1D* h1, std::string& name, bool logscale, bool normalize);
-bool ReadKinematics(TLorentzVector& p1_gen, TLorentzVector& p2_gen,
-                    TLorentzVector& p1_rec, TLorentzVector& p2_rec, int& reco);
-
-
-// Kinematic input
-FILE* fp;
+// One DeepEfficiency model of a sample: a network evaluated here, binary weights
+// by event index (./output/<stem>.wgt and shards) or ascii weights (./output/<stem>.out)
+struct WeightSource {
+    std::string label;
+    MLP network;
+    bool evaluate = false;      // Evaluate network instead of reading weights
+    WeightStoreReader weightstore;
+    bool keyed = false;
+    long nmissing = 0;          // Events read without a weight
+    WeightInput deepnetfile;
+    bool weightsdone = false;   // Weights exhausted
+};
+
+// Shared input of one sample, read block by block by the workers
+struct SampleInput {
+    KinematicsInput kinematics;
+    uint64_t kinematicshash = 0; // HashFile() of the kinematics, see SampleHash()
+
+    // Efficiency models, all filled from the same events (with a weight from each)
+    std::vector<std::unique_ptr<WeightSource>> sources;
+
+    // ROOT tree input (--root), cuts of printascii applied by the reader
+    TreeInput tree;
+    EventBlock treeblock;
+    size_t treepos = 0;
+    std::vector<unsigned char> treemask;
+    bool preselected = false;
+    bool counting    = false;  // Read the tree to the end for CheckTreeAlignment()
+    long npreselected = 0;     // Events passed by the tree reader
+
+    // Observable cache, read instead of the kinematics (cached) or written
+    // alongside the event loop (caching)
+    ObsCacheReader cacheread;
+    ObsCacheWriter cachewrite;
+    bool cached   = false;
+    bool caching  = false;
+    bool complete = false;    // End of the kinematics reached without errors
+
+    std::mutex mutex;
+    long nread  = 0;     // Events read so far
+    long nlimit = -1;    // Events in the range (--first/--count, --shard), -1 for all
+    bool done  = false;  // End of input (or error) reached
+
+    // Validation counters
+    std::atomic<long> nchecked{0};
+    std::atomic<long> nmismatch{0};
+};
+
+// One block of events with its work buffers, reused from block to block
+struct Batch {
+    uint64_t seq = 0;            // Block index in the input (pipeline order)
+    EventBlock block;
+    std::vector<std::vector<double>> weights; // DeepEfficiency output per model and event
+    std::vector<unsigned char> hasweight; // Events of the block with a weight from all models (filled)
+    std::vector<unsigned char> found;
+
+    // Network input and output
+    std::vector<float> features;
+    std::vector<float> output;
+    MLPWorkspace workspace;
+
+    // Track masses
+    std::vector<double> mass1;
+    std::vector<double> mass2;
+
+    // Observables of the block, compacted to the m fiducial events
+    ObservablesBlock gen;
+    ObservablesBlock rec;
+    std::vector<unsigned char> fiducial;
+    std::vector<unsigned char> reco;
+    std::vector<std::vector<double>> weight; // Inverse efficiency per model
+    std::vector<uint64_t> index; // Event index in the sample (bootstrap key)
+    std::vector<uint64_t> entry; // Tree entry of each event of the block (--root)
+    size_t m = 0;
+};
+
+// Chi2 printout of one sample in one piece
+std::mutex outputmutex;
+
+// Figures are rendered after all samples by nrender worker processes
+// (ROOT graphics is not thread safe), none with --noplots
+RenderQueue renderqueue;
+bool plots  = true;
+int nrender = std::max(1u, std::thread::hardware_concurrency());
+
+// Only re-plot from ./figs/<sample>/histograms.root (no event loop)
+bool replot = false;
+
+// Histogram filling backend
+HistBackend backend = BACKEND_ROOT;
+
+// Streaming pipeline (reader, compute and fill stages) instead of
+// per-thread event loops
+bool pipeline = false;
+
+// Check the observables kernel against TLorentzVector
+bool validate = false;
+const double KIN_TOL = 1e-9; // Relative tolerance
+
+// Evaluate DeepEfficiency network here (./modelsave/DEEPNET_<model>.mlp)
+// instead of reading ./output/<sample>.out
+bool inference = false;
+const int NDIM = 6; // Network input dimension (as in deepnet.py)
+
+// Stage timing, summary at exit and a JSON report with --profile <file>
+ProfileStage stageread("read");
+ProfileStage stagecompute("compute");
+ProfileStage stagefill("fill");
+ProfileStage stagemerge("merge");
+ProfileStage stagechi2("chi2");
+ProfileStage stagewrite("write");
+ProfileStage stagerender("render");
+std::string profilefile;
+
+// Sample -> trained network
+std::map<std::string, std::string> models;
+
+// Efficiency models compared in one event pass (--models a,b,...), "default" is the
+// network above with --mlp, or ./output/<sample>.{wgt,out}; other names are networks
+// ./modelsave/DEEPNET_<name>.mlp with --mlp, or weights ./output/<sample>.<name>.{wgt,out}
+std::vector<std::string> sourcenames = {"default"};
+
+// Poisson bootstrap replicas of the reconstructed and corrected histograms
+// (--bootstrap <R>), 0 for none
+int nbootstrap = 0;
+
+// Read ./rootdata/<sample>.root trees directly instead of ./data/<sample>.{evt,csv}
+bool rootinput = false;
+
+// Reuse observables from ./cache/<sample>.obs when the kinematics, masses and
+// cuts are unchanged (only with ./output weights)
+bool obscache = true;
+
+// Event range of this job (--first/--count or --shard i/N). Histograms and
+// counters go to ./figs/<sample>/partial_<first>/, combined by deeplot-merge.
+bool partial = false;
+uint64_t rangefirst = 0;
+int64_t rangecount  = -1; // To the end
+int shard   = 0;
+int nshards = 0;
+
+bool Processor(const std::string& PREDICTFILE, int nthreads);
+bool OpenSource(WeightSource& source, const std::string& PREDICTFILE, const std::string& name,
+                SampleInput& input);
+uint64_t SampleHash(SampleInput& input);
+bool Replot(const std::string& PREDICTFILE);
+void EventRange(uint64_t total, uint64_t& first, uint64_t& count);
+bool WriteHistograms(const HistSet& hist, const std::string& path, bool chi2 = true);
+uint64_t InputOffset(const SampleInput& input);
+void QueueFigures(const std::shared_ptr<HistSet>& hist);
+void RunSamples(const std::vector<std::string>& filenames, int njobs, int nthreads);
+long EventLoop(SampleInput& input, HistSet& hist);
+long PipelineLoop(SampleInput& input, HistSet& hist, int nworkers);
+void ComputeBatch(SampleInput& input, Batch& batch);
+void FillHistograms(HistSet& hist, const Batch& batch);
+bool ReadBlock(SampleInput& input, Batch& batch);
+size_t ReadTreeBlock(SampleInput& input, EventBlock& block, std::vector<uint64_t>& entry, size_t maxn);
+bool CheckTreeAlignment(const SampleInput& input, const std::string& PREDICTFILE);
+long ValidateObservables(const EventBlock& block, const ObservablesBlock& gen, const ObservablesBlock& rec);
+long ValidateSelection();
+void ReadKinematics(const EventRecord& ev, TLorentzVector& p1_gen, TLorentzVector& p2_gen,
+                    TLorentzVector& p1_rec, TLorentzVector& p2_rec);
+void GetObservables(const TLorentzVector& p1, const TLorentzVector& p2, Observables& obs);
 
 
 // Main function
-int main(void) {
+int main(int argc, char* argv[]) {
+
+    const long t0 = ProfileNow();
+
+    // Number of samples processed concurrently and event loop threads per sample
+    int njobs    = 1;
+    int nthreads = 1;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if ((arg == "-j" || arg == "--jobs") && i + 1 < argc) {
+            njobs = std::max(1, atoi(argv[++i]));
+        } else if ((arg == "-t" || arg == "--threads") && i + 1 < argc) {
+            nthreads = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--native") {
+            backend = BACKEND_NATIVE;
+        } else if (arg == "--validate") {
+            validate = true;
+        } else if (arg == "--mlp") {
+            inference = true;
+        } else if (arg == "--pipeline") {
+            pipeline = true;
+        } else if (arg == "--root") {
+            rootinput = true;
+        } else if (arg == "--cuts" && i + 1 < argc) {
+            cutfile = argv[++i];
+        } else if (arg == "--noplots") {
+            plots = false;
+        } else if (arg == "--render" && i + 1 < argc) {
+            nrender = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--replot") {
+            replot = true;
+        } else if (arg == "--profile" && i + 1 < argc) {
+            profilefile = argv[++i];
+        } else if (arg == "--bootstrap" && i + 1 < argc) {
+            nbootstrap = std::max(0, atoi(argv[++i]));
+        } else if (arg == "--models" && i + 1 < argc) {
+            sourcenames.clear();
+            std::istringstream names(argv[++i]);
+            std::string name;
+            while (std::getline(names, name, ',')) {
+                if (!name.empty()) {
+                    sourcenames.push_back(name);
+                }
+            }
+            if (sourcenames.empty()) {
+                printf("Bad --models %s, expected a comma separated list \n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        } else if (arg == "--nocache") {
+            obscache = false;
+        } else if (arg == "--first" && i + 1 < argc) {
+            rangefirst = strtoull(argv[++i], nullptr, 10);
+            partial = true;
+        } else if (arg == "--count" && i + 1 < argc) {
+            rangecount = std::max(0LL, atoll(argv[++i]));
+            partial = true;
+        } else if (arg == "--shard" && i + 1 < argc) {
+            if (sscanf(argv[++i], "%d/%d", &shard, &nshards) != 2 || nshards < 1 || shard < 0 || shard >= nshards) {
+                printf("Bad --shard %s, expected i/N with 0 <= i < N \n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            partial = true;
+        } else {
+            printf("Usage: ./deeplot [-j|--jobs <samples in parallel>] [-t|--threads <threads per sample>] [--native] [--validate] [--mlp] [--pipeline] [--root] [--cuts <file>] [--noplots] [--render <processes>] [--replot] [--bootstrap <replicas>] [--models <a,b,...>] [--nocache] [--profile <file.json>] [--first <event> --count <events> | --shard <i/N>] \n");
+            return EXIT_FAILURE;
+        }
+    }
+    if (nshards > 0 && (rangefirst > 0 || rangecount >= 0)) {
+        printf("Use either --first/--count or --shard \n");
+        return EXIT_FAILURE;
+    }
+    if (partial && replot) {
+        printf("--replot reads the merged histograms, no event range \n");
+        return EXIT_FAILURE;
+    }
+    if (partial && rootinput && !inference) {
+        // ./output weights are per fiducial event, not per tree entry
+        printf("Event ranges with --root need the weights evaluated here (--mlp) \n");
+        return EXIT_FAILURE;
+    }
+
+    // Fiducial cuts
+    if (!(cutfile.empty() ? fiducial.LoadDefault() : fiducial.Load(cutfile))) {
+        return EXIT_FAILURE;
+    }
+    fiducial.Print();
+    if (rootinput && !cutfile.empty()) {
+        if (!preselection.LoadDefault()) {
+            return EXIT_FAILURE;
+        }
+        printf("Tree events preselected with the cuts of printascii: \n");
+        preselection.Print();
+    } else {
+        preselection = fiducial;
+    }
+    if (validate && ValidateSelection() > 0) {
+        return EXIT_FAILURE;
+    }
 
+    // Global ROOT setup, done once before any threads are started.
+    // Histograms are owned by us, not by the current ROOT directory.
+    TH1::AddDirectory(kFALSE);
+    if (njobs > 1 || nthreads > 1 || pipeline || rootinput) {
+        ROOT::EnableThreadSafety();
+    }
+    gROOT->SetBatch(kTRUE);
     SetPlotStyle();
 
+    // Output directory
+    std::filesystem::create_directories("./figs");
+
     std::vector<std::string> filenames;
     filenames.push_back("tree2track_kPipmExp");
     filenames.push_back("tree2track_kPipmOrexp");
@@ -72,326 +356,1032 @@ int main(void) {
     filenames.push_back("tree2track_kKpkmOrexp");
     filenames.push_back("tree2track_kKpkmPower");
 
+    // Trained networks (same as in predict.sh)
+    for (uint i = 0; i < filenames.size(); ++i) {
+        const bool kaons = filenames.at(i).find("kKpkm") != std::string::npos;
+        models[filenames.at(i)] = kaons ? "tree2track_kKpkm" : "tree2track_kPipm";
+    }
+
+    if (replot) {
+        for (uint i = 0; i < filenames.size(); ++i) {
+            if (!Replot(filenames.at(i))) {
+                printf("Replot failed for sample: %s \n", filenames.at(i).c_str());
+            }
+        }
+    } else {
+        RunSamples(filenames, njobs, nthreads);
+    }
+
+    // All event loop threads are done here, partial results are plotted by deeplot-merge
+    bool ok = true;
+    if (plots && !partial) {
+        printf("Rendering %lu figures with %d processes \n", (unsigned long)renderqueue.Size(), nrender);
+        ScopedTimer timer(stagerender);
+        timer.Add(renderqueue.Size());
+        ok = renderqueue.Run(nrender);
+    }
+
+    PrintProfile("deeplot", ProfileNow() - t0);
+    if (!profilefile.empty()) {
+        WriteProfileJSON(profilefile, "deeplot", ProfileNow() - t0);
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Run Processor() over samples with njobs workers, largest input first
+// so that the wall time is set by the largest sample
+void RunSamples(const std::vector<std::string>& filenames, int njobs, int nthreads) {
+
+    std::vector<std::pair<uintmax_t, std::string>> queue;
     for (uint i = 0; i < filenames.size(); ++i) {
-        Processor(filenames.at(i));
+        uintmax_t size = 0;
+        const std::vector<std::string> inputs = rootinput ?
+            std::vector<std::string>{"./rootdata/" + filenames.at(i) + ".root"} :
+            std::vector<std::string>{"./data/" + filenames.at(i) + ".evt", "./data/" + filenames.at(i) + ".csv"};
+        for (const std::string& inputfile : inputs) {
+            std::error_code ec;
+            const uintmax_t s = std::filesystem::file_size(inputfile, ec);
+            if (!ec) {
+                size = s;
+                break;
+            }
+        }
+        queue.push_back(std::make_pair(size, filenames.at(i)));
+    }
+    if (njobs > 1) {
+        std::stable_sort(queue.begin(), queue.end(),
+            [](const std::pair<uintmax_t, std::string>& a, const std::pair<uintmax_t, std::string>& b) {
+                return a.first > b.first;
+            });
     }
 
-    return EXIT_SUCCESS;
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        size_t i;
+        while ((i = next++) < queue.size()) {
+            if (!Processor(queue.at(i).second, nthreads)) {
+                printf("Processor failed for sample: %s \n", queue.at(i).second.c_str());
+            }
+        }
+    };
+
+    njobs = std::min<int>(njobs, queue.size());
+    if (njobs <= 1) {
+        worker();
+        return;
+    }
+    std::vector<std::thread> workers;
+    for (int i = 0; i < njobs; ++i) {
+        workers.push_back(std::thread(worker));
+    }
+    for (int i = 0; i < njobs; ++i) {
+        workers[i].join();
+    }
 }
 
 // Processor
-bool Processor(const std::string& PREDICTFILE) {
+bool Processor(const std::string& PREDICTFILE, int nthreads) {
 
     // Create output directory in a case
-    system("mkdir figs");
-    std::string cmd = "mkdir ./figs/" + PREDICTFILE + "/";
-    system(cmd.c_str());
+    std::error_code ec;
+    std::filesystem::create_directories("./figs/" + PREDICTFILE, ec);
+
+    SampleInput input;
+
+    // Event range in entries of the kinematics input
+    uint64_t total = 0;
+    uint64_t first = 0;
+    uint64_t count = 0;
+
+    // 1. Open kinematics (ROOT tree, or binary event store if available, otherwise ascii)
+    const std::string treefile = "./rootdata/" + PREDICTFILE + ".root";
+    if (rootinput) {
+        if (!input.tree.Open(treefile)) {
+            printf("Cannot open kinematics inputfile: %s \n", treefile.c_str());
+            return false;
+        }
+        total = input.tree.GetEntries();
+        input.preselected = true;
+        input.counting    = !inference;
+    } else {
+        if (!input.kinematics.Open(PREDICTFILE)) {
+            printf("Cannot open kinematics inputfile: ./data/%s.{evt,csv} \n", PREDICTFILE.c_str());
+            return false;
+        }
+    }
+
+    // 2. Load DeepEfficiency networks or open their precomputed weights, one per model
+    for (size_t i = 0; i < sourcenames.size(); ++i) {
+        input.sources.push_back(std::unique_ptr<WeightSource>(new WeightSource()));
+        if (!OpenSource(*input.sources.back(), PREDICTFILE, sourcenames[i], input)) {
+            return false;
+        }
+    }
+
+    // Event range of this job. Ascii weights (./output/<sample>.out) cover only the
+    // first events of the sample (PREDICTION_SAMPLES of deepnet.py), the range is
+    // split over the events with weights so that the parts have no gaps.
+    if (partial) {
+        if (rootinput) {
+            EventRange(total, first, count);
+            if (!input.tree.Open(treefile, first, first + count)) {
+                return false;
+            }
+        } else {
+            total = input.kinematics.CountEntries();
+            for (size_t i = 0; i < input.sources.size(); ++i) {
+                const WeightSource& source = *input.sources[i];
+                if (!source.keyed && !source.evaluate) {
+                    const uint64_t nweights = source.deepnetfile.CountEntries();
+                    if (nweights < total) {
+                        printf("%s:: %s: Only the first %llu of %llu events have a weight in %s, range over these \n",
+                               PREDICTFILE.c_str(), source.label.c_str(), (unsigned long long)nweights,
+                               (unsigned long long)total, source.deepnetfile.GetFilename().c_str());
+                        total = nweights;
+                    }
+                }
+            }
+            EventRange(total, first, count);
+            if (input.kinematics.Skip(first) < first) {
+                printf("Cannot skip to event %llu of: %s \n", (unsigned long long)first, input.kinematics.GetFilename().c_str());
+                return false;
+            }
+            for (size_t i = 0; i < input.sources.size(); ++i) {
+                WeightSource& source = *input.sources[i];
+                if (!source.keyed && !source.evaluate && source.deepnetfile.Skip(first) < first) {
+                    printf("Weight not found (k = %llu)!\n", (unsigned long long)first);
+                    return false;
+                }
+            }
+            input.nlimit = count;
+        }
+        printf("%s:: Event range [%llu, %llu) of %llu \n", PREDICTFILE.c_str(),
+               (unsigned long long)first, (unsigned long long)(first + count), (unsigned long long)total);
+    }
+    if (rootinput) {
+        printf("Reading kinematics from: %s (%lld entries) \n", input.tree.GetFilename().c_str(), input.tree.GetEntries());
+    } else {
+        printf("Reading kinematics from: %s \n", input.kinematics.GetFilename().c_str());
+    }
 
+    // 3. Observables from the cache if it matches the kinematics, otherwise build it
+    if (obscache && !inference && !rootinput && !partial && !validate) {
+        const std::string cachefile = "./cache/" + PREDICTFILE + ".obs";
+        const uint64_t key = ObsCacheKey(SampleHash(input), fiducial);
+
+        if (input.cacheread.Open(cachefile, key)) {
+            input.cached = true;
+            input.kinematics.Close();
+            printf("Reading observables from cache: %s (%lu events) \n", cachefile.c_str(),
+                   (unsigned long)input.cacheread.GetEntries());
+        } else if (key != 0) {
+            std::filesystem::create_directories("./cache", ec);
+            input.caching = input.cachewrite.Open(cachefile, key);
+            if (input.caching) {
+                printf("Building observable cache: %s \n", cachefile.c_str());
+            }
+        }
+    }
+
+    // -------------------------------------------------------------------------
+    // Create histograms and run the event loop
 
-    // 1. Open kinematics
-    std::string filename = "./data/" + PREDICTFILE + ".csv";
+    std::shared_ptr<HistSet> histptr(new HistSet(PREDICTFILE, backend));
+    HistSet& hist = *histptr;
+    hist.EnableBootstrap(nbootstrap);
+    hist.SetModels(sourcenames);
+    long k = 0; // event count
 
-    if ((fp = fopen(filename.c_str(), "r")) == NULL) {
-        printf("Cannot open kinematics inputfile: %s \n", filename.c_str());
+    if (pipeline) {
+
+        // Pipeline mode: nthreads compute workers between reader and filler
+        k = PipelineLoop(input, hist, nthreads);
+
+    } else if (nthreads <= 1) {
+
+        // Serial mode
+        k = EventLoop(input, hist);
+
+    } else {
+
+        // Parallel mode: each worker fills its own histogram set from blocks
+        // of the input, merged in fixed worker order at the end
+        std::vector<std::unique_ptr<HistSet>> workerhist;
+        for (int i = 0; i < nthreads; ++i) {
+            workerhist.push_back(std::unique_ptr<HistSet>(new HistSet(PREDICTFILE, backend)));
+            workerhist.back()->EnableBootstrap(nbootstrap);
+            workerhist.back()->SetModels(sourcenames);
+        }
+        std::vector<long> workerk(nthreads, 0);
+        std::vector<std::thread> workers;
+        for (int i = 0; i < nthreads; ++i) {
+            workers.push_back(std::thread([&, i]() {
+                workerk[i] = EventLoop(input, *workerhist[i]);
+            }));
+        }
+        bool merged = true;
+        for (int i = 0; i < nthreads; ++i) {
+            workers[i].join();
+            ScopedTimer timer(stagemerge);
+            merged = hist.Add(*workerhist[i]) && merged;
+            k += workerk[i];
+        }
+        if (!merged) {
+            return false;
+        }
+        printf("Event loop with %d threads done \n", nthreads);
+    }
+    if (rootinput) {
+        input.tree.GetStats().Print(PREDICTFILE);
+    }
+    if (input.counting && !CheckTreeAlignment(input, PREDICTFILE)) {
+        return false;
+    }
+    if (input.caching) {
+        if (input.complete && input.cachewrite.Close()) {
+            printf("%s:: Observable cache written \n", PREDICTFILE.c_str());
+        } else {
+            input.cachewrite.Abort();
+            printf("%s:: Kinematics not read to the end, observable cache not written \n", PREDICTFILE.c_str());
+        }
+    }
+    printf("%s:: Events read = %ld, within fiducial = %ld \n", PREDICTFILE.c_str(), input.nread, k);
+    for (size_t i = 0; i < input.sources.size(); ++i) {
+        const WeightSource& source = *input.sources[i];
+        if (source.keyed) {
+            const uint64_t nmatched = input.nread - source.nmissing;
+            printf("%s:: %s: Events without a weight (not filled) = %ld, weights without an event = %lu \n",
+                   PREDICTFILE.c_str(), source.label.c_str(), source.nmissing,
+                   partial ? 0UL : (unsigned long)(source.weightstore.GetEntries() - nmatched));
+        }
+    }
+    if (validate) {
+        printf("%s:: Observables validated against TLorentzVector: %ld events, %ld outside tolerance %0.1e \n",
+               PREDICTFILE.c_str(), input.nchecked.load(), input.nmismatch.load(), KIN_TOL);
+    }
+
+    // Events behind the histograms
+    hist.counters.first     = first;
+    hist.counters.nentries  = rootinput ? input.tree.GetStats().nentries : input.nread;
+    hist.counters.nfiducial = k;
+    hist.counters.total     = partial ? total : hist.counters.nentries;
+
+    // Partial result: histograms and counters only, no chi2 or figures
+    if (partial) {
+        const std::string path = "./figs/" + PREDICTFILE + "/partial_" + std::to_string(first);
+        std::filesystem::create_directories(path, ec);
+        hist.Sync();
+        const bool ok = WriteHistograms(hist, path, false);
+        if (ok) {
+            printf("%s:: Partial histograms written to: %s (combine with ./deeplot-merge) \n",
+                   PREDICTFILE.c_str(), path.c_str());
+        }
+        input.kinematics.Close();
+        input.tree.Close();
+        input.sources.clear();
+        return ok;
+    }
+
+    // Chi2 results and histograms, always written
+    {
+        std::lock_guard<std::mutex> lock(outputmutex);
+        ScopedTimer timer(stagechi2);
+        hist.Chi2();
+    }
+    if (!WriteHistograms(hist, "./figs/" + PREDICTFILE)) {
         return false;
     }
 
-    // 2. Open DeepEfficiency weights
-    std::string deepfilename = "./output/" + PREDICTFILE + ".out";
+    // Queue figures for rendering after all samples
+    if (plots) {
+        QueueFigures(histptr);
+    }
 
-    std::ifstream deepnetfile;
-    deepnetfile.open(deepfilename);
+    input.kinematics.Close();
+    input.tree.Close();
+    input.sources.clear();
 
-    if (!deepnetfile) {
+    return true;
+}
+
+// Open efficiency model name of a sample (see sourcenames), ascii weights are
+// positioned to the event range by the caller
+bool OpenSource(WeightSource& source, const std::string& PREDICTFILE, const std::string& name,
+                SampleInput& input) {
+
+    source.label = name;
+    const bool isdefault = (name == "default");
+
+    if (inference) {
+        const std::string model = isdefault ? models[PREDICTFILE] : name;
+        const std::string modelfile = "./modelsave/DEEPNET_" + model + ".mlp";
+        if (!source.network.Load(modelfile)) {
+            printf("Cannot load DeepEfficiency network: %s (export with: python3 deepnet.py export %s) \n",
+                   modelfile.c_str(), model.c_str());
+            return false;
+        }
+        if (source.network.GetNInput() != (size_t)NDIM || source.network.GetNOutput() != 1) {
+            printf("DeepEfficiency network %s has dimensions %lu -> %lu, expected %d -> 1 \n", modelfile.c_str(),
+                   (unsigned long)source.network.GetNInput(), (unsigned long)source.network.GetNOutput(), NDIM);
+            return false;
+        }
+        source.evaluate = true;
+        printf("Using network model: %s \n", modelfile.c_str());
+        return true;
+    }
+
+    // Binary ./output/<stem>.wgt with shards, or ascii ./output/<stem>.out
+    const std::string stem = isdefault ? PREDICTFILE : PREDICTFILE + "." + name;
+    const std::vector<std::string> wgtfiles = FindWeightFiles(stem);
+    if (!wgtfiles.empty()) {
+
+        // Joined by event index, no positional skip for ranges
+        if (!source.weightstore.Open(wgtfiles) ||
+            (!rootinput && source.weightstore.HasSampleHash() &&
+             !source.weightstore.CheckSample(SampleHash(input), input.kinematics.GetFilename()))) {
+            printf("Cannot use DeepEfficiency weights: ./output/%s{.wgt,.shard_*.wgt} \n", stem.c_str());
+            return false;
+        }
+        source.keyed = true;
+        printf("Reading DeepEfficiency weights from: %s (%lu files, %lu weights) \n", wgtfiles.front().c_str(),
+               (unsigned long)wgtfiles.size(), (unsigned long)source.weightstore.GetEntries());
+        return true;
+    }
+
+    const std::string deepfilename = "./output/" + stem + ".out";
+    if (!source.deepnetfile.Open(deepfilename)) {
         printf("Cannot open DeepEfficiency outputfile: %s \n", deepfilename.c_str());
         return false;
     }
+    return true;
+}
 
-    // -------------------------------------------------------------------------
-    // Create histograms
-
-    // Number of bins
-    const int Nbin1D   = 100;
-    const int Nbin2D   = 80;
-
-    // (Generated, Reconstructed, Corrected) 1D-histogram triplets
-    std::vector<h1Triplet*> h1;
-    h1Triplet h1M(PREDICTFILE + "/h1M", ";System M (GeV); events", Nbin1D, 0.0, 4.0, "northeast");
-        h1.push_back(&h1M);
-    h1Triplet h1Y(PREDICTFILE + "/h1Y", ";System Y; events", Nbin1D, -1.0, 1.0, "northeast");
-        h1.push_back(&h1Y);
-    h1Triplet h1Pt(PREDICTFILE + "/h1Pt", ";System P_{T} (GeV); events", Nbin1D, 0.0, 2.0, "northeast");
-        h1.push_back(&h1Pt);
-    h1Triplet h1pt1(PREDICTFILE + "/h1pt1", ";Track p_{T} (GeV); events", Nbin1D, 0.0, 2.0, "northeast");
-        h1.push_back(&h1pt1);
-    h1Triplet h1eta1(PREDICTFILE + "/h1eta1", ";Track #eta; events", Nbin1D, -1.0, 1.0, "southeast");
-        h1.push_back(&h1eta1);
-    h1Triplet h1dY(PREDICTFILE + "/h1dY", ";#Deltay #equiv y_{1}-y_{2}; events", Nbin1D, -2.0, 2.0, "northeast");
-        h1.push_back(&h1dY);
-
-    // (Generated, Reconstructed, Corrected) 2D-histogram triplets
-    std::vector<h2Triplet*> h2;
-    h2Triplet h2etaphi(PREDICTFILE + "/h2etaphi", ";Track #eta; Track #phi (rad)", Nbin2D, -1.0, 1.0, Nbin2D,  -PI, PI);
-        h2.push_back(&h2etaphi);
-    h2Triplet h2etaeta(PREDICTFILE + "/h2etaeta", ";Track #eta^{(1)}; Track #eta^{(2)}", Nbin2D, -1.0, 1.0, Nbin2D,  -1.0, 1.0);
-        h2.push_back(&h2etaeta);
-    h2Triplet h2pt1pt2(PREDICTFILE + "/h2pt1pt2", ";Track p_{T}^{(1)}; Track p_{T}^{(2)}", Nbin2D, 0.0, 2.0, Nbin2D,  0.0, 2.0);
-        h2.push_back(&h2pt1pt2);
-    h2Triplet h2Mdeltaphi(PREDICTFILE + "/h2Mdeltaphi", ";System M (GeV); Pair #Delta#phi (rad)", Nbin2D, 0.0, 4.0, Nbin2D,  0, PI);
-        h2.push_back(&h2Mdeltaphi);
-    h2Triplet h2MPt(PREDICTFILE + "/h2MPt", ";System M (GeV); System P_{T} (GeV)", Nbin2D, 0.0, 4.0, Nbin2D,  0, 2.5);
-        h2.push_back(&h2MPt);
-    h2Triplet h2Mpt1(PREDICTFILE + "/h2Mpt1", ";System M (GeV); Track p_{T} (GeV)", Nbin2D, 0.0, 4.0, Nbin2D,  0, 2.5);
-        h2.push_back(&h2Mpt1);
-
-    // Aux variables
-    int reco = 0;
-    int k = 0;    
-    double weight = 0.0;
-    TH1D* h1W = new TH1D("h1W", ";DeepEfficiency-6D output w; events", 200, 0, 1.0);
-
-    // Generated 4-momentum
-    TLorentzVector p1_gen;
-    TLorentzVector p2_gen;
-    TLorentzVector system_gen;    
+// Content hash of the kinematics file of a sample, computed once for the .wgt
+// sample check and the observable cache key
+uint64_t SampleHash(SampleInput& input) {
+    if (input.kinematicshash == 0) {
+        input.kinematicshash = HashFile(input.kinematics.GetFilename());
+    }
+    return input.kinematicshash;
+}
 
-    // Reconstructed 4-momentum
-    TLorentzVector p1_rec;
-    TLorentzVector p2_rec;
-    TLorentzVector system_rec;
+// Re-plot a sample from the histograms written by Processor(), no event loop
+bool Replot(const std::string& PREDICTFILE) {
+
+    std::shared_ptr<HistSet> hist(new HistSet(PREDICTFILE, BACKEND_ROOT));
+    if (!hist->Read("./figs/" + PREDICTFILE)) {
+        return false;
+    }
+    printf("Replotting sample: %s \n", PREDICTFILE.c_str());
+    {
+        ScopedTimer timer(stagechi2);
+        hist->Chi2();
+    }
+    QueueFigures(hist);
+
+    return true;
+}
+
+// Histogram archive of a sample, timed
+bool WriteHistograms(const HistSet& hist, const std::string& path, bool chi2) {
+    ScopedTimer timer(stagewrite);
+    const bool ok = hist.Write(path, chi2);
+    std::error_code ec;
+    const uintmax_t bytes = std::filesystem::file_size(path + "/histograms.root", ec);
+    timer.Add(0, ec ? 0 : bytes);
+    return ok;
+}
+
+// Entries [first, first + count) of a sample with total entries, by --shard i/N
+// (equal parts) or --first/--count (clamped to the sample)
+void EventRange(uint64_t total, uint64_t& first, uint64_t& count) {
+    if (nshards > 0) {
+        first = total * shard / nshards;
+        count = total * (shard + 1) / nshards - first;
+        return;
+    }
+    first = std::min(rangefirst, total);
+    count = (rangecount < 0) ? total - first : std::min<uint64_t>(rangecount, total - first);
+}
+
+// Queue all figures of a sample for rendering
+void QueueFigures(const std::shared_ptr<HistSet>& hist) {
+
+    for (size_t i = 0; i < hist->GetNFigures(); ++i) {
+        renderqueue.Push([hist, i]() {
+            hist->SaveFig(i);
+        });
+    }
+}
+
+// Read the next block of kinematics and matching DeepEfficiency weights,
+// returns false when there is nothing left
+bool ReadBlock(SampleInput& input, Batch& batch) {
+
+    std::lock_guard<std::mutex> lock(input.mutex);
+
+    EventBlock& block = batch.block;
+
+    if (input.done) {
+        return false;
+    }
+    if (input.nlimit >= 0 && input.nread >= input.nlimit) {
+        input.done = true;
+        return false;
+    }
+    if (input.nread >= MAXEVENTS) {
+        printf("Maximum event count = %d reached \n", MAXEVENTS);
+        input.done = true;
+        return false;
+    }
+    const long maxevents = (input.nlimit >= 0) ? std::min<long>(MAXEVENTS, input.nlimit) : MAXEVENTS;
+    const size_t maxn = std::min<long>(BLOCKSIZE, maxevents - input.nread);
+
+    ScopedTimer timer(stageread);
+    const uint64_t offset = InputOffset(input);
+
+    // Read kinematic input (or its observables from the cache)
+    size_t nk = 0;
+    if (input.cached) {
+        nk = input.cacheread.ReadBlock(maxn, block.first, batch.gen, batch.rec, block.reco, batch.fiducial);
+        block.n = nk;
+    } else {
+        nk = input.preselected ? ReadTreeBlock(input, block, batch.entry, maxn) : input.kinematics.ReadBlock(block, maxn);
+    }
+    if (nk < maxn) {
+        if (input.kinematics.Error() || input.tree.Error()) {
+            printf("Kinematics inputfile:: Error in parsing! \n");
+        } else {
+            printf("Kinematics inputfile:: EOF! \n");
+            input.complete = true;
+        }
+        input.done = true;
+    }
 
-    // Event loop
-    while (true) {
+    // Read in DeepEfficiency efficiency estimates of each model (unless evaluated by the caller),
+    // events are filled only with a weight from all of them
+    batch.weights.resize(input.sources.size());
+    batch.hasweight.assign(block.n, 1);
+    size_t nweights = block.n; // Events with the ascii weights of all models
+    bool keyeddone  = true;    // Binary weights of all models consumed
+
+    for (size_t s = 0; s < input.sources.size(); ++s) {
+        WeightSource& source = *input.sources[s];
+        std::vector<double>& weights = batch.weights[s];
+        weights.resize(block.n);
+
+        if (source.keyed) {
+            batch.found.resize(block.n);
+            const size_t nw = source.weightstore.Join(block.first, block.n, weights.data(), batch.found.data());
+            source.nmissing += block.n - nw;
+            for (size_t i = 0; i < block.n; ++i) {
+                batch.hasweight[i] &= batch.found[i];
+            }
+            keyeddone = keyeddone && source.weightstore.Done();
+        } else if (!source.evaluate) {
+            const size_t nw = source.weightsdone ? 0 : source.deepnetfile.Read(weights.data(), block.n);
+            std::fill(batch.hasweight.begin() + nw, batch.hasweight.end(), 0);
+            if (nw < block.n && !source.weightsdone) {
+                printf("Weight not found (k = %ld)!\n", input.nread + (long)nw);
+                source.weightsdone = true;
+            }
+            nweights = std::min(nweights, nw);
+            keyeddone = false;
+        } else {
+            keyeddone = false;
+        }
+    }
 
-        if (k >= MAXEVENTS - 1) {
-            printf("Maximum event count = %d reached \n", MAXEVENTS);
-            break;
+    // No weights left, the rest of the input is read only for the cache
+    // or the event count check
+    if (!input.caching && !input.counting) {
+        if (keyeddone) {
+            input.done = true;
         }
-        // Read kinematic input
-        if (!ReadKinematics(p1_gen, p2_gen, p1_rec, p2_rec, reco)) {
-            break;
+        if (nweights < block.n) {
+            block.n = nweights;
+            input.done = true;
         }
+    }
+    input.nread += nweights;
+    timer.Add(block.n, InputOffset(input) - offset);
+
+    return block.n > 0;
+}
 
-        // System 4-momentum, generated and reconstructed
-        system_gen = p1_gen + p2_gen;
-        system_rec = p1_rec + p2_rec;
+// Bytes consumed from the input files of a sample
+uint64_t InputOffset(const SampleInput& input) {
+    uint64_t offset = 0;
+    for (size_t i = 0; i < input.sources.size(); ++i) {
+        offset += input.sources[i]->deepnetfile.GetOffset() + input.sources[i]->weightstore.GetOffset();
+    }
+    if (input.preselected) {
+        offset += input.tree.GetStats().bytesread;
+    } else if (input.cached) {
+        offset += input.cacheread.GetOffset();
+    } else {
+        offset += input.kinematics.GetOffset();
+    }
+    return offset;
+}
 
-        // Read in DeepEfficiency efficiency estimate
-        if (!(deepnetfile >> weight)) {
-            printf("Weight not found (k = %d)!\n", k);
-            break;
+// Next block of tree events passing the cuts of printascii. Events are in the same
+// order as in ./data/<sample>.csv, precomputed weights match only if exactly the
+// same events pass here (see CheckTreeAlignment). The tree entry of each event is
+// its bootstrap key, the same in any entry range (--first/--count, --shard).
+size_t ReadTreeBlock(SampleInput& input, EventBlock& block, std::vector<uint64_t>& entry, size_t maxn) {
+
+    block.Resize(maxn);
+    block.first = input.nread;
+    entry.resize(maxn);
+
+    EventBlock& tb = input.treeblock;
+    EventRecord ev;
+    size_t n = 0;
+
+    while (n < maxn) {
+        if (input.treepos == tb.n) {
+            if (input.tree.ReadBlock(tb, BLOCKSIZE) == 0) {
+                break;
+            }
+            input.treepos = 0;
+            input.treemask.resize(tb.n);
+            preselection.Select(tb, input.treemask.data());
         }
-        // Inverse weight
-        weight = 1.0 / std::min(std::max(weight, 1e-6), 1.0); // max operator regularizator for safety	
-	
-	
-        // ----------------------------------------------------------------
-        //        ***** FIDUCIAL CUTS *****
-        // Note that DeepEfficiency network should not be trained with more restrictive cuts than what
-	// one applied here.
-	
-	// Use generator level variables here, in order to be able to make "ground truth comparison".
-        // When working with data, this option is not possible. 
-        if (p1_gen.Perp() > FID_PT && p2_gen.Perp() > FID_PT &&
-            std::abs(p1_gen.Eta()) < FID_ETA && std::abs(p2_gen.Eta()) < FID_ETA ) {
-            // Event within fiducial
-        } else {
-            //printf("Event outside fiducial phase space!! Check numerics:: (pt,eta) = (%0.3f,%0.3f), (%0.3f, %0.3f) \n", p1_gen.Perp(), p1_gen.Eta(), p2_gen.Perp(), p2_gen.Eta());
-            continue;
+        for (; input.treepos < tb.n && n < maxn; ++input.treepos) {
+            const size_t i = input.treepos;
+            if (input.treemask[i]) {
+                tb.Get(i, ev);
+                block.Set(n, ev);
+                entry[n] = input.tree.GetFirst() + tb.first + i;
+                ++n;
+            }
         }
+    }
+    block.n = n;
+    input.npreselected += n;
 
-        // ----------------------------------------------------------------
-        // Construct observables of interest
+    return n;
+}
 
-        TLorentzVector p1;
-        TLorentzVector p2;
-        TLorentzVector system;
+// Precomputed weights are indexed by the event ordinal in ./data/<sample>.{evt,csv}
+// of printascii. With --root they line up with the tree events only if the tree
+// reader passes the same events (selection at the cut edges included), checked
+// by the event count.
+bool CheckTreeAlignment(const SampleInput& input, const std::string& PREDICTFILE) {
 
-        // Generator level
-        const double M_gen        = system_gen.M();
-        const double Y_gen        = system_gen.Y();
-        const double Pt_gen       = system_gen.Perp();
-        const double dY_gen       = p1_gen.Rapidity() - p2_gen.Rapidity();
-        const double eta1_gen     = p1_gen.Eta();
-        const double pt1_gen      = p1_gen.Perp();
-        const double pt2_gen      = p2_gen.Perp();
-        const double deltaphi_gen = p1_gen.DeltaPhi(p2_gen);
+    if (!input.complete) {
+        printf("%s:: Tree not read to the end, weight alignment not checked \n", PREDICTFILE.c_str());
+        return true;
+    }
+    KinematicsInput data;
+    if (!data.Open(PREDICTFILE)) {
+        printf("%s:: No ./data/%s.{evt,csv}, weight alignment with the tree not checked \n",
+               PREDICTFILE.c_str(), PREDICTFILE.c_str());
+        return true;
+    }
+    const uint64_t ndata = data.CountEntries();
+    if (ndata != (uint64_t)input.npreselected) {
+        printf("%s:: Tree events after the cuts = %ld, but %s has %llu: precomputed weights do not line up "
+               "(cuts differ from printascii?), use --mlp or the ./data input \n", PREDICTFILE.c_str(),
+               input.npreselected, data.GetFilename().c_str(), (unsigned long long)ndata);
+        return false;
+    }
+    printf("%s:: Tree events after the cuts = %ld, same as in %s \n", PREDICTFILE.c_str(),
+           input.npreselected, data.GetFilename().c_str());
+    return true;
+}
 
-        // Reconstruction level
-        const double M_rec        = system_rec.M();
-        const double Y_rec        = system_rec.Y();
-        const double Pt_rec       = system_rec.Perp();
-        const double dY_rec       = p1_rec.Rapidity() - p2_rec.Rapidity();
-        const double eta1_rec     = p1_rec.Eta();
-        const double pt1_rec      = p1_rec.Perp();
-        const double pt2_rec      = p2_rec.Perp();
-        const double deltaphi_rec = p1_rec.DeltaPhi(p2_rec);
+// Event loop over blocks of the input, returns the number of events filled
+long EventLoop(SampleInput& input, HistSet& hist) {
+
+    Batch batch;
+    long k = 0;
+
+    while (ReadBlock(input, batch)) {
+        ComputeBatch(input, batch);
 
         // ----------------------------------------------------------------
         // *** Efficiency correction and plotting ***
-        
-        // 1D
-        h1M.Fill(reco, M_gen, M_rec, weight);
-        h1Y.Fill(reco, Y_gen, Y_rec, weight);
-        h1Pt.Fill(reco, Pt_gen, Pt_rec, weight);
-        h1pt1.Fill(reco, pt1_gen, pt1_rec, weight);
-        h1eta1.Fill(reco, eta1_gen, eta1_rec, weight);
-        h1dY.Fill(reco, dY_gen, dY_rec, weight);
-        
-
-        // 2D
-        h2etaphi.Fill(reco, p1_gen.Eta(), p1_gen.Phi(), p1_rec.Eta(), p1_rec.Phi(), weight);
-        h2etaeta.Fill(reco, p1_gen.Eta(), p2_gen.Eta(), p1_rec.Eta(), p2_rec.Eta(), weight);
-        h2Mdeltaphi.Fill(reco, M_gen, deltaphi_gen, M_rec, deltaphi_rec, weight);
-        h2MPt.Fill(reco, M_gen, Pt_gen, M_rec, Pt_rec, weight);
-        h2Mpt1.Fill(reco, M_gen, pt1_gen, M_rec, pt1_rec, weight);
-        h2pt1pt2.Fill(reco, pt1_gen, pt2_gen, pt1_rec, pt2_rec, weight);
-	     
-
-        // DEBUG fills
-        h1W->Fill(1.0/weight);
-        ++k; // event count
-    }
-
-    // Plot
-    std::string name = PREDICTFILE + "/hx_weights";
-    PlotFilled(h1W, name, false, false);
-
-    // Save 1D-histograms
-    double chi2sum = 0.0;
-    for (uint i = 0; i < h1.size(); ++i) {
-        chi2sum += h1.at(i)->SaveFig();
-    }
-    printf("=======================================================\n");
-    printf("AVERAGE: <Chi2 / ndf> = %0.2f \n", chi2sum / (double)h1.size());
-    printf("=======================================================\n");
-
-    // Save 2D-histograms
-    for (uint i = 0; i < h2.size(); ++i) {
-        h2.at(i)->SaveFig();
-    }
-
-    fclose(fp);
-    deepnetfile.close();
-    delete h1W;
 
-    return true;
+        ScopedTimer timer(stagefill);
+        FillHistograms(hist, batch);
+        timer.Add(batch.m);
+        k += batch.m;
+    }
+
+    return k;
 }
 
-// Global Style Setup
-void SetROOTStyle() {
+// Streaming pipeline: reader -> nworkers x compute -> fill (this thread).
+// Batches are recycled through a fixed pool and filled in input order,
+// so the result is the same as with EventLoop(). Returns the number of
+// events filled.
+long PipelineLoop(SampleInput& input, HistSet& hist, int nworkers) {
+
+    const size_t NPOOL = 2 * nworkers + 4; // Batches in flight
+
+    std::vector<std::unique_ptr<Batch>> pool;
+    BoundedQueue<Batch*> freequeue(NPOOL);
+    BoundedQueue<Batch*> readqueue(NPOOL);
+    BoundedQueue<Batch*> donequeue(NPOOL);
+    for (size_t i = 0; i < NPOOL; ++i) {
+        pool.push_back(std::unique_ptr<Batch>(new Batch()));
+        freequeue.Push(pool.back().get());
+    }
 
-  gStyle->SetOptStat(0); // Statistics BOX OFF with argument 0
-  gStyle->SetTitleSize(0.0475,"t"); // Title with "t" (or anything else than xyz)
-  gStyle->SetStatY(1.0);
-  gStyle->SetStatX(1.0);
-  gStyle->SetStatW(0.15);
-  gStyle->SetStatH(0.09);
+    // Queue operations, blocked time is waiting of the stage
+    auto Pop = [](BoundedQueue<Batch*>& queue, Batch*& batch, ProfileStage& stage) {
+        ScopedWait wait(stage);
+        return queue.Pop(batch);
+    };
+    auto Push = [](BoundedQueue<Batch*>& queue, Batch* batch, ProfileStage& stage) {
+        ScopedWait wait(stage);
+        return queue.Push(batch);
+    };
+
+    // 1. Reader (timed in ReadBlock)
+    std::thread reader([&]() {
+        Batch* batch = nullptr;
+        uint64_t seq = 0;
+        while (Pop(freequeue, batch, stageread)) {
+            if (!ReadBlock(input, *batch)) {
+                break;
+            }
+            batch->seq = seq++;
+            Push(readqueue, batch, stageread);
+        }
+        readqueue.Close();
+    });
+
+    // 2. Observables, weights and fiducial selection (timed in ComputeBatch)
+    std::atomic<int> nactive(nworkers);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < nworkers; ++i) {
+        workers.push_back(std::thread([&]() {
+            Batch* batch = nullptr;
+            while (Pop(readqueue, batch, stagecompute)) {
+                ComputeBatch(input, *batch);
+                Push(donequeue, batch, stagecompute);
+            }
+            if (--nactive == 0) {
+                donequeue.Close();
+            }
+        }));
+    }
+
+    // 3. Histogram filling in input order
+    std::vector<Batch*> reorder(NPOOL, nullptr);
+    uint64_t next = 0;
+    long k = 0;
+    Batch* batch = nullptr;
+    while (Pop(donequeue, batch, stagefill)) {
+        reorder[batch->seq % NPOOL] = batch;
+        while ((batch = reorder[next % NPOOL]) != nullptr) {
+            reorder[next % NPOOL] = nullptr;
+            {
+                ScopedTimer timer(stagefill);
+                FillHistograms(hist, *batch);
+                timer.Add(batch->m);
+            }
+            k += batch->m;
+            ++next;
+            freequeue.Push(batch);
+        }
+    }
+    freequeue.Close();
+
+    reader.join();
+    for (int i = 0; i < nworkers; ++i) {
+        workers[i].join();
+    }
+
+    return k;
 }
 
+// Histograms of one block: shared generated and reconstructed with the first
+// model, the corrected histograms of the other models
+void FillHistograms(HistSet& hist, const Batch& batch) {
+    hist.FillBatch(batch.m, batch.gen, batch.rec, batch.reco.data(), batch.weight[0].data(), batch.index.data());
+    for (size_t s = 1; s < batch.weight.size(); ++s) {
+        hist.FillModel(s, batch.m, batch.rec, batch.reco.data(), batch.weight[s].data());
+    }
+}
 
-// Set "nice" 2D-plot style
-void SetPlotStyle() {
+// Network evaluation, observables and fiducial selection of one block
+void ComputeBatch(SampleInput& input, Batch& batch) {
 
-  // Set Smooth color gradients
-  const Int_t NRGBs = 5;
-  const Int_t NCont = 255;
+    const EventBlock& block = batch.block;
+    const size_t n = block.n;
 
-  Double_t stops[NRGBs] = { 0.00, 0.34, 0.61, 0.84, 1.00 };
-  Double_t red[NRGBs]   = { 0.00, 0.00, 0.87, 1.00, 0.51 };
-  Double_t green[NRGBs] = { 0.00, 0.81, 1.00, 0.20, 0.00 };
-  Double_t blue[NRGBs]  = { 0.51, 1.00, 0.12, 0.00, 0.00 };
-  TColor::CreateGradientColorTable(NRGBs, stops, red, green, blue, NCont);
-  gStyle->SetNumberContours(NCont);
+    ScopedTimer timer(stagecompute);
+    timer.Add(n);
 
-  // Black-Red palette
-  gStyle->SetPalette(53); // 53,56 for inverted
+    // ----------------------------------------------------------------
+    // DeepEfficiency efficiency estimates with reconstruction level
+    // input (as in deepnet.py predict)
 
-  // Number of decimals in text in TH2 plots
-  //gStyle->SetPaintTextFormat("4.2f");
+    if (inference) {
+        batch.features.resize(n * NDIM);
+        for (size_t i = 0; i < n; ++i) {
+            for (int j = 0; j < NDIM; ++j) {
+                batch.features[i * NDIM + j] = block.mom[PX1_REC + j][i];
+            }
+        }
+        batch.output.resize(n);
+
+        // Same input for all networks
+        for (size_t s = 0; s < input.sources.size(); ++s) {
+            input.sources[s]->network.Predict(n, batch.features.data(), batch.output.data(), batch.workspace);
+            for (size_t i = 0; i < n; ++i) {
+                batch.weights[s][i] = batch.output[i];
+            }
+        }
+    }
 
-  //gStyle->SetTitleOffset(1.4,"x");  //X-axis title offset from axis
-  //gStyle->SetTitleOffset(1.4,"y");  //X-axis title offset from axis
-  //gStyle->SetTitleSize(0.04,"x");   //X-axis title size
-  //gStyle->SetTitleSize(0.04,"y");
-  //gStyle->SetTitleSize(0.04,"z");
-  //gStyle->SetLabelOffset(0.025);
+    // Observables and fiducial mask were read from the cache
+    if (!input.cached) {
 
-}
+        batch.mass1.resize(n);
+        batch.mass2.resize(n);
+        AssignMasses(n, block.pidCode[0].data(), batch.mass1.data());
+        AssignMasses(n, block.pidCode[1].data(), batch.mass2.data());
+
+        // ----------------------------------------------------------------
+        // Construct observables of interest
+
+        const double* m1 = batch.mass1.data();
+        const double* m2 = batch.mass2.data();
+
+        // Generator level
+        ComputeObservables(n,
+            TrackColumns{block.mom[PX1_GEN].data(), block.mom[PY1_GEN].data(), block.mom[PZ1_GEN].data(), m1},
+            TrackColumns{block.mom[PX2_GEN].data(), block.mom[PY2_GEN].data(), block.mom[PZ2_GEN].data(), m2},
+            batch.gen);
+
+        // Reconstruction level
+        ComputeObservables(n,
+            TrackColumns{block.mom[PX1_REC].data(), block.mom[PY1_REC].data(), block.mom[PZ1_REC].data(), m1},
+            TrackColumns{block.mom[PX2_REC].data(), block.mom[PY2_REC].data(), block.mom[PZ2_REC].data(), m2},
+            batch.rec);
+
+        if (validate) {
+            input.nchecked  += n;
+            input.nmismatch += ValidateObservables(block, batch.gen, batch.rec);
+        }
 
-// 
-void PlotFilled(TH1D* h1, std::string& name, bool logscale, bool normalize) {
+        // ----------------------------------------------------------------
+        //        ***** FIDUCIAL CUTS *****
+        // Note that DeepEfficiency network should not be trained with more restrictive cuts than what
+        // one applied here.
 
-    TCanvas* c = new TCanvas("c","c", 800, 650);
-    if (logscale) {
-        c->cd()->SetLogy();
+        // Use generator level variables here, in order to be able to make "ground truth comparison".
+        // When working with data, this option is not possible.
+        batch.fiducial.resize(n);
+        if (input.preselected && cutfile.empty()) {
+            std::fill(batch.fiducial.begin(), batch.fiducial.end(), 1);
+        } else {
+            fiducial.Select(block, batch.fiducial.data(), PX1_GEN);
+        }
     }
-    if (normalize) { // Make it discrete probability distribution
-        double norm = 1.0/h1->GetEntries();
-        //double norm = 1.0/h1->Integral();
-        h1->Scale(norm);
+    if (input.caching) {
+        input.cachewrite.Write(block.first, n, batch.gen, batch.rec, block.reco.data(), batch.fiducial.data());
     }
 
-    h1->GetYaxis()->SetTitleOffset(1.45);
-    h1->SetFillColor(19);
-    h1->SetLineWidth(1.5);
-    h1->SetMarkerStyle(20);
-    h1->SetMarkerSize(0.5);
-    h1->SetStats(0);
-    h1->Draw(); // "ep"
-    c->SaveAs( ("./figs/" + name + ".pdf").c_str() );
+    // Events with a weight only (the rest is read for the cache)
+    for (size_t i = 0; i < n; ++i) {
+        batch.fiducial[i] &= batch.hasweight[i];
+    }
+    batch.reco.resize(n);
+    batch.index.resize(n);
+    size_t m = 0;
+
+    for (size_t i = 0; i < n; ++i) {
+        if (batch.fiducial[i]) {
+            batch.reco[m]  = (block.reco[i] != 0);
+            batch.index[m] = input.preselected ? batch.entry[i] : block.first + i;
+            ++m;
+        }
+    }
 
-    delete c;
+    // Inverse weights of each model
+    batch.weight.resize(batch.weights.size());
+    for (size_t s = 0; s < batch.weights.size(); ++s) {
+        const std::vector<double>& weights = batch.weights[s];
+        std::vector<double>& weight = batch.weight[s];
+        weight.resize(n);
+        size_t j = 0;
+        for (size_t i = 0; i < n; ++i) {
+            if (batch.fiducial[i]) {
+                weight[j++] = 1.0 / std::min(std::max(weights[i], 1e-6), 1.0); // max operator regularizator for safety
+            }
+        }
+    }
+    batch.gen.Select(n, batch.fiducial.data());
+    batch.rec.Select(n, batch.fiducial.data());
+    batch.m = m;
 }
 
-// Read event kinematics
-bool ReadKinematics(TLorentzVector& p1_gen, TLorentzVector& p2_gen,
-                    TLorentzVector& p1_rec, TLorentzVector& p2_rec, int& reco) {
+// Compare the observables of a block against the TLorentzVector
+// reference, returns the number of events outside tolerance
+long ValidateObservables(const EventBlock& block, const ObservablesBlock& gen, const ObservablesBlock& rec) {
 
-    double px1_gen, py1_gen, pz1_gen, px2_gen, py2_gen, pz2_gen,
-           px1_rec, py1_rec, pz1_rec, px2_rec, py2_rec, pz2_rec = 0.0;
+    const char* names[] = {"M", "Y", "Pt", "dY", "eta1", "eta2", "phi1", "pt1", "pt2", "deltaphi"};
+    double Observables::* fields[] = {
+        &Observables::M, &Observables::Y, &Observables::Pt, &Observables::dY, &Observables::eta1,
+        &Observables::eta2, &Observables::phi1, &Observables::pt1, &Observables::pt2, &Observables::deltaphi};
 
-    int pidCode[2] = {0};
+    EventRecord ev;
+    TLorentzVector p1_gen;
+    TLorentzVector p2_gen;
+    TLorentzVector p1_rec;
+    TLorentzVector p2_rec;
+    Observables ref[2];
+    Observables obs[2];
+    long nbad = 0;
+
+    for (size_t i = 0; i < block.n; ++i) {
+
+        block.Get(i, ev);
+        ReadKinematics(ev, p1_gen, p2_gen, p1_rec, p2_rec);
+        GetObservables(p1_gen, p2_gen, ref[0]);
+        GetObservables(p1_rec, p2_rec, ref[1]);
+        gen.Get(i, obs[0]);
+        rec.Get(i, obs[1]);
+
+        bool ok = true;
+        for (int l = 0; l < 2; ++l) {
+            for (int f = 0; f < 10; ++f) {
+                const double a = obs[l].*fields[f];
+                const double b = ref[l].*fields[f];
+                if (std::isnan(a) && std::isnan(b)) {
+                    continue;
+                }
+                if (!(std::abs(a - b) <= KIN_TOL * std::max(1.0, std::max(std::abs(a), std::abs(b))))) {
+                    if (nbad < 10) {
+                        printf("ValidateObservables:: Event %lu %s-level %s = %0.17g, TLorentzVector = %0.17g \n",
+                               (unsigned long)(block.first + i), l == 0 ? "gen" : "rec", names[f], a, b);
+                    }
+                    ok = false;
+                }
+            }
+        }
+        if (!ok) {
+            ++nbad;
+        }
+    }
 
-    // Read event kinematics
-    int ret = fscanf(fp, "%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%d,%d,%d\n", 
-        &px1_gen, &py1_gen, &pz1_gen,
-        &px2_gen, &py2_gen, &pz2_gen, 
-        &px1_rec, &py1_rec, &pz1_rec,
-        &px2_rec, &py2_rec, &pz2_rec,
-        &pidCode[0], &pidCode[1], 
-        &reco);
+    return nbad;
+}
 
-    if (ret == 15) { // check we got the right number of variables!
-        // ok
-    } else if (errno != 0) {
-        printf("Kinematics inputfile:: Error in parsing! \n");
-        return false;
-    } else if (ret == EOF) {
-        printf("Kinematics inputfile:: EOF! \n");
-        return false;
-    } else {
-        printf("Kinematics inputfile:: General error! \n");
-        return false;
+// Check the compiled (sqrt free) cut tests of Selection against the TLorentzVector
+// values, for all cut variables and operators. Tracks exactly on the compiled edge
+// must pass only with <= and >=, tracks around the edge and elsewhere as with the
+// TLorentzVector value (unless within KIN_TOL of the cut). Returns the number of
+// failed tests.
+long ValidateSelection() {
+
+    const char* variables[] = {"px", "py", "pz", "pt", "p", "eta", "abseta"};
+    const char* operators[] = {"<", "<=", ">", ">="};
+    const double values[]   = {-1.3, -0.5, 0.0, 1e-3, 0.1, 0.9, 2.5};
+    const double DELTA      = 1e-6; // Relative offset of the tracks around the edge
+    const int NRANDOM       = 500;
+
+    std::mt19937_64 rng(20180723);
+    std::uniform_real_distribution<double> flat(-3.0, 3.0);
+
+    long ntests = 0;
+    long nbad   = 0;
+    int  ncuts  = 0;
+
+    for (int v = CUT_PX; v <= CUT_ABSETA; ++v) {
+        for (int o = CUT_LT; o <= CUT_GE; ++o) {
+            for (const double value : values) {
+
+                char text[128];
+                snprintf(text, sizeof(text), "%s %s %0.17g", variables[v], operators[o], value);
+                Selection cut;
+                if (!cut.Parse(text, "validate")) {
+                    ++nbad;
+                    continue;
+                }
+                const double c = cut.GetCuts()[0].value;
+                ++ncuts;
+
+                // Tracks {px, py, pz} on the edge (component e carries the cut value),
+                // non-negative variables have no edge below zero
+                std::vector<std::array<double, 3>> edges;
+                int e = 2;
+                if (v <= CUT_PZ) {
+                    std::array<double, 3> t = {0.3, 0.7, -0.4};
+                    t[v - CUT_PX] = c;
+                    edges.push_back(t);
+                    e = v - CUT_PX;
+                } else if (c >= 0) {
+                    const double s = std::sinh(c);
+                    if (v == CUT_PT) {
+                        edges.push_back({c, 0.0, 0.7});
+                        e = 0;
+                    } else if (v == CUT_P) {
+                        edges.push_back({c, 0.0, 0.0});
+                        e = 0;
+                    } else if (v == CUT_ABSETA) {
+                        edges.push_back({1.0, 0.0, s});
+                        edges.push_back({1.0, 0.0, -s});
+                    }
+                }
+                if (v == CUT_ETA) {
+                    edges.push_back({1.0, 0.0, std::sinh(c)});
+                }
+
+                // Edge tracks first, then around the edges and elsewhere
+                std::vector<std::array<double, 3>> tracks(edges);
+                for (const std::array<double, 3>& t : edges) {
+                    for (const double sign : {-1.0, 1.0}) {
+                        std::array<double, 3> u = t;
+                        u[e] += sign * DELTA * std::max(1.0, std::abs(t[e]));
+                        tracks.push_back(u);
+                    }
+                }
+                for (int i = 0; i < NRANDOM; ++i) {
+                    tracks.push_back({flat(rng), flat(rng), (i % 10 == 0) ? 0.0 : flat(rng)});
+                }
+
+                // Selection as in the event loop, the same track twice
+                EventBlock block;
+                block.Resize(tracks.size());
+                block.n = tracks.size();
+                for (size_t i = 0; i < tracks.size(); ++i) {
+                    for (int j = 0; j < 3; ++j) {
+                        block.mom[PX1_GEN + j][i] = tracks[i][j];
+                        block.mom[PX2_GEN + j][i] = tracks[i][j];
+                    }
+                }
+                std::vector<unsigned char> mask(block.n);
+                cut.Select(block, mask.data(), PX1_GEN);
+
+                for (size_t i = 0; i < tracks.size(); ++i) {
+                    TLorentzVector p;
+                    p.SetXYZM(tracks[i][0], tracks[i][1], tracks[i][2], 0.0);
+                    const double x[] = {p.Px(), p.Py(), p.Pz(), p.Perp(), p.P(), p.Eta(), std::abs(p.Eta())};
+
+                    bool expected;
+                    if (i < edges.size()) {
+                        expected = (o == CUT_LE || o == CUT_GE);
+                    } else if (std::abs(x[v] - c) <= KIN_TOL * std::max(1.0, std::abs(c))) {
+                        continue; // At the edge within rounding
+                    } else {
+                        expected = (o == CUT_LT) ? (x[v] <  c) :
+                                   (o == CUT_LE) ? (x[v] <= c) :
+                                   (o == CUT_GT) ? (x[v] >  c) : (x[v] >= c);
+                    }
+                    ++ntests;
+                    if ((mask[i] != 0) != expected) {
+                        if (nbad < 10) {
+                            printf("ValidateSelection:: '%s' track (%0.17g, %0.17g, %0.17g)%s: selection %d, TLorentzVector %s = %0.17g \n",
+                                   text, tracks[i][0], tracks[i][1], tracks[i][2], (i < edges.size()) ? " on the edge" : "",
+                                   (int)mask[i], variables[v], x[v]);
+                        }
+                        ++nbad;
+                    }
+                }
+            }
+        }
     }
+    printf("ValidateSelection:: %ld tests of %d cuts at and around the cut edges, %ld failures \n", ntests, ncuts, nbad);
+
+    return nbad;
+}
+
+// Observables of a track pair (TLorentzVector reference for --validate)
+void GetObservables(const TLorentzVector& p1, const TLorentzVector& p2, Observables& obs) {
+
+    const TLorentzVector system = p1 + p2;
+
+    obs.M        = system.M();
+    obs.Y        = system.Y();
+    obs.Pt       = system.Perp();
+    obs.dY       = p1.Rapidity() - p2.Rapidity();
+    obs.eta1     = p1.Eta();
+    obs.eta2     = p2.Eta();
+    obs.phi1     = p1.Phi();
+    obs.pt1      = p1.Perp();
+    obs.pt2      = p2.Perp();
+    obs.deltaphi = p1.DeltaPhi(p2);
+}
+
+// Construct event 4-momenta
+void ReadKinematics(const EventRecord& ev, TLorentzVector& p1_gen, TLorentzVector& p2_gen,
+                    TLorentzVector& p1_rec, TLorentzVector& p2_rec) {
 
     // Assign masses
-    double mass[2] = {0,0};
-    for (int i = 0; i < 2; ++i) {
-        if (std::abs(pidCode[i]) == 211) { // Charged pion
-            mass[i] = mPI;
-        }
-        if (std::abs(pidCode[i]) == 321) { // Charged kaon
-            mass[i] = mK;
-        }
-    }
+    const double mass[2] = {PIDMass(ev.pidCode[0]), PIDMass(ev.pidCode[1])};
 
     // Construct 4-momenta
-    p1_gen.SetXYZM(px1_gen, py1_gen, pz1_gen, mass[0]);
-    p2_gen.SetXYZM(px2_gen, py2_gen, pz2_gen, mass[1]);
-
-    p1_rec.SetXYZM(px1_rec, py1_rec, pz1_rec, mass[0]);
-    p2_rec.SetXYZM(px2_rec, py2_rec, pz2_rec, mass[1]);
+    p1_gen.SetXYZM(ev.mom[PX1_GEN], ev.mom[PY1_GEN], ev.mom[PZ1_GEN], mass[0]);
+    p2_gen.SetXYZM(ev.mom[PX2_GEN], ev.mom[PY2_GEN], ev.mom[PZ2_GEN], mass[1]);
 
-    return true;
+    p1_rec.SetXYZM(ev.mom[PX1_REC], ev.mom[PY1_REC], ev.mom[PZ1_REC], mass[0]);
+    p2_rec.SetXYZM(ev.mom[PX2_REC], ev.mom[PY2_REC], ev.mom[PZ2_REC], mass[1]);
 }
@@ -7,6 +7,7 @@
 #
 # Run with: python3 deepnet.py <train> <input>
 #           python3 deepnet.py <predict> <input> <trained model>
+#           python3 deepnet.py <export> <trained model>
 #
 #
 # Tensorboard visualization:
@@ -15,7 +16,10 @@
 # mikael.mieskolainen@cern.ch, 23/07/2018
 
 
+import ctypes
+import os
 import sys
+import struct
 import numpy as np
 import random
 import tensorflow as tf
@@ -98,8 +102,65 @@ output_layer   = {'weight':tf.Variable(SIGMA * tf.random_normal([N_NODES_HL[len(
                     'bias':tf.Variable(tf.zeros([N_CLASS])),}
 
 
-# Read in .csv data
-def read_in_data(filename='', maxcount=1e15, readmode='GEN'):
+# ------------------------------------------------------------------------
+# Native input loader (make deeploader): the event store ./data/*.evt (or .csv)
+# is memory mapped and gathered in C++ into float32 arrays, which numpy wraps
+# without a copy. The csv reader below is used if the library is not built.
+DEEPLOADER = './deeploader.so'
+
+class NativeBuffer:
+    # Frees the C++ buffers when the last numpy view is gone
+    def __init__(self, lib, handle):
+        self.lib    = lib
+        self.handle = handle
+    def __del__(self):
+        self.lib.deeploader_free(self.handle)
+
+def read_in_data_native(filename, maxcount, readmode, cutfile):
+
+    lib = ctypes.CDLL(DEEPLOADER)
+    lib.deeploader_load.restype      = ctypes.c_void_p
+    lib.deeploader_load.argtypes     = [ctypes.c_char_p, ctypes.c_char_p, ctypes.c_longlong, ctypes.c_char_p]
+    lib.deeploader_count.restype     = ctypes.c_longlong
+    lib.deeploader_count.argtypes    = [ctypes.c_void_p]
+    lib.deeploader_features.restype  = ctypes.c_void_p
+    lib.deeploader_features.argtypes = [ctypes.c_void_p]
+    lib.deeploader_labels.restype    = ctypes.c_void_p
+    lib.deeploader_labels.argtypes   = [ctypes.c_void_p]
+    lib.deeploader_free.argtypes     = [ctypes.c_void_p]
+
+    handle = lib.deeploader_load(filename.encode(), readmode.encode(), int(min(maxcount, 2**62)), cutfile.encode())
+    if not handle:
+        return None, None
+    owner = NativeBuffer(lib, handle)
+    n     = lib.deeploader_count(handle)
+    if (n == 0):
+        return np.zeros((0, NDIM), dtype=np.float32), np.zeros((0, 1), dtype=np.float32)
+
+    # Views to the C++ buffers, each keeps the owner alive
+    def wrap(address, shape):
+        buf = (ctypes.c_float * (shape[0] * shape[1])).from_address(address)
+        buf._owner = owner
+        return np.frombuffer(buf, dtype=np.float32).reshape(shape)
+
+    return wrap(lib.deeploader_features(handle), (n, NDIM)), wrap(lib.deeploader_labels(handle), (n, 1))
+
+
+# Read in data, cutfile (e.g. 'fiducial.cfg') applies tighter fiducial cuts
+# than printascii (native loader only). With cuts, the events no longer follow
+# the event index of ./data/<sample>, use them for training only.
+def read_in_data(filename='', maxcount=1e15, readmode='GEN', cutfile=''):
+
+    if os.path.exists(DEEPLOADER):
+        print("Reading input data with: %s" % DEEPLOADER)
+        features, labels = read_in_data_native(filename, maxcount, readmode, cutfile)
+        if features is not None:
+            return features, labels
+        if (cutfile != ''):
+            raise RuntimeError("read_in_data:: Native loader failed with cutfile %s" % cutfile)
+        print("read_in_data:: Native loader failed, reading the csv")
+    elif (cutfile != ''):
+        raise RuntimeError("read_in_data:: Fiducial cuts of %s need the native loader (make deeploader)" % cutfile)
 
     features = []
     labels   = []
@@ -318,9 +379,9 @@ def train_neural_network(train_x, train_y, TRAININGFILE):
 # Run predictions using the network
 def predict_neural_network(input_x, outputfile, inputfile):
 
-    # Write out predictions here
-    outputfile = './output/' + outputfile + '.out'
-    myfile = open(outputfile, 'w')
+    # Write out predictions here (binary, see write_weight_file)
+    samplename = outputfile
+    outputfile = './output/' + samplename + '.wgt'
 
     start = time.time()
 
@@ -345,38 +406,109 @@ def predict_neural_network(input_x, outputfile, inputfile):
         # print predictions using our model
         #for i in enumerate(input_x):
         print("Saving prediction output to: ", outputfile)
-        for i in range(0, len(input_x)):
+        write_weight_file(outputfile, output[:,0])
 
-            prob1 = output[i][0]
-            myfile.write("%0.6f \n" % prob1)
+        # Positional ascii output of the earlier versions
+        if (WRITE_ASCII):
+            with open('./output/' + samplename + '.out', 'w') as myfile:
+                for i in range(0, len(input_x)):
+                    myfile.write("%0.6f \n" % output[i][0])
 
     print('Prediction done for %d vectors in %0.3f sec' % (len(input_x), time.time() - start))
-    myfile.close();
+
+
+# ------------------------------------------------------------------------
+# Binary weight file keyed by the event index (include/weightstore.h):
+# 64 byte header, then float32 weights of the events first, first+1, ...
+# The sample hash and model ID are 0 (unknown) here, deeplot then joins
+# by event index only.
+WRITE_ASCII = False
+
+def write_weight_file(outputfile, weights, first=0):
+
+    weights = np.asarray(weights, dtype='<f4')
+    with open(outputfile + '.tmp', 'wb') as myfile:
+        myfile.write(b'DEEPWGT\0')
+        myfile.write(struct.pack('<IIQQQQ', 1, 0, 0, 0, len(weights), first))
+        myfile.write(b'\0' * 16)
+        myfile.write(weights.tobytes())
+    os.replace(outputfile + '.tmp', outputfile)
+
+
+# ------------------------------------------------------------------------
+# Export the trained network as a flat weight file for the C++ inference
+# (include/mlp.h): header, then per layer (nin, nout, activation) and
+# float32 weights [nin][nout] and biases [nout], little endian
+MLP_LINEAR  = 0
+MLP_TANH    = 1
+MLP_SIGMOID = 2
+
+def export_neural_network(inputfile):
+
+    outputfile = "./modelsave/DEEPNET_" + inputfile + ".mlp"
+
+    with tf.Session() as sess:
+
+        saver = tf.train.Saver()
+
+        # Restore variables from disk.
+        networkfile = "./modelsave/DEEPNET_" + inputfile + ".ckpt"
+        saver.restore(sess, networkfile)
+        print("Using network model: %s" % networkfile)
+
+        # Same layer structure as in neural_network_model()
+        layers = []
+        i = 0
+        while i < len(hidden_layer):
+            layers.append((sess.run(hidden_layer[i]['weight']), sess.run(hidden_layer[i]['bias']), MLP_TANH))
+            i += 1
+        layers.append((sess.run(output_layer['weight']), sess.run(output_layer['bias']), MLP_SIGMOID))
+
+    with open(outputfile, 'wb') as myfile:
+        myfile.write(b'DEEPMLP\0')
+        myfile.write(struct.pack('<II', 1, len(layers)))
+        for weight, bias, activation in layers:
+            myfile.write(struct.pack('<IIII', weight.shape[0], weight.shape[1], activation, 0))
+            myfile.write(np.asarray(weight, dtype='<f4').tobytes())
+            myfile.write(np.asarray(bias,   dtype='<f4').tobytes())
+
+    print("Network exported to: %s" % outputfile)
 
 
 # ------------------------------------------------------------------------
 # Main function
 def main(argv):
 
-    # 1. TRAIN THE NETWORK
+    # 1. TRAIN THE NETWORK (optionally with tighter fiducial cuts from a cut file)
     if (argv[1] == 'train'):
         TRAININGFILE = argv[2]
+        CUTFILE      = argv[3] if len(argv) > 3 else ''
         print("TRAINING mode:: Train input: %s" % TRAININGFILE)
-        train_x, train_y = read_in_data(filename=TRAININGFILE, maxcount=TRAINING_SAMPLES, readmode='GEN')
+        train_x, train_y = read_in_data(filename=TRAININGFILE, maxcount=TRAINING_SAMPLES, readmode='GEN', cutfile=CUTFILE)
         train_neural_network(train_x, train_y, TRAININGFILE)
 
     # 2. USE THE NETWORK FOR PREDICTIONS
     elif (argv[1] == 'predict'):
         PREDICTFILE  = argv[2]
         TRAININGFILE = argv[3]
+        if (len(argv) > 4):
+            # Weights are written for the events 0, 1, ... of ./data/<sample>,
+            # a cut would shift them to other events in deeplot
+            raise ValueError("PREDICTION mode:: No cut file, deeplot applies its fiducial cuts after the weights")
         print("PREDICTION mode:: Prediction input: %s" % PREDICTFILE)
         test_x, test_y   = read_in_data(filename=PREDICTFILE, maxcount=PREDICTION_SAMPLES, readmode='REC')
         predict_neural_network(test_x, PREDICTFILE, TRAININGFILE)
 
+    # 3. EXPORT THE NETWORK FOR C++ INFERENCE (deeplot --mlp)
+    elif (argv[1] == 'export'):
+        TRAININGFILE = argv[2]
+        print("EXPORT mode:: Trained model: %s" % TRAININGFILE)
+        export_neural_network(TRAININGFILE)
+
     else:
         print("DeepEfficiency estimator")
         print("  Usage: ./deepnet <mode>")
-        print("  <mode> = train or predict")
+        print("  <mode> = train <sample> [cutfile], predict <sample> <model> or export <model>")
 
 # Call main
 if __name__ == "__main__":
@@ -0,0 +1,190 @@
+// DeepEfficiency predictions to binary weight files (.wgt)
+// ------------------------------------------------------------------------
+//
+// Compile with makefile: make deeppredict
+//
+// ./deeppredict [--first <event> --count <events> | --shard <i/N>] [--tag <name>] <sample> <model>
+//
+// Evaluates ./modelsave/DEEPNET_<model>.mlp with the reconstruction level
+// momenta of ./data/<sample>.{evt,csv} (as deepnet.py predict) and writes
+// ./output/<sample>.wgt, or ./output/<sample>.shard_<first>.wgt for a range.
+// deeplot joins all of them by event index. With --tag, the files are
+// ./output/<sample>.<name>.wgt (for deeplot --models <name>,...).
+
+
+// C++
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Own
+#include "eventinput.h"
+#include "mlp.h"
+#include "profiler.h"
+#include "weightstore.h"
+
+
+// Network input dimension (as in deepnet.py)
+const int NDIM = 6;
+
+ProfileStage stageread("read");
+ProfileStage stagepredict("predict");
+ProfileStage stagewrite("write");
+
+
+// Main function
+int main(int argc, char* argv[]) {
+
+    const long t0 = ProfileNow();
+
+    uint64_t rangefirst = 0;
+    int64_t rangecount  = -1;
+    int shard   = 0;
+    int nshards = 0;
+    bool partial = false;
+    std::string profilefile;
+    std::string tag;
+    std::vector<std::string> names;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--first" && i + 1 < argc) {
+            rangefirst = strtoull(argv[++i], nullptr, 10);
+            partial = true;
+        } else if (arg == "--count" && i + 1 < argc) {
+            rangecount = std::max(0LL, atoll(argv[++i]));
+            partial = true;
+        } else if (arg == "--shard" && i + 1 < argc) {
+            if (sscanf(argv[++i], "%d/%d", &shard, &nshards) != 2 || nshards < 1 || shard < 0 || shard >= nshards) {
+                printf("Bad --shard %s, expected i/N with 0 <= i < N \n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            partial = true;
+        } else if (arg == "--profile" && i + 1 < argc) {
+            profilefile = argv[++i];
+        } else if (arg == "--tag" && i + 1 < argc) {
+            tag = argv[++i];
+        } else if (!arg.empty() && arg[0] != '-') {
+            names.push_back(arg);
+        } else {
+            names.clear();
+            break;
+        }
+    }
+    if (names.size() != 2 || (nshards > 0 && (rangefirst > 0 || rangecount >= 0))) {
+        printf("Usage: ./deeppredict [--first <event> --count <events> | --shard <i/N>] [--tag <name>] [--profile <file.json>] <sample> <model> \n");
+        return EXIT_FAILURE;
+    }
+    const std::string& sample = names[0];
+    const std::string& model  = names[1];
+
+    // Network
+    const std::string modelfile = "./modelsave/DEEPNET_" + model + ".mlp";
+    MLP network;
+    if (!network.Load(modelfile)) {
+        return EXIT_FAILURE;
+    }
+    if (network.GetNInput() != (size_t)NDIM || network.GetNOutput() != 1) {
+        printf("DeepEfficiency network %s has dimensions %lu -> %lu, expected %d -> 1 \n",
+               modelfile.c_str(), (unsigned long)network.GetNInput(), (unsigned long)network.GetNOutput(), NDIM);
+        return EXIT_FAILURE;
+    }
+    printf("Using network model: %s \n", modelfile.c_str());
+
+    // Kinematics and the event range
+    KinematicsInput input;
+    if (!input.Open(sample)) {
+        return EXIT_FAILURE;
+    }
+    uint64_t first = 0;
+    uint64_t count = 0;
+    if (partial) {
+        const uint64_t total = input.CountEntries();
+        if (nshards > 0) {
+            first = total * shard / nshards;
+            count = total * (shard + 1) / nshards - first;
+        } else {
+            first = std::min(rangefirst, total);
+            count = (rangecount < 0) ? total - first : std::min<uint64_t>(rangecount, total - first);
+        }
+        if (input.Skip(first) < first) {
+            printf("Cannot skip to event %lu of: %s \n", (unsigned long)first, input.GetFilename().c_str());
+            return EXIT_FAILURE;
+        }
+        printf("%s:: Event range [%lu, %lu) of %lu \n", sample.c_str(),
+               (unsigned long)first, (unsigned long)(first + count), (unsigned long)total);
+    }
+    printf("Prediction input: %s \n", input.GetFilename().c_str());
+
+    // Output, identified by the kinematics and network file content
+    std::filesystem::create_directories("./output");
+    const std::string stem = tag.empty() ? sample : sample + "." + tag;
+    const std::string outputfile = partial ? WeightShardName(stem, first) : "./output/" + stem + ".wgt";
+    WeightStoreWriter writer;
+    if (!writer.Open(outputfile, HashFile(input.GetFilename()), HashFile(modelfile), false, first)) {
+        return EXIT_FAILURE;
+    }
+
+    // Reconstruction level momenta (as in deepnet.py predict)
+    EventBlock block;
+    std::vector<float> features;
+    std::vector<float> output;
+    MLPWorkspace workspace;
+    uint64_t n = 0;
+    bool ok = true;
+
+    while (!partial || n < count) {
+        const size_t maxn = partial ? std::min<uint64_t>(EVT_CHUNKSIZE, count - n) : EVT_CHUNKSIZE;
+        size_t m = 0;
+        {
+            ScopedTimer timer(stageread);
+            const uint64_t offset = input.GetOffset();
+            m = input.ReadBlock(block, maxn);
+            timer.Add(m, input.GetOffset() - offset);
+        }
+        if (m == 0) {
+            break;
+        }
+        {
+            ScopedTimer timer(stagepredict);
+            features.resize(m * NDIM);
+            output.resize(m);
+            for (size_t i = 0; i < m; ++i) {
+                for (int j = 0; j < NDIM; ++j) {
+                    features[i * NDIM + j] = block.mom[PX1_REC + j][i];
+                }
+            }
+            network.Predict(m, features.data(), output.data(), workspace);
+            timer.Add(m);
+        }
+        {
+            ScopedTimer timer(stagewrite);
+            ok = writer.Write(output.data(), m);
+            timer.Add(m, m * sizeof(float));
+        }
+        if (!ok) {
+            break;
+        }
+        n += m;
+    }
+    if (input.Error() || (partial && n < count)) {
+        printf("Kinematics inputfile:: Error in reading %s \n", input.GetFilename().c_str());
+        ok = false;
+    }
+    if (ok && writer.Close()) {
+        printf("Prediction done for %lu vectors, saved to: %s \n", (unsigned long)n, outputfile.c_str());
+    } else {
+        writer.Abort();
+        ok = false;
+    }
+
+    PrintProfile("deeppredict", ProfileNow() - t0);
+    if (!profilefile.empty()) {
+        WriteProfileJSON(profilefile, "deeppredict", ProfileNow() - t0);
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,174 @@
+// Native DeepEfficiency network training on the printascii event store
+// ------------------------------------------------------------------------
+//
+// Compile with makefile: make deeptrain
+//
+// ./deeptrain [-t <threads>] [--epochs <N>] [--seed <seed>] [--profile <file.json>] <model>
+//
+// Trains the network of deepnet.py (same structure, initialization,
+// cross-entropy + BETA L2 cost and Adam) on ./data/<model>.{evt,csv}
+// and writes ./modelsave/DEEPNET_<model>.mlp for ./deeplot --mlp.
+
+
+// C++
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Own
+#include "eventinput.h"
+#include "mlptrain.h"
+#include "profiler.h"
+
+
+// Same settings as deepnet.py
+const uint32_t NDIM             = 6;
+const uint32_t N_NODES_HL[]     = {96, 96, 96, 96};
+const uint32_t N_CLASS          = 1;
+const double   TRAINING_SAMPLES = 1e7;
+const float    LEARNINGRATE     = 0.001;
+const float    BETA             = 1e-5;
+const int      EPOCHS           = 10;
+const size_t   BATCH_SIZE       = 64;
+const float    SIGMA            = 0.1;
+const float    EPSILON          = 1e-7;
+
+ProfileStage stageread("read");
+ProfileStage stageepoch("epoch");
+
+
+// Generator level momenta as features and the reco flag as label
+// (the fiducial cut was applied by printascii)
+bool ReadTrainingData(const std::string& model, uint64_t maxcount,
+                      std::vector<float>& features, std::vector<float>& labels) {
+
+    KinematicsInput input;
+    if (!input.Open(model)) {
+        return false;
+    }
+    printf("Reading input data from: %s \n", input.GetFilename().c_str());
+
+    const EvtColumn columns[NDIM] = {PX1_GEN, PY1_GEN, PZ1_GEN, PX2_GEN, PY2_GEN, PZ2_GEN};
+
+    EventBlock block;
+    uint64_t n = 0;
+    while (n < maxcount) {
+        ScopedTimer timer(stageread);
+        const uint64_t offset = input.GetOffset();
+        const size_t m = input.ReadBlock(block, std::min<uint64_t>(EVT_CHUNKSIZE, maxcount - n));
+        if (m == 0) {
+            break;
+        }
+        features.resize((n + m) * NDIM);
+        labels.resize(n + m);
+        for (size_t i = 0; i < m; ++i) {
+            for (uint32_t k = 0; k < NDIM; ++k) {
+                features[(n + i) * NDIM + k] = block.mom[columns[k]][i];
+            }
+            labels[n + i] = block.reco[i];
+        }
+        n += m;
+        timer.Add(m, input.GetOffset() - offset);
+    }
+
+    return !input.Error();
+}
+
+
+// Main function
+int main(int argc, char* argv[]) {
+
+    const long t0 = ProfileNow();
+
+    MLPTrainParam param;
+    param.learningrate = LEARNINGRATE;
+    param.beta         = BETA;
+    param.epsilon      = EPSILON;
+    param.batchsize    = BATCH_SIZE;
+    param.nthreads     = 1;
+
+    int epochs    = EPOCHS;
+    uint64_t seed = 12345;
+    std::string model;
+    std::string profilefile;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "-t" && i + 1 < argc) {
+            param.nthreads = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--epochs" && i + 1 < argc) {
+            epochs = std::max(0, atoi(argv[++i]));
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--profile" && i + 1 < argc) {
+            profilefile = argv[++i];
+        } else if (model.empty() && !arg.empty() && arg[0] != '-') {
+            model = arg;
+        } else {
+            model.clear();
+            break;
+        }
+    }
+    if (model.empty()) {
+        printf("Usage: ./deeptrain [-t <threads>] [--epochs <N>] [--seed <seed>] [--profile <file.json>] <model> \n");
+        return EXIT_FAILURE;
+    }
+    printf("TRAINING mode:: Train input: %s \n", model.c_str());
+
+    std::vector<float> features;
+    std::vector<float> labels;
+    if (!ReadTrainingData(model, TRAINING_SAMPLES, features, labels)) {
+        return EXIT_FAILURE;
+    }
+
+    // Input -> hidden layers (as built in deepnet.py) -> output
+    std::vector<uint32_t> nodes = {NDIM};
+    const size_t nhl = sizeof(N_NODES_HL) / sizeof(N_NODES_HL[0]);
+    for (size_t i = 1; i < nhl; ++i) {
+        nodes.push_back(N_NODES_HL[i]);
+    }
+    nodes.push_back(N_CLASS);
+
+    MLPTrainer trainer;
+    if (!trainer.Init(nodes, SIGMA, seed, param)) {
+        return EXIT_FAILURE;
+    }
+
+    printf("Training with %lu vectors \n", (unsigned long)labels.size());
+    printf("- BATCH_SIZE = %lu \n", (unsigned long)param.batchsize);
+    printf("- LEARNINGRATE = %0.5f \n", param.learningrate);
+    printf("- BETA = %0.3E \n", param.beta);
+    printf("- Threads = %d \n", param.nthreads);
+    printf("Total number of network parameters: %lu \n\n", (unsigned long)trainer.GetNParameters());
+
+    for (int epoch = 0; epoch < epochs; ++epoch) {
+        const long e0 = ProfileNow();
+        double lastcost = 0.0;
+        double meancost = 0.0;
+        {
+            ScopedTimer timer(stageepoch);
+            meancost = trainer.TrainEpoch(labels.size(), features.data(), labels.data(), lastcost);
+            timer.Add(labels.size());
+        }
+        const double dt = (ProfileNow() - e0) * 1e-9;
+        printf("Epoch %03d / %d : Cost = %0.5f (mean %0.5f) in %0.2f sec Remaining %0.2f sec \n",
+               epoch + 1, epochs, lastcost, meancost, dt, (epochs - epoch - 1) * dt);
+    }
+
+    std::filesystem::create_directories("./modelsave");
+    const std::string outputfile = "./modelsave/DEEPNET_" + model + ".mlp";
+    const bool ok = trainer.GetNetwork().Save(outputfile);
+    if (ok) {
+        printf("Model saved in path: %s \n", outputfile.c_str());
+    }
+
+    PrintProfile("deeptrain", ProfileNow() - t0);
+    if (!profilefile.empty()) {
+        WriteProfileJSON(profilefile, "deeptrain", ProfileNow() - t0);
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
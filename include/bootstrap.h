@@ -0,0 +1,81 @@
+// Poisson bootstrap replicas of histograms, filled in the same event pass
+//
+// Each event enters replica r with an integer weight k ~ Poisson(1), drawn
+// by a counter-based generator from (seed, event index, r) only. The replicas
+// thus do not depend on the block size, thread count or fill order, and
+// partial results (--shard) merge into the same replicas as a full run.
+// Replica contents are stored bin-major, [cell][stride] with the replica
+// count padded to BOOT_LANES, so that one fill updates all replicas of
+// a bin with a few vector operations.
+
+
+#ifndef BOOTSTRAP_H
+#define BOOTSTRAP_H
+
+// C++
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// Replicas per vector operation (4 doubles with AVX2)
+const int BOOT_LANES = 4;
+
+// Default generator seed
+const uint64_t BOOT_SEED = 20180723;
+
+// Replica stride of R replicas (padding replicas have weight 0)
+inline int BootstrapStride(int R) {
+    return (R + BOOT_LANES - 1) / BOOT_LANES * BOOT_LANES;
+}
+
+// Poisson(1) weights of the events index[0 ... n-1] for R replicas,
+// as w[n][BootstrapStride(R)]
+void PoissonWeights(size_t n, const uint64_t* index, int R, uint64_t seed, double* w);
+
+
+// Replicas of the sum of weights per histogram cell (ROOT numbering, flow cells included)
+class BootstrapHist {
+
+public:
+    BootstrapHist() {}
+
+    // Replicas of the Poisson weights drawn with seed (see PoissonWeights)
+    void Init(int ncells, int R, uint64_t seed);
+    void Reset();
+
+    // Add w times the Poisson weights p[stride] of one event to a cell
+    void Fill(int cell, const double* __restrict p, double w) {
+        double* __restrict s = sumw_.data() + (size_t)cell * stride_;
+        for (int r = 0; r < stride_; r += BOOT_LANES) {
+            for (int l = 0; l < BOOT_LANES; ++l) {
+                s[r + l] += p[r + l] * w;
+            }
+        }
+    }
+
+    // Merge another set of replicas, false (nothing added) unless the cells,
+    // replicas and seed are the same
+    bool Add(const BootstrapHist& other);
+
+    // Standard deviation over the replicas per cell
+    void GetError(std::vector<double>& err) const;
+
+    bool Enabled() const { return R_ > 0; }
+    int GetNCells() const { return ncells_; }
+    int GetNReplicas() const { return R_; }
+    uint64_t GetSeed() const { return seed_; }
+
+    double Get(int cell, int r) const { return sumw_[(size_t)cell * stride_ + r]; }
+    void Set(int cell, int r, double value) { sumw_[(size_t)cell * stride_ + r] = value; }
+
+private:
+    int ncells_ = 0;
+    int R_      = 0;
+    int stride_ = 0;
+    uint64_t seed_ = 0;
+    std::vector<double> sumw_; // [ncells][stride]
+};
+
+
+#endif
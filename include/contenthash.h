@@ -0,0 +1,20 @@
+// Content hash of byte ranges and files (cache keys, .wgt sample checks)
+
+
+#ifndef CONTENTHASH_H
+#define CONTENTHASH_H
+
+// C++
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+// 64-bit content hash (4 lanes of 8 bytes, not cryptographic)
+uint64_t HashBytes(const char* data, size_t size, uint64_t seed = 0);
+
+// HashBytes() of a whole file, 0 on error (never 0 otherwise)
+uint64_t HashFile(const std::string& filename);
+
+
+#endif
@@ -0,0 +1,41 @@
+// Fast ascii kinematics parser for the printascii.cc layout
+//
+// Fast path: vectorized delimiter scan (SSE2 / AVX2) and an exact
+// fixed-point float parser for plain decimals such as "%0.6f" output.
+// Anything unusual (exponents, inf/nan, long mantissas, whitespace)
+// falls back to the locale-aware strtod path, so results are always
+// bitwise identical to fscanf("%lf").
+
+
+#ifndef CSVPARSE_H
+#define CSVPARSE_H
+
+// Own
+#include "eventstore.h"
+
+
+// Parse one line [s, lineend) of 12 floats and 3 integers.
+// bufend is the end of the readable buffer (>= lineend), the fast path
+// may read ahead up to there but never beyond.
+bool ParseCSVLine(const char* s, const char* lineend, const char* bufend, EventRecord& ev);
+
+// Fast path only, returns the position of the terminating newline
+// or nullptr if the line is not in the plain layout
+const char* ParseCSVLineFast(const char* s, const char* bufend, EventRecord& ev);
+
+// Slow reference path (strtod / strtol)
+bool ParseCSVLineSlow(const char* s, const char* lineend, EventRecord& ev);
+
+// Find the first maxn delimiters (',' or '\n') starting from s, stop after the
+// first '\n'. Returns the number of delimiters written to delim.
+int ScanDelimiters(const char* s, const char* bufend, const char** delim, int maxn);
+
+// Exact parse of [s, end) as a plain decimal number, returns false if the
+// field is not of the simple form [-]digits[.digits] with <= 15 digits
+bool ParseFixedDouble(const char* s, const char* end, double& value);
+
+// Parse of [s, end) as [-]digits
+bool ParseFixedInt(const char* s, const char* end, int& value);
+
+
+#endif
@@ -0,0 +1,135 @@
+// Memory mapped kinematics (.evt / .csv) and DeepEfficiency weight (.out) input
+//
+// Events are handed out in blocks directly from the mapped files,
+// without per-event system calls or stdio locking.
+
+
+#ifndef EVENTINPUT_H
+#define EVENTINPUT_H
+
+// C++
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Own
+#include "eventstore.h"
+#include "mmapfile.h"
+
+
+// Zero-copy view to one chunk of a mapped event store
+struct EvtChunkView {
+    uint64_t n     = 0;               // Number of events
+    uint64_t first = 0;               // Index of the first event in the sample
+    const char* column[N_EVTCOLUMNS]; // Raw column data (type as in the schema)
+    uint32_t    type[N_EVTCOLUMNS];
+};
+
+
+// Kinematics input, binary event store or ascii
+class KinematicsInput {
+
+public:
+    KinematicsInput() {}
+
+    // Open ./data/<name>.evt if available, otherwise ./data/<name>.csv
+    bool Open(const std::string& name, const std::string& datapath = "./data/");
+
+    // Open explicit file, format from the extension
+    bool OpenFile(const std::string& filename);
+    void Close();
+
+    // Read up to maxn events, returns the number of events read (0 at the end)
+    size_t ReadBlock(EventBlock& block, size_t maxn);
+
+    // Read the next event
+    bool Next(EventRecord& ev);
+
+    // Skip n events, returns the number skipped (less at the end)
+    uint64_t Skip(uint64_t n);
+
+    // Number of events in the file (ascii files are scanned for lines)
+    uint64_t CountEntries() const;
+
+    // Use the vectorized ascii parser (default), false for the strtod path
+    void SetFastParse(bool fast) { fastparse_ = fast; }
+
+    bool IsBinary() const { return binary_; }
+    bool Error() const { return error_; }
+    const std::string& GetFilename() const { return file_.GetFilename(); }
+
+    // Total number of events (known in advance only for the event store)
+    uint64_t GetEntries() const { return binary_ ? header_.nevents : 0; }
+
+    // Bytes of the file consumed so far (in whole chunks for the event store)
+    uint64_t GetOffset() const {
+        return binary_ ? ((chunk_ < chunkoffset_.size()) ? chunkoffset_[chunk_] : file_.Size()) : pos_;
+    }
+
+    // Event store chunk access
+    uint64_t GetNChunks() const { return chunkoffset_.size(); }
+    bool GetChunkView(uint64_t i, EvtChunkView& view) const;
+
+private:
+    size_t ReadBlockEVT(EventBlock& block, size_t maxn);
+    size_t ReadBlockCSV(EventBlock& block, size_t maxn);
+
+    MappedFile file_;
+    bool binary_    = false;
+    bool error_     = false;
+    bool fastparse_ = true;
+    uint64_t nread_ = 0;          // Events handed out so far
+
+    // Event store
+    EvtFileHeader header_;
+    std::vector<EvtColumnDesc> columns_;
+    std::vector<uint64_t> chunkoffset_;
+    std::vector<uint64_t> chunkfirst_;
+    uint64_t chunk_    = 0;       // Current chunk
+    uint64_t chunkpos_ = 0;       // Position inside the current chunk
+
+    // Ascii
+    size_t pos_ = 0;              // Byte position in the file
+
+    // For Next()
+    EventBlock buffer_;
+    size_t buffer_pos_ = 0;
+};
+
+
+// DeepEfficiency weights, one number per line
+class WeightInput {
+
+public:
+    WeightInput() {}
+
+    bool Open(const std::string& filename);
+    void Close();
+
+    // Read up to maxn weights, returns the number read (0 at the end)
+    size_t Read(double* dst, size_t maxn);
+
+    // Read the next weight
+    bool Next(double& weight);
+
+    // Skip n weights, returns the number skipped (less at the end)
+    uint64_t Skip(uint64_t n);
+
+    // Number of weights in the whole file (independent of the read position)
+    uint64_t CountEntries() const;
+
+    bool Error() const { return error_; }
+    const std::string& GetFilename() const { return file_.GetFilename(); }
+
+    // Bytes of the file consumed so far
+    uint64_t GetOffset() const { return pos_; }
+
+private:
+    MappedFile file_;
+    size_t pos_     = 0;
+    uint64_t nread_ = 0;
+    bool error_     = false;
+};
+
+
+#endif
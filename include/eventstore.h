@@ -0,0 +1,163 @@
+// Binary columnar event store (.evt) for the two-track kinematics
+//
+// File layout (native little endian):
+//
+//   [EvtFileHeader][EvtColumnDesc x ncolumns] padded to EVT_ALIGN
+//   [EvtChunkHeader][column 0][column 1] ... [column N-1]   (chunk 0)
+//   [EvtChunkHeader][column 0][column 1] ... [column N-1]   (chunk 1)
+//   ...
+//
+// Each column inside a chunk is a contiguous array of nevents values,
+// padded to EVT_ALIGN bytes, so a chunk can be read (or mapped) as is.
+// The column order is the same as in the .csv export.
+
+
+#ifndef EVENTSTORE_H
+#define EVENTSTORE_H
+
+// C++
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// Format identification
+const char     EVT_MAGIC[8]   = {'D','E','E','P','E','V','T','\0'};
+const uint32_t EVT_VERSION    = 1;
+const uint32_t EVT_CHUNKMAGIC = 0x4B4E4843; // "CHNK"
+const uint32_t EVT_ALIGN      = 64;         // Byte alignment of headers and columns
+const uint32_t EVT_CHUNKSIZE  = 65536;      // Default number of events per chunk
+
+// Column data types
+enum EvtType : uint32_t {
+    EVT_F32 = 1,
+    EVT_F64 = 2,
+    EVT_I16 = 3,
+    EVT_I32 = 4,
+    EVT_U8  = 5
+};
+
+// Column indices (same order as in the .csv export)
+enum EvtColumn {
+    PX1_GEN, PY1_GEN, PZ1_GEN,
+    PX2_GEN, PY2_GEN, PZ2_GEN,
+    PX1_REC, PY1_REC, PZ1_REC,
+    PX2_REC, PY2_REC, PZ2_REC,
+    PIDCODE1, PIDCODE2,
+    RECO,
+    N_EVTCOLUMNS
+};
+
+// Number of momentum columns
+const int NKIN = 12;
+
+// Column names as written to the schema
+extern const char* EVT_COLUMNNAMES[N_EVTCOLUMNS];
+
+// Size of one value of type
+uint32_t EvtTypeSize(uint32_t type);
+
+// Round up to alignment
+inline uint64_t EvtAlign(uint64_t bytes) {
+    return (bytes + EVT_ALIGN - 1) / EVT_ALIGN * EVT_ALIGN;
+}
+
+
+// On-disk headers
+struct EvtFileHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t ncolumns;
+    uint64_t nevents;    // Total number of events (patched at close)
+    uint64_t nchunks;    // Total number of chunks (patched at close)
+    uint32_t chunksize;  // Maximum number of events per chunk
+    uint32_t flags;
+    uint64_t dataoffset; // Byte offset of the first chunk
+    char     reserved[16];
+};
+
+struct EvtColumnDesc {
+    char     name[24];
+    uint32_t type;
+    uint32_t reserved;
+};
+
+struct EvtChunkHeader {
+    uint32_t magic;
+    uint32_t reserved;
+    uint64_t nevents;    // Number of events in this chunk
+    uint64_t nbytes;     // Chunk size in bytes including this header
+    char     pad[EVT_ALIGN - 24];
+};
+
+static_assert(sizeof(EvtFileHeader)  == 64, "EvtFileHeader size");
+static_assert(sizeof(EvtColumnDesc)  == 32, "EvtColumnDesc size");
+static_assert(sizeof(EvtChunkHeader) == EVT_ALIGN, "EvtChunkHeader size");
+
+
+// Single event
+struct EventRecord {
+    double mom[NKIN] = {0.0}; // Generated and reconstructed 3-momenta
+    int pidCode[2]   = {0};
+    int reco         = 0;
+};
+
+// Block of events in structure-of-arrays form
+struct EventBlock {
+    std::vector<double> mom[NKIN];
+    std::vector<int> pidCode[2];
+    std::vector<int> reco;
+
+    size_t   n     = 0; // Number of events in the block
+    uint64_t first = 0; // Index of the first event in the whole sample
+
+    void Resize(size_t size);
+    void Get(size_t i, EventRecord& ev) const;
+    void Set(size_t i, const EventRecord& ev);
+};
+
+
+// Writer
+class EventStoreWriter {
+
+public:
+    EventStoreWriter() {}
+    ~EventStoreWriter() { Close(); }
+
+    // doubleprec = true stores the momenta as 64-bit floats
+    bool Open(const std::string& filename, bool doubleprec = false,
+              uint32_t chunksize = EVT_CHUNKSIZE);
+    bool Write(const EventRecord& ev);
+    bool Close();
+
+    uint64_t GetEntries() const { return nevents_; }
+
+private:
+    bool FlushChunk();
+
+    FILE* fp_ = nullptr;
+    EvtFileHeader header_;
+    std::vector<EvtColumnDesc> columns_;
+    EventBlock buffer_;
+
+    uint64_t nevents_ = 0;
+    uint64_t nchunks_ = 0;
+};
+
+
+// Size in bytes of a chunk of nevents, including its header
+uint64_t EvtChunkBytes(const std::vector<EvtColumnDesc>& columns, uint64_t nevents);
+
+// Parse schema description in the header, returns false if not compatible
+bool EvtCheckSchema(const EvtFileHeader& header, const std::vector<EvtColumnDesc>& columns);
+
+// Decode one column from raw chunk data to double / int
+void EvtDecodeColumn(const char* src, uint32_t type, size_t n, double* dst);
+void EvtDecodeColumn(const char* src, uint32_t type, size_t n, int* dst);
+
+// Concatenate event stores with the same schema (e.g. conversion shards) in order
+bool EvtConcatenate(const std::vector<std::string>& inputs, const std::string& output);
+
+
+#endif
@@ -0,0 +1,154 @@
+// Native fixed-binning histograms (1D and 2D)
+//
+// Contiguous sum-w and sum-w^2 arrays with ROOT bin numbering
+// (0 = underflow, N+1 = overflow) and the same bin lookup arithmetic
+// as TAxis::FindFixBin, so that converting to TH1D/TH2D gives the same
+// contents, errors and statistics as filling the ROOT histogram directly.
+
+
+#ifndef FASTHIST_H
+#define FASTHIST_H
+
+// C++
+#include <algorithm>
+#include <vector>
+
+// ROOT
+#include "TH1.h"
+#include "TH2.h"
+
+
+// Uniform axis
+struct FastAxis {
+    int N        = 0;
+    double min   = 0.0;
+    double max   = 0.0;
+
+    FastAxis() {}
+    FastAxis(int n, double lo, double hi) : N(n), min(lo), max(hi) {}
+
+    // Branch-free bin lookup, same arithmetic as TAxis::FindFixBin
+    int FindBin(double x) const {
+        double t = N * (x - min) / (max - min);
+        t = std::max(-1.0, std::min((double)N, t)); // Avoid int overflow, NaN goes to overflow
+        int bin = 1 + (int)t;
+        bin = (x < min) ? 0     : bin;
+        bin = (x < max) ? bin   : N + 1;
+        return bin;
+    }
+
+    // Bin lookup for an array (auto-vectorized)
+    void FindBins(size_t n, const double* __restrict x, int* __restrict bin) const {
+        for (size_t i = 0; i < n; ++i) {
+            bin[i] = FindBin(x[i]);
+        }
+    }
+};
+
+
+class FastHist1D {
+
+public:
+    FastHist1D() {}
+    FastHist1D(int N, double minval, double maxval) { Init(N, minval, maxval); }
+
+    void Init(int N, double minval, double maxval);
+    void Reset();
+
+    void Fill(double x, double w) {
+        FillBin(axis_.FindBin(x), x, w);
+    }
+
+    // Fill with a precomputed bin index
+    void FillBin(int bin, double x, double w) {
+        entries_ += 1.0;
+        sumw_[bin]  += w;
+        sumw2_[bin] += w*w;
+
+        // Statistics only for in-range fills (ROOT default)
+        if (bin > 0 && bin <= axis_.N) {
+            stats_[0] += w;
+            stats_[1] += w*w;
+            stats_[2] += w*x;
+            stats_[3] += w*x*x;
+        }
+    }
+
+    // Merge another histogram (e.g. a per-thread shard)
+    void Add(const FastHist1D& other);
+
+    // Copy contents, errors, entries and statistics into a ROOT histogram
+    void ToROOT(TH1D* h) const;
+
+    const FastAxis& GetAxis() const { return axis_; }
+    const double* GetSumw()  const { return sumw_.data(); }
+    const double* GetSumw2() const { return sumw2_.data(); }
+    double* GetSumw()  { return sumw_.data(); }
+    double* GetSumw2() { return sumw2_.data(); }
+    double* GetStats() { return stats_; }
+    double& GetEntries() { return entries_; }
+    double GetEntries() const { return entries_; }
+
+private:
+    FastAxis axis_;
+    std::vector<double> sumw_;
+    std::vector<double> sumw2_;
+    double stats_[4] = {0.0};  // sumw, sumw2, sumwx, sumwx2
+    double entries_ = 0.0;
+};
+
+
+class FastHist2D {
+
+public:
+    FastHist2D() {}
+    FastHist2D(int N1, double minval1, double maxval1, int N2, double minval2, double maxval2) {
+        Init(N1, minval1, maxval1, N2, minval2, maxval2);
+    }
+
+    void Init(int N1, double minval1, double maxval1, int N2, double minval2, double maxval2);
+    void Reset();
+
+    void Fill(double x, double y, double w) {
+        FillBin(xaxis_.FindBin(x), yaxis_.FindBin(y), x, y, w);
+    }
+
+    // Fill with precomputed bin indices
+    void FillBin(int binx, int biny, double x, double y, double w) {
+        const int bin = biny * (xaxis_.N + 2) + binx;
+        entries_ += 1.0;
+        sumw_[bin]  += w;
+        sumw2_[bin] += w*w;
+
+        if (binx > 0 && binx <= xaxis_.N && biny > 0 && biny <= yaxis_.N) {
+            stats_[0] += w;
+            stats_[1] += w*w;
+            stats_[2] += w*x;
+            stats_[3] += w*x*x;
+            stats_[4] += w*y;
+            stats_[5] += w*y*y;
+            stats_[6] += w*x*y;
+        }
+    }
+
+    void Add(const FastHist2D& other);
+    void ToROOT(TH2D* h) const;
+
+    const FastAxis& GetXaxis() const { return xaxis_; }
+    const FastAxis& GetYaxis() const { return yaxis_; }
+    double* GetSumw()  { return sumw_.data(); }
+    double* GetSumw2() { return sumw2_.data(); }
+    double* GetStats() { return stats_; }
+    double& GetEntries() { return entries_; }
+
+private:
+    FastAxis xaxis_;
+    FastAxis yaxis_;
+    std::vector<double> sumw_;
+    std::vector<double> sumw2_;
+    double stats_[7] = {0.0};  // sumw, sumw2, sumwx, sumwx2, sumwy, sumwy2, sumwxy
+    double entries_ = 0.0;
+};
+
+
+#endif
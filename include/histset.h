@@ -0,0 +1,148 @@
+// Full set of deeplot histogram triplets for one sample
+
+
+#ifndef HISTSET_H
+#define HISTSET_H
+
+// C++
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ROOT
+#include "TH1.h"
+
+// Own
+#include "tripletclass.h"
+#include "kinematics.h"
+
+
+// Histogram archive format version
+const int HISTSET_VERSION = 1;
+
+// Event counters of a sample or a part of it (--first/--count, --shard),
+// in entries of the kinematics input
+struct SampleCounters {
+    uint64_t first     = 0; // First entry of the range
+    uint64_t nentries  = 0; // Entries read
+    uint64_t nfiducial = 0; // Events filled (within fiducial)
+    uint64_t total     = 0; // Entries in the full sample
+};
+
+
+class HistSet {
+
+public:
+    HistSet(const std::string& PREDICTFILE, HistBackend backend = BACKEND_ROOT);
+    ~HistSet();
+
+    HistSet(const HistSet&) = delete;
+    HistSet& operator=(const HistSet&) = delete;
+
+    void Fill(bool reco, const Observables& gen, const Observables& rec, double weight) {
+
+        // 1D
+        h1M->Fill(reco, gen.M, rec.M, weight);
+        h1Y->Fill(reco, gen.Y, rec.Y, weight);
+        h1Pt->Fill(reco, gen.Pt, rec.Pt, weight);
+        h1pt1->Fill(reco, gen.pt1, rec.pt1, weight);
+        h1eta1->Fill(reco, gen.eta1, rec.eta1, weight);
+        h1dY->Fill(reco, gen.dY, rec.dY, weight);
+
+        // 2D
+        h2etaphi->Fill(reco, gen.eta1, gen.phi1, rec.eta1, rec.phi1, weight);
+        h2etaeta->Fill(reco, gen.eta1, gen.eta2, rec.eta1, rec.eta2, weight);
+        h2Mdeltaphi->Fill(reco, gen.M, gen.deltaphi, rec.M, rec.deltaphi, weight);
+        h2MPt->Fill(reco, gen.M, gen.Pt, rec.M, rec.Pt, weight);
+        h2Mpt1->Fill(reco, gen.M, gen.pt1, rec.M, rec.pt1, weight);
+        h2pt1pt2->Fill(reco, gen.pt1, gen.pt2, rec.pt1, rec.pt2, weight);
+
+        // DEBUG fills
+        h1W->Fill(1.0/weight);
+    }
+
+    // Fill n events at once, same result as n calls to Fill() in order. Bootstrap
+    // replicas are filled only here, keyed by the event indices (index) of the sample.
+    void FillBatch(size_t n, const ObservablesBlock& gen, const ObservablesBlock& rec,
+                   const unsigned char* reco, const double* weight,
+                   const uint64_t* index = nullptr);
+
+    // Keep R Poisson bootstrap replicas of all reconstructed and corrected histograms
+    void EnableBootstrap(int R, uint64_t seed = BOOT_SEED);
+    int GetNBootstrap() const { return nboot_; }
+    uint64_t GetBootstrapSeed() const { return bootseed_; }
+
+    // Several efficiency models with shared generated and reconstructed histograms,
+    // the first filled by FillBatch(), model k >= 1 by FillModel() with the same events
+    void SetModels(const std::vector<std::string>& labels);
+    size_t GetNModels() const { return std::max<size_t>(1, models_.size()); }
+    const std::vector<std::string>& GetModels() const { return models_; }
+    void FillModel(size_t k, size_t n, const ObservablesBlock& rec, const unsigned char* reco,
+                   const double* weight);
+
+    // Merge another set (filled from a disjoint part of the sample) with the same
+    // bootstrap replicas and models, false (nothing added) otherwise
+    bool Add(const HistSet& other);
+
+    // Copy native backend contents to the ROOT histograms (done by Chi2())
+    void Sync();
+
+    // Chi2 tests of all 1D-triplets, returns the average chi2/ndf (of the first model)
+    double Chi2();
+
+    // Figures: 1D-triplets first, then 2D-triplets and the weight distribution
+    size_t GetNFigures() const { return h1.size() + h2.size() + 1; }
+    void SaveFig(size_t i);
+
+    // Plot and save all figures
+    void SaveFig();
+
+    // Write histograms with a manifest and counters (<path>/histograms.root)
+    // and chi2 values (<path>/chi2.txt, one column per model, if chi2 is true)
+    bool Write(const std::string& path, bool chi2 = true) const;
+
+    // Read back histograms written by Write(), the manifest must match this set
+    bool Read(const std::string& path);
+
+    // Archive layout: sample, histogram names and binnings (not styling)
+    std::string Manifest() const;
+
+    std::string name_;
+
+    // (Generated, Reconstructed, Corrected) 1D-histogram triplets
+    std::vector<h1Triplet*> h1;
+    h1Triplet* h1M;
+    h1Triplet* h1Y;
+    h1Triplet* h1Pt;
+    h1Triplet* h1pt1;
+    h1Triplet* h1eta1;
+    h1Triplet* h1dY;
+
+    // (Generated, Reconstructed, Corrected) 2D-histogram triplets
+    std::vector<h2Triplet*> h2;
+    h2Triplet* h2etaphi;
+    h2Triplet* h2etaeta;
+    h2Triplet* h2pt1pt2;
+    h2Triplet* h2Mdeltaphi;
+    h2Triplet* h2MPt;
+    h2Triplet* h2Mpt1;
+
+    // DeepEfficiency output distribution
+    TH1D* h1W;
+
+    // Events behind the histograms
+    SampleCounters counters;
+
+private:
+    // Labels of the efficiency models, empty for one
+    std::vector<std::string> models_;
+
+    // Bootstrap replicas and the Poisson weights of a block
+    int nboot_ = 0;
+    uint64_t bootseed_ = BOOT_SEED;
+    std::vector<double> poisson_;
+};
+
+
+#endif
@@ -0,0 +1,112 @@
+// Two-track kinematics and observables in structure-of-arrays form
+//
+// ComputeObservables() evaluates all pair observables for a block of
+// events from (px,py,pz,m) columns. Magnitudes, energies and transverse
+// momenta are computed once per track and shared by the derived
+// quantities, and the formulas follow TLorentzVector / TVector3
+// (SetXYZM, Y, Perp, PseudoRapidity, Rapidity, Phi, DeltaPhi, M).
+
+
+#ifndef KINEMATICS_H
+#define KINEMATICS_H
+
+// C++
+#include <cstdlib>
+#include <vector>
+
+
+// Particle mass
+const double mPI = 0.139570;
+const double mK  = 0.493677;
+
+// Mass assignment by PDG code (zero for unknown)
+inline double PIDMass(int pdg) {
+    if (std::abs(pdg) == 211) { // Charged pion
+        return mPI;
+    }
+    if (std::abs(pdg) == 321) { // Charged kaon
+        return mK;
+    }
+    return 0.0;
+}
+
+
+// Observables of one event (generator or reconstruction level)
+struct Observables {
+    double M;        // System mass
+    double Y;        // System y-momentum (TLorentzVector::Y(), not the rapidity)
+    double Pt;       // System transverse momentum
+    double dY;       // Rapidity difference y1 - y2
+    double eta1;     // Track 1 pseudorapidity
+    double eta2;     // Track 2 pseudorapidity
+    double phi1;     // Track 1 azimuth
+    double pt1;      // Track 1 transverse momentum
+    double pt2;      // Track 2 transverse momentum
+    double deltaphi; // Pair azimuthal difference
+};
+
+
+// Observables of a block of events (structure-of-arrays)
+struct ObservablesBlock {
+    std::vector<double> M;
+    std::vector<double> Y;
+    std::vector<double> Pt;
+    std::vector<double> dY;
+    std::vector<double> eta1;
+    std::vector<double> eta2;
+    std::vector<double> phi1;
+    std::vector<double> pt1;
+    std::vector<double> pt2;
+    std::vector<double> deltaphi;
+
+    void Resize(size_t n) {
+        for (std::vector<double>* v : {&M, &Y, &Pt, &dY, &eta1, &eta2, &phi1, &pt1, &pt2, &deltaphi}) {
+            v->resize(n);
+        }
+    }
+    void Set(size_t i, const Observables& obs) {
+        M[i]        = obs.M;
+        Y[i]        = obs.Y;
+        Pt[i]       = obs.Pt;
+        dY[i]       = obs.dY;
+        eta1[i]     = obs.eta1;
+        eta2[i]     = obs.eta2;
+        phi1[i]     = obs.phi1;
+        pt1[i]      = obs.pt1;
+        pt2[i]      = obs.pt2;
+        deltaphi[i] = obs.deltaphi;
+    }
+    void Get(size_t i, Observables& obs) const {
+        obs.M        = M[i];
+        obs.Y        = Y[i];
+        obs.Pt       = Pt[i];
+        obs.dY       = dY[i];
+        obs.eta1     = eta1[i];
+        obs.eta2     = eta2[i];
+        obs.phi1     = phi1[i];
+        obs.pt1      = pt1[i];
+        obs.pt2      = pt2[i];
+        obs.deltaphi = deltaphi[i];
+    }
+
+    // Keep entries i < n with mask[i] != 0 (in order), returns their number
+    size_t Select(size_t n, const unsigned char* mask);
+};
+
+
+// Momentum columns of one track
+struct TrackColumns {
+    const double* px;
+    const double* py;
+    const double* pz;
+    const double* m;
+};
+
+// Observables of n events into obs[0 ... n-1]
+void ComputeObservables(size_t n, const TrackColumns& t1, const TrackColumns& t2, ObservablesBlock& obs);
+
+// Masses by PDG code for n events
+void AssignMasses(size_t n, const int* pidCode, double* mass);
+
+
+#endif
@@ -0,0 +1,83 @@
+// DeepEfficiency MLP inference (float32, batched)
+//
+// Network exported from deepnet.py (python3 deepnet.py export <model>)
+// or trained with deeptrain, as a flat little endian weight file (.mlp):
+//
+//   char     magic[8]       "DEEPMLP\0"
+//   uint32_t version
+//   uint32_t nlayers
+//   per layer:
+//     uint32_t nin, nout, activation, reserved
+//     float    W[nin][nout]  (row-major, same as TensorFlow matmul(x, W))
+//     float    b[nout]
+
+
+#ifndef MLP_H
+#define MLP_H
+
+// C++
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// Format identification
+const char     MLP_MAGIC[8] = {'D','E','E','P','M','L','P','\0'};
+const uint32_t MLP_VERSION  = 1;
+
+// Events per inner batch of the forward pass (activations stay in cache)
+const size_t MLP_BATCH = 64;
+
+// Layer activations
+enum MLPActivation : uint32_t {
+    MLP_LINEAR  = 0,
+    MLP_TANH    = 1,
+    MLP_SIGMOID = 2
+};
+
+// Fully connected layer: y = f(x W + b)
+struct MLPLayer {
+    uint32_t nin        = 0;
+    uint32_t nout       = 0;
+    uint32_t activation = MLP_LINEAR;
+    std::vector<float> W; // [nin][nout]
+    std::vector<float> b; // [nout]
+};
+
+// Scratch buffers of one evaluating thread
+struct MLPWorkspace {
+    std::vector<float> a;
+    std::vector<float> b;
+};
+
+
+// Dense layer for n rows: y[n][nout] = x[n][nin] W[nin][nout] + b[nout]
+void MLPDense(size_t n, size_t nin, size_t nout, const float* x, const float* W, const float* b, float* y);
+
+// Layer activation of n values in place
+void MLPActivate(uint32_t activation, size_t n, float* x);
+
+
+class MLP {
+
+public:
+    MLP() {}
+
+    bool Load(const std::string& filename);
+    bool Save(const std::string& filename) const;
+
+    // Evaluate n input vectors x[n][nin] into out[n][nout]
+    void Predict(size_t n, const float* x, float* out, MLPWorkspace& ws) const;
+
+    size_t GetNInput()  const { return layers_.empty() ? 0 : layers_.front().nin; }
+    size_t GetNOutput() const { return layers_.empty() ? 0 : layers_.back().nout; }
+    const std::string& GetFilename() const { return filename_; }
+
+    std::vector<MLPLayer> layers_;
+
+private:
+    std::string filename_;
+};
+
+
+#endif
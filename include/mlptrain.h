@@ -0,0 +1,103 @@
+// DeepEfficiency MLP training (float32, data parallel mini-batches)
+//
+// The same objective and optimizer as deepnet.py:
+//
+//   cost = sum_batch CE(clip(p, EPSILON, 1 - EPSILON), y) + BETA * sum_W |W|^2 / 2
+//
+// minimized with Adam (TensorFlow AdamOptimizer update rule). Hidden layers
+// are tanh, the output layer a single sigmoid. Each mini-batch is split
+// into row ranges over the threads, each thread runs the forward and
+// backward passes of its rows with the dense layer kernel of the inference,
+// and the gradients are reduced and applied by parameter range in parallel.
+// For a fixed number of threads the result is deterministic.
+
+
+#ifndef MLPTRAIN_H
+#define MLPTRAIN_H
+
+// C++
+#include <cstdint>
+#include <vector>
+
+// Own
+#include "mlp.h"
+
+
+class SpinBarrier;
+
+// Hyperparameters
+struct MLPTrainParam {
+    float learningrate = 0.001f;
+    float beta         = 1e-5f;    // L2 regularization of the weights (not biases)
+    float epsilon      = 1e-7f;    // Clipping of the prediction in the cross-entropy
+    float adambeta1    = 0.9f;
+    float adambeta2    = 0.999f;
+    float adamepsilon  = 1e-8f;
+    size_t batchsize   = 64;
+    int nthreads       = 1;
+};
+
+// Scratch buffers of one training thread
+struct MLPTrainWorkspace {
+    std::vector<std::vector<float>> a; // Layer outputs [rows][nout]
+    std::vector<float> xt;             // Transposed layer input [nin][rows]
+    std::vector<float> delta;          // Cost gradient of the layer pre-activation [rows][nout]
+    std::vector<float> dnext;          // ... of the layer below
+    std::vector<float> grad;           // Gradient of all parameters
+    double loss = 0.0;                 // Cross-entropy sum of the rows
+    double reg  = 0.0;                 // Sum of squared weights of the parameter range
+};
+
+
+class MLPTrainer {
+
+public:
+    MLPTrainer() {}
+
+    // Network nodes[0] -> nodes[1] -> ... -> 1, hidden layers tanh and output sigmoid,
+    // weights sigma * N(0,1) and zero biases
+    bool Init(const std::vector<uint32_t>& nodes, float sigma, uint64_t seed,
+              const MLPTrainParam& param = MLPTrainParam());
+
+    // One pass over x[n][nin] with labels y[n] in mini-batches (in order),
+    // returns the mean cost per batch and the cost of the last batch
+    double TrainEpoch(size_t n, const float* x, const float* y, double& lastcost);
+
+    size_t GetNParameters() const { return nparam_; }
+    const MLP& GetNetwork() const { return net_; }
+
+private:
+    // Parameter array of the network
+    struct Segment {
+        float* param;        // Weights or biases of a layer
+        float* transpose;    // Transposed copy of the weights (nullptr for biases)
+        size_t offset;       // Index in the flat gradient and moment arrays
+        size_t size;
+        size_t nin;
+        size_t nout;
+    };
+
+    void Worker(int t, size_t n, const float* x, const float* y, SpinBarrier& barrier,
+                double& sumcost, double& lastcost);
+    void Gradient(MLPTrainWorkspace& ws, size_t m, const float* x, const float* y);
+    void Update(int t, uint64_t step);
+
+    MLP net_;
+    MLPTrainParam param_;
+    std::vector<Segment> segments_;
+    std::vector<std::vector<float>> WT_; // Transposed weights [nout][nin] of each layer
+    std::vector<float> zeros_;           // Zero bias of the gradient products
+    size_t nparam_ = 0;
+    size_t maxwidth_ = 0;
+
+    // Adam
+    std::vector<float> m_;
+    std::vector<float> v_;
+    uint64_t step_ = 0;
+
+    std::vector<MLPTrainWorkspace> ws_;
+    std::vector<float> gsum_;            // Reduced gradient
+};
+
+
+#endif
@@ -0,0 +1,46 @@
+// Read-only memory mapped file
+
+
+#ifndef MMAPFILE_H
+#define MMAPFILE_H
+
+// C++
+#include <cstddef>
+#include <string>
+
+
+class MappedFile {
+
+public:
+    MappedFile() {}
+    ~MappedFile() { Close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // sequential = true hints the kernel for read-ahead
+    bool Open(const std::string& filename, bool sequential = true);
+    void Close();
+
+    const char* Data() const { return data_; }
+    size_t Size() const { return size_; }
+    bool IsOpen() const { return fd_ >= 0; }
+    const std::string& GetFilename() const { return filename_; }
+
+    // Release already consumed pages [0, offset) from the page cache hint
+    void Consumed(size_t offset);
+
+private:
+    int fd_ = -1;
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    size_t released_ = 0;
+    std::string filename_;
+};
+
+
+// Check if file exists
+bool FileExists(const std::string& filename);
+
+
+#endif
@@ -0,0 +1,133 @@
+// On-disk cache of the observable columns of a sample (./cache/<sample>.obs)
+//
+// File layout (native endian):
+//
+//   [ObsCacheHeader]
+//   [ObsChunkHeader][gen M ... deltaphi][rec M ... deltaphi][reco][fiducial]   (chunk 0)
+//   [ObsChunkHeader] ...                                                       (chunk 1)
+//
+// Observables are stored as doubles for every event of the kinematics input
+// (not only the fiducial ones), so positional weights still match. The cache
+// is valid for one key, a hash of the kinematics file content, the mass
+// assignment and the fiducial cuts. It is written to <file>.tmp and renamed
+// only after the full input has been read.
+
+
+#ifndef OBSCACHE_H
+#define OBSCACHE_H
+
+// C++
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Own
+#include "contenthash.h"
+#include "kinematics.h"
+#include "mmapfile.h"
+#include "selection.h"
+
+
+// Format identification, bump the version if the observables change
+const char     OBSCACHE_MAGIC[8] = {'D','E','E','P','O','B','S','\0'};
+const uint32_t OBSCACHE_VERSION  = 2;
+
+// Observables per level (M, Y, Pt, dY, eta1, eta2, phi1, pt1, pt2, deltaphi)
+const int N_OBSCOLUMNS = 10;
+
+// On-disk headers
+struct ObsCacheHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t key;        // ObsCacheKey() of the input
+    uint64_t nevents;    // Total number of events (patched at close)
+    uint64_t nchunks;    // Total number of chunks (patched at close)
+    char     reserved[24];
+};
+
+struct ObsChunkHeader {
+    uint64_t first;      // Index of the first event in the sample
+    uint64_t nevents;    // Number of events in this chunk
+};
+
+static_assert(sizeof(ObsCacheHeader) == 64, "ObsCacheHeader size");
+static_assert(sizeof(ObsChunkHeader) == 16, "ObsChunkHeader size");
+
+
+// Cache key of a kinematics file of HashFile() inputhash with the current
+// masses and cuts, 0 on error (inputhash 0)
+uint64_t ObsCacheKey(uint64_t inputhash, const Selection& selection);
+
+
+// Writer, blocks may arrive in any order from several threads
+class ObsCacheWriter {
+
+public:
+    ObsCacheWriter() {}
+    ~ObsCacheWriter() { Abort(); }
+
+    bool Open(const std::string& filename, uint64_t key);
+
+    // Observables, reco flags and fiducial mask of events [first, first + n)
+    // (thread safe, written to the file in event order)
+    bool Write(uint64_t first, size_t n, const ObservablesBlock& gen, const ObservablesBlock& rec,
+               const int* reco, const unsigned char* fiducial);
+
+    // Finalize the file, returns false (and removes it) if events are missing
+    bool Close();
+
+    // Remove the unfinished file
+    void Abort();
+
+    bool IsOpen() const { return fp_ != nullptr; }
+
+private:
+    bool Flush();
+
+    FILE* fp_ = nullptr;
+    std::string filename_;
+    ObsCacheHeader header_;
+    bool error_ = false;
+
+    std::mutex mutex_;
+    uint64_t next_ = 0;                             // Next event index to be written
+    std::map<uint64_t, std::vector<char>> pending_; // Encoded chunks ahead of next_
+};
+
+
+// Reader
+class ObsCacheReader {
+
+public:
+    ObsCacheReader() {}
+
+    // Open a finalized cache with the given key, false if missing or stale
+    bool Open(const std::string& filename, uint64_t key);
+    void Close() { file_.Close(); }
+
+    // Read up to maxn events, returns the number of events read (0 at the end)
+    size_t ReadBlock(size_t maxn, uint64_t& first, ObservablesBlock& gen, ObservablesBlock& rec,
+                     std::vector<int>& reco, std::vector<unsigned char>& fiducial);
+
+    uint64_t GetEntries() const { return header_.nevents; }
+
+    // Bytes of the file consumed so far (in whole chunks)
+    uint64_t GetOffset() const {
+        return (chunk_ < chunkoffset_.size()) ? chunkoffset_[chunk_] : file_.Size();
+    }
+
+private:
+    MappedFile file_;
+    ObsCacheHeader header_;
+    std::vector<uint64_t> chunkoffset_;
+    uint64_t chunk_    = 0;
+    uint64_t chunkpos_ = 0;
+    uint64_t nread_    = 0;
+};
+
+
+#endif
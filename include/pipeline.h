@@ -0,0 +1,67 @@
+// Streaming pipeline building blocks: bounded queue (stages are timed with profiler.h)
+
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+// C++
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+
+// Fixed capacity blocking queue (ring buffer, no allocation after construction)
+template <typename T>
+class BoundedQueue {
+
+public:
+    explicit BoundedQueue(size_t capacity) : buffer_(capacity) {}
+
+    // Blocks while full, returns false if the queue is closed
+    bool Push(const T& item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notfull_.wait(lock, [this]() { return size_ < buffer_.size() || closed_; });
+        if (closed_) {
+            return false;
+        }
+        buffer_[(head_ + size_) % buffer_.size()] = item;
+        ++size_;
+        notempty_.notify_one();
+        return true;
+    }
+
+    // Blocks while empty, returns false when closed and drained
+    bool Pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notempty_.wait(lock, [this]() { return size_ > 0 || closed_; });
+        if (size_ == 0) {
+            return false;
+        }
+        item  = buffer_[head_];
+        head_ = (head_ + 1) % buffer_.size();
+        --size_;
+        notfull_.notify_one();
+        return true;
+    }
+
+    // No more pushes, wakes up all waiting threads
+    void Close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        notempty_.notify_all();
+        notfull_.notify_all();
+    }
+
+private:
+    std::vector<T> buffer_;
+    size_t head_ = 0;
+    size_t size_ = 0;
+    bool closed_ = false;
+
+    std::mutex mutex_;
+    std::condition_variable notempty_;
+    std::condition_variable notfull_;
+};
+
+
+#endif
@@ -0,0 +1,24 @@
+// Global ROOT plot style and single histogram figures
+
+
+#ifndef PLOTSTYLE_H
+#define PLOTSTYLE_H
+
+// C++
+#include <string>
+
+// ROOT
+#include "TH1.h"
+
+
+// Global Style Setup
+void SetROOTStyle();
+
+// Set "nice" 2D-plot style
+void SetPlotStyle();
+
+// Plot and save a filled 1D-histogram to ./figs/<name>.pdf
+void PlotFilled(TH1D* h1, std::string& name, bool logscale, bool normalize);
+
+
+#endif
@@ -0,0 +1,119 @@
+// Stage timing and throughput counters
+//
+// Stages are global objects, timed with scoped (RAII) timers:
+//
+//   ProfileStage stageparse("parse");
+//   ...
+//   {
+//       ScopedTimer timer(stageparse);
+//       ...
+//       timer.Add(nevents, nbytes);
+//   }
+//
+// A timer costs two clock reads, so it is placed around blocks of events,
+// not single events. Counters are atomic and the timers of several threads
+// add up (busy time, which can exceed the wall time). Time a stage spends
+// blocked on its input or output queues (deeplot --pipeline) is timed with
+// ScopedWait, a stage with little waiting is the bottleneck.
+
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+// C++
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+
+// Steady clock in nanoseconds
+inline long ProfileNow() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+// Counters of one stage, registered for the summary at construction
+class ProfileStage {
+
+public:
+    explicit ProfileStage(const std::string& name);
+
+    ProfileStage(const ProfileStage&) = delete;
+    ProfileStage& operator=(const ProfileStage&) = delete;
+
+    // One timed call
+    void Add(long ns, long events, long bytes) {
+        ncalls  += 1;
+        busy    += ns;
+        nevents += events;
+        nbytes  += bytes;
+    }
+
+    // Events or bytes outside of a timed call
+    void Count(long events, long bytes) {
+        nevents += events;
+        nbytes  += bytes;
+    }
+
+    std::string name_;
+
+    std::atomic<long> ncalls{0};
+    std::atomic<long> busy{0};    // Time inside timers (ns)
+    std::atomic<long> wait{0};    // Time blocked on queues (ns)
+    std::atomic<long> nevents{0};
+    std::atomic<long> nbytes{0};
+};
+
+
+// Times its scope into a stage
+class ScopedTimer {
+
+public:
+    explicit ScopedTimer(ProfileStage& stage) : stage_(stage), t0_(ProfileNow()) {}
+    ~ScopedTimer() { stage_.Add(ProfileNow() - t0_, events_, bytes_); }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    void Add(long events, long bytes = 0) {
+        events_ += events;
+        bytes_  += bytes;
+    }
+
+private:
+    ProfileStage& stage_;
+    long t0_;
+    long events_ = 0;
+    long bytes_  = 0;
+};
+
+
+// Times its scope as waiting of a stage
+class ScopedWait {
+
+public:
+    explicit ScopedWait(ProfileStage& stage) : stage_(stage), t0_(ProfileNow()) {}
+    ~ScopedWait() { stage_.wait += ProfileNow() - t0_; }
+
+    ScopedWait(const ScopedWait&) = delete;
+    ScopedWait& operator=(const ScopedWait&) = delete;
+
+private:
+    ProfileStage& stage_;
+    long t0_;
+};
+
+
+// All stages in order of construction
+const std::vector<ProfileStage*>& GetProfileStages();
+
+// Summary table of all stages with wall time wallns
+void PrintProfile(const std::string& title, long wallns);
+
+// JSON report of all stages (with host, time and thread count for comparisons)
+bool WriteProfileJSON(const std::string& filename, const std::string& title, long wallns);
+
+
+#endif
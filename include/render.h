@@ -0,0 +1,38 @@
+// Deferred figure rendering in parallel worker processes
+//
+// Figures are queued as jobs while the samples are processed and rendered
+// at the end by forked worker processes. Each worker sees a copy-on-write
+// snapshot of the filled histograms, so ROOT graphics (not thread safe)
+// runs single threaded inside every process.
+
+
+#ifndef RENDER_H
+#define RENDER_H
+
+// C++
+#include <functional>
+#include <mutex>
+#include <vector>
+
+
+class RenderQueue {
+
+public:
+    RenderQueue() {}
+
+    // Add one figure job (thread safe)
+    void Push(const std::function<void()>& job);
+
+    // Render all queued jobs with nproc worker processes and clear the queue,
+    // returns false if a worker failed. Call with no other threads running.
+    bool Run(int nproc);
+
+    size_t Size() const { return jobs_.size(); }
+
+private:
+    std::mutex mutex_;
+    std::vector<std::function<void()>> jobs_;
+};
+
+
+#endif
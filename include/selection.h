@@ -0,0 +1,150 @@
+// Track pair selection (fiducial phase space) from a cut file
+//
+// Cuts are read from a text file, one cut per line, applied to both tracks:
+//
+//   # <variable> <operator> <value>
+//   pt     > 0.1
+//   abseta < 0.9
+//
+// Variables: px, py, pz, pt, p, eta, abseta; operators: <, <=, >, >=.
+// The cut list is compiled into sqrt free tests on raw px, py, pz
+// (pt > c as px^2 + py^2 > c^2, |eta| < c as pz^2 < sinh^2(c) pt^2, ...),
+// ordered from the cheapest to the most expensive.
+
+
+#ifndef SELECTION_H
+#define SELECTION_H
+
+// C++
+#include <string>
+#include <vector>
+
+// Own
+#include "eventstore.h"
+
+
+// Default cut file and its built-in content (used if the default file does not exist)
+const char SELECTION_FILE[]    = "./fiducial.cfg";
+const char SELECTION_DEFAULT[] = "pt > 0.1\nabseta < 0.9\n";
+
+// Cut variables
+enum CutVariable {
+    CUT_PX, CUT_PY, CUT_PZ, CUT_PT, CUT_P, CUT_ETA, CUT_ABSETA
+};
+
+// Comparison operators
+enum CutOperator {
+    CUT_LT, CUT_LE, CUT_GT, CUT_GE
+};
+
+// Cut as written in the file
+struct Cut {
+    CutVariable variable;
+    CutOperator op;
+    double value;
+};
+
+// Cut lowered to a test on px, py, pz, pt2 = px^2 + py^2 and pz2 = pz^2
+struct CompiledCut {
+    enum Form {
+        NEVER,   // Never passes
+        LINEAR,  // p[comp] op c
+        QUAD,    // a*pt2 + b*pz2 op c
+        ETA      // sinh(eta) = pz / pt compared with s = sinh(c), a = s^2
+    };
+    Form form;
+    CutOperator op;
+    int comp    = 0;
+    double a    = 0.0;
+    double b    = 0.0;
+    double c    = 0.0;
+    double s    = 0.0;
+    int cost    = 0;   // Evaluation order
+};
+
+
+class Selection {
+
+public:
+    Selection() {}
+
+    // Read cuts from SELECTION_FILE, the built-in default if it does not exist
+    bool LoadDefault();
+
+    // Read cuts from a file, false if it cannot be read
+    bool Load(const std::string& filename);
+
+    // Parse cuts from text, source is used in messages
+    bool Parse(const std::string& text, const std::string& source);
+
+    // Both tracks {px, py, pz} pass all cuts
+    inline bool Pass(const double* t1, const double* t2) const;
+
+    // Selection mask of a block from the track columns starting at first
+    // (PX1_GEN or PX1_REC), returns the number of events passing
+    size_t Select(const EventBlock& block, unsigned char* mask, int first = PX1_GEN) const;
+
+    void Print() const;
+
+    const std::vector<Cut>& GetCuts() const { return cuts_; }
+    const std::string& GetSource() const { return source_; }
+
+private:
+    void Compile();
+    static inline bool Compare(double x, CutOperator op, double c);
+    static inline bool Test(const CompiledCut& cut, const double* t, double pt2, double pz2);
+
+    std::vector<Cut> cuts_;
+    std::vector<CompiledCut> compiled_;
+    std::string source_;
+};
+
+
+inline bool Selection::Compare(double x, CutOperator op, double c) {
+    switch (op) {
+        case CUT_LT: return x <  c;
+        case CUT_LE: return x <= c;
+        case CUT_GT: return x >  c;
+        default:     return x >= c;
+    }
+}
+
+inline bool Selection::Test(const CompiledCut& cut, const double* t, double pt2, double pz2) {
+    switch (cut.form) {
+        case CompiledCut::NEVER:
+            return false;
+        case CompiledCut::LINEAR:
+            return Compare(t[cut.comp], cut.op, cut.c);
+        case CompiledCut::QUAD:
+            return Compare(cut.a * pt2 + cut.b * pz2, cut.op, cut.c);
+        default: {
+            // pz op s pt, by the sign of pz and |pz| versus |s| pt (q = 0 at the edge)
+            const double q = pz2 - cut.a * pt2;
+            switch (cut.op) {
+                case CUT_LT: return (cut.s >= 0) ? (t[2] < 0 || q <  0) : (t[2] < 0 && q >  0);
+                case CUT_LE: return (cut.s >= 0) ? (t[2] < 0 || q <= 0) : (t[2] < 0 && q >= 0);
+                case CUT_GT: return (cut.s <= 0) ? (t[2] > 0 || q <  0) : (t[2] > 0 && q >  0);
+                default:     return (cut.s <= 0) ? (t[2] > 0 || q <= 0) : (t[2] > 0 && q >= 0);
+            }
+        }
+    }
+}
+
+inline bool Selection::Pass(const double* t1, const double* t2) const {
+
+    const double pt2_1 = t1[0]*t1[0] + t1[1]*t1[1];
+    const double pz2_1 = t1[2]*t1[2];
+    const double pt2_2 = t2[0]*t2[0] + t2[1]*t2[1];
+    const double pz2_2 = t2[2]*t2[2];
+
+    // Cheapest cuts first, on both tracks before the next cut
+    for (size_t k = 0; k < compiled_.size(); ++k) {
+        if (!Test(compiled_[k], t1, pt2_1, pz2_1) || !Test(compiled_[k], t2, pt2_2, pz2_2)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+#endif
@@ -0,0 +1,112 @@
+// Monte Carlo tree2track (.root) input with branch pruning and bulk basket reads
+//
+// Only the branches of the event store schema are activated, and they are
+// read one basket at a time (ROOT bulk API) into contiguous float / int
+// columns instead of event by event through TTree::GetEntry.
+
+
+#ifndef TREEINPUT_H
+#define TREEINPUT_H
+
+// C++
+#include <memory>
+#include <string>
+#include <vector>
+
+// ROOT
+#include "Rtypes.h"
+#include "TBufferFile.h"
+
+// Own
+#include "eventstore.h"
+
+class TBranch;
+class TFile;
+class TTree;
+
+
+// Tree branches of the event store columns (EvtColumn order, RECO is derived)
+const int N_TREEBRANCHES = PIDCODE2 + 1;
+extern const char* TREE_BRANCHNAMES[N_TREEBRANCHES];
+
+
+// Input size accounting of one reader (or summed over readers)
+struct TreeReadStats {
+    int nbranches       = 0;   // Branches in the tree
+    int nactive         = 0;   // Branches read
+    Long64_t nentries   = 0;   // Entries in the range
+    double totbytes_all = 0;   // Uncompressed bytes over the range, all branches
+    double zipbytes_all = 0;   // Compressed bytes over the range, all branches
+    double totbytes     = 0;   // Uncompressed bytes over the range, active branches
+    double zipbytes     = 0;   // Compressed bytes over the range, active branches
+    Long64_t bytesread  = 0;   // Bytes actually read from the file
+    bool bulk           = false;
+
+    void Add(const TreeReadStats& other);
+    void Print(const std::string& title) const;
+};
+
+
+class TreeInput {
+
+public:
+    TreeInput() {}
+    ~TreeInput() { Close(); }
+
+    // Open tree2track of a .root file for entries [first, last), last < 0 for all.
+    // Bulk basket reads unless disabled or not supported by the branches.
+    bool Open(const std::string& filename, Long64_t first = 0, Long64_t last = -1, bool bulk = true);
+    void Close();
+
+    // Read up to maxn events, returns the number of events read (0 at the end)
+    size_t ReadBlock(EventBlock& block, size_t maxn);
+
+    bool Error() const { return error_; }
+    bool IsBulk() const { return bulk_; }
+    const std::string& GetFilename() const { return filename_; }
+
+    // Entries in the whole tree, first entry of the range
+    Long64_t GetEntries() const { return nentries_; }
+    Long64_t GetFirst() const { return first_; }
+
+    TreeReadStats GetStats() const;
+
+private:
+    // One active branch
+    struct Column {
+        TBranch* branch = nullptr;
+        std::unique_ptr<TBufferFile> buffer;
+        Long64_t basketfirst = 0;  // First entry of the buffered basket
+        Long64_t basketn     = 0;  // Entries in the buffered basket
+        char* data = nullptr;      // Serialized (big endian) values of the basket
+        union {
+            Float_t f;
+            Int_t   i;
+        } value;                   // Address for the TTree::GetEntry fallback
+    };
+
+    bool LoadBasket(Column& column, Long64_t entry);
+    template <typename T>
+    bool ReadColumn(Column& column, Long64_t entry, size_t n, T* dst);
+
+    TFile* file_ = nullptr;
+    TTree* tree_ = nullptr;
+    std::string filename_;
+    Column columns_[N_TREEBRANCHES];
+
+    bool bulk_  = false;
+    bool error_ = false;
+    Long64_t nentries_ = 0;
+    Long64_t first_    = 0;
+    Long64_t last_     = 0;
+    Long64_t next_     = 0;
+
+    // Contiguous columns in the tree types
+    std::vector<Float_t> mom_[NKIN];
+    std::vector<Int_t> pidCode_[2];
+
+    TreeReadStats stats_;
+};
+
+
+#endif
@@ -7,24 +7,52 @@
 #define TRIPLETCLASS_H
 
 // C++
+#include <algorithm>
 #include <string>
+#include <vector>
 
 // ROOT
 #include "TH1.h"
 #include "TH2.h"
 #include "TCanvas.h"
 
+// Own
+#include "bootstrap.h"
+#include "fasthist.h"
+
+
+// Histogram filling backend
+enum HistBackend {
+    BACKEND_ROOT,   // Fill TH1D/TH2D directly
+    BACKEND_NATIVE  // Fill FastHist arrays, converted to TH1D/TH2D by Sync()
+};
+
 
 class h1Triplet {
 
 public:
     h1Triplet(const std::string& name, const std::string& labeltext, 
-            int N, double minval, double maxval, const std::string& legendposition);
+            int N, double minval, double maxval, const std::string& legendposition,
+            HistBackend backend = BACKEND_ROOT);
     ~h1Triplet() {
         delete hTrue; delete hReco; delete hCorr; delete h2ObsWeight;
+        delete hCorrBoot; delete hRecoBoot;
+        for (size_t k = 0; k < hCorrModel.size(); ++k) {
+            delete hCorrModel[k];
+        }
     }
     
     void Fill(bool reco, double x_gen, double x_rec, double weight) {
+
+        if (native_) {
+            fTrue.Fill(x_gen, 1.0);
+            if (reco == true) {
+                fReco.Fill(x_rec, 1.0);
+                fCorr.Fill(x_rec, weight);
+                f2ObsWeight.Fill(x_rec, 1.0/weight, 1.0);
+            }
+            return;
+        }
         
         hTrue->Fill(x_gen, 1.0);        // Generated
 
@@ -37,20 +65,98 @@ public:
         }
     }
 
-    // Plot and save 1D-histogram triplet (left linear, right logarithmic)
-    double SaveFig();
+    // Fill a block of n events given as arrays (reco is the reconstruction mask),
+    // with their Poisson weights [n][BootstrapStride(R)] if bootstrap is enabled
+    void FillBatch(size_t n, const double* x_gen, const double* x_rec,
+                   const unsigned char* reco, const double* weight,
+                   const double* poisson = nullptr);
+
+    // Keep R Poisson bootstrap replicas of hReco and hCorr (filled by FillBatch
+    // with the Poisson weights of seed)
+    void EnableBootstrap(int R, uint64_t seed);
+
+    // Corrected histograms of several efficiency models sharing hTrue and hReco,
+    // hCorr is the first model (filled by FillBatch), the others by FillCorr
+    void SetModels(const std::vector<std::string>& labels);
+    size_t GetNModels() const { return 1 + hCorrModel.size(); }
+    TH1D* GetCorr(size_t k) const { return (k == 0) ? hCorr : hCorrModel[k - 1]; }
+
+    // Fill the corrected histogram of model k >= 1 (events as given to FillBatch)
+    void FillCorr(size_t k, size_t n, const double* x_rec, const unsigned char* reco, const double* weight);
+
+    // Merge another triplet with the same binning and backend, false (nothing
+    // added) if the bootstrap replicas differ
+    bool Add(const h1Triplet& other) {
+        if (!bReco.Add(other.bReco) || !bCorr.Add(other.bCorr)) {
+            return false;
+        }
+        const size_t nmodels = std::min(hCorrModel.size(), other.hCorrModel.size());
+        if (native_) {
+            fTrue.Add(other.fTrue);
+            fReco.Add(other.fReco);
+            fCorr.Add(other.fCorr);
+            f2ObsWeight.Add(other.f2ObsWeight);
+            for (size_t k = 0; k < nmodels; ++k) {
+                fCorrModel[k].Add(other.fCorrModel[k]);
+            }
+            return true;
+        }
+        hTrue->Add(other.hTrue);
+        hReco->Add(other.hReco);
+        hCorr->Add(other.hCorr);
+        h2ObsWeight->Add(other.h2ObsWeight);
+        for (size_t k = 0; k < nmodels; ++k) {
+            hCorrModel[k]->Add(other.hCorrModel[k]);
+        }
+        return true;
+    }
+
+    // Copy native backend contents (and bootstrap replicas) to the ROOT histograms
+    void Sync();
+
+    // Copy bootstrap replicas back from the ROOT histograms (after reading them)
+    void LoadBootstrap();
+
+    // Chi2 test of the corrected against the generated histogram (chi2/ndf),
+    // for each model (returns the first)
+    double Chi2();
+
+    // Plot and save 1D-histogram triplet (left linear, right logarithmic),
+    // with the corrected histograms of all models overlaid
+    void SaveFig();
 
     std::string name_;
     int N_;
     double minval_;
     double maxval_;
     std::string legendposition_;
+    double chi2ndf_ = -1.0; // From Chi2(), negative if not done
+    std::vector<double> chi2ndfs_; // Of each model
 
     TH1D* hTrue;
     TH1D* hReco;
     TH1D* hCorr;
 
-    TH2D* h2ObsWeight; // Control plot
+    TH2D* h2ObsWeight; // Control plot (first model)
+
+    // Further models
+    std::vector<std::string> models_; // Labels of all models, empty for one
+    std::vector<TH1D*> hCorrModel;
+    std::vector<FastHist1D> fCorrModel;
+
+    // Bootstrap replicas of the first model, [cell][replica] as (N+2) x R histograms
+    TH2D* hRecoBoot = nullptr;
+    TH2D* hCorrBoot = nullptr;
+    BootstrapHist bReco;
+    BootstrapHist bCorr;
+    FastAxis axis_;
+
+    // Native backend
+    bool native_;
+    FastHist1D fTrue;
+    FastHist1D fReco;
+    FastHist1D fCorr;
+    FastHist2D f2ObsWeight;
 
     //ClassDef(h1Triplet,1);         // ROOT system integration
 };
@@ -59,12 +165,26 @@ class h2Triplet {
 
 public:
     h2Triplet(const std::string& name, const std::string& labeltext,
-            int N1, double minval1, double maxval1, int N2, double minval2, double maxval2);
+            int N1, double minval1, double maxval1, int N2, double minval2, double maxval2,
+            HistBackend backend = BACKEND_ROOT);
     ~h2Triplet() {
         delete hTrue; delete hReco; delete hCorr;
+        delete hCorrBoot; delete hRecoBoot;
+        for (size_t k = 0; k < hCorrModel.size(); ++k) {
+            delete hCorrModel[k];
+        }
     }
 
     void Fill(bool reco, double x_gen, double y_gen, double x_rec, double y_rec, double weight) {
+
+        if (native_) {
+            fTrue.Fill(x_gen, y_gen, 1.0);
+            if (reco == true) {
+                fReco.Fill(x_rec, y_rec, 1.0);
+                fCorr.Fill(x_rec, y_rec, weight);
+            }
+            return;
+        }
         
         hTrue->Fill(x_gen, y_gen, 1.0);        // Generated
 
@@ -74,10 +194,62 @@ public:
         }
     }
 
-    // Plot and save 2D-histogram triplet
+    // Fill a block of n events given as arrays (reco is the reconstruction mask),
+    // with their Poisson weights [n][BootstrapStride(R)] if bootstrap is enabled
+    void FillBatch(size_t n, const double* x_gen, const double* y_gen,
+                   const double* x_rec, const double* y_rec,
+                   const unsigned char* reco, const double* weight,
+                   const double* poisson = nullptr);
+
+    // Keep R Poisson bootstrap replicas of hReco and hCorr (filled by FillBatch
+    // with the Poisson weights of seed)
+    void EnableBootstrap(int R, uint64_t seed);
+
+    // Corrected histograms of several efficiency models (as in h1Triplet)
+    void SetModels(const std::vector<std::string>& labels);
+    size_t GetNModels() const { return 1 + hCorrModel.size(); }
+    TH2D* GetCorr(size_t k) const { return (k == 0) ? hCorr : hCorrModel[k - 1]; }
+
+    // Fill the corrected histogram of model k >= 1 (events as given to FillBatch)
+    void FillCorr(size_t k, size_t n, const double* x_rec, const double* y_rec,
+                  const unsigned char* reco, const double* weight);
+
+    // Merge another triplet with the same binning and backend, false (nothing
+    // added) if the bootstrap replicas differ
+    bool Add(const h2Triplet& other) {
+        if (!bReco.Add(other.bReco) || !bCorr.Add(other.bCorr)) {
+            return false;
+        }
+        const size_t nmodels = std::min(hCorrModel.size(), other.hCorrModel.size());
+        if (native_) {
+            fTrue.Add(other.fTrue);
+            fReco.Add(other.fReco);
+            fCorr.Add(other.fCorr);
+            for (size_t k = 0; k < nmodels; ++k) {
+                fCorrModel[k].Add(other.fCorrModel[k]);
+            }
+            return true;
+        }
+        hTrue->Add(other.hTrue);
+        hReco->Add(other.hReco);
+        hCorr->Add(other.hCorr);
+        for (size_t k = 0; k < nmodels; ++k) {
+            hCorrModel[k]->Add(other.hCorrModel[k]);
+        }
+        return true;
+    }
+
+    // Copy native backend contents (and bootstrap replicas) to the ROOT histograms
+    void Sync();
+
+    // Copy bootstrap replicas back from the ROOT histograms (after reading them)
+    void LoadBootstrap();
+
+    // Plot and save 2D-histogram triplet (one column per model)
     double SaveFig();
 
     std::string name_;
+    std::string labeltext_;
     int N1_;
     int N2_;
 
@@ -85,6 +257,25 @@ public:
     TH2D* hReco;
     TH2D* hCorr;
 
+    // Further models
+    std::vector<std::string> models_; // Labels of all models, empty for one
+    std::vector<TH2D*> hCorrModel;
+    std::vector<FastHist2D> fCorrModel;
+
+    // Bootstrap replicas of the first model, [cell][replica] as (N1+2)*(N2+2) x R histograms
+    TH2D* hRecoBoot = nullptr;
+    TH2D* hCorrBoot = nullptr;
+    BootstrapHist bReco;
+    BootstrapHist bCorr;
+    FastAxis xaxis_;
+    FastAxis yaxis_;
+
+    // Native backend
+    bool native_;
+    FastHist2D fTrue;
+    FastHist2D fReco;
+    FastHist2D fCorr;
+
     //ClassDef(h2Triplet,1);         // ROOT system integration
 };
 
@@ -0,0 +1,152 @@
+// Binary DeepEfficiency weight files (.wgt), keyed by the event index
+//
+// File layout (native little endian):
+//
+//   [WeightFileHeader]
+//   float weight[nevents]                 (dense: events first, first + 1, ...)
+// or
+//   [WeightRecord x nevents]              (indexed: increasing event index)
+//
+// The event index is the position of the event in ./data/<sample>.{evt,csv}.
+// A sample can be covered by several files (e.g. one per prediction shard,
+// ./output/<sample>.shard_<first>.wgt), which are joined against the
+// kinematics stream in event order. The sample hash (content of the
+// kinematics file) and model ID (content of the network file) identify
+// what the weights were predicted from, 0 if unknown.
+
+
+#ifndef WEIGHTSTORE_H
+#define WEIGHTSTORE_H
+
+// C++
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Own
+#include "contenthash.h"
+#include "mmapfile.h"
+
+
+// Format identification
+const char     WGT_MAGIC[8] = {'D','E','E','P','W','G','T','\0'};
+const uint32_t WGT_VERSION  = 1;
+
+// Header flags
+enum WeightFileFlags : uint32_t {
+    WGT_INDEXED = 1      // (index, weight) records instead of a dense range
+};
+
+// On-disk header and record
+struct WeightFileHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t samplehash; // HashFile() of the kinematics file, 0 if unknown
+    uint64_t modelid;    // HashFile() of the network file, 0 if unknown
+    uint64_t nevents;    // Number of weights (patched at close)
+    uint64_t first;      // Index of the first event (dense files)
+    char     reserved[16];
+};
+
+struct WeightRecord {
+    uint64_t index;
+    float    weight;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(WeightFileHeader) == 64, "WeightFileHeader size");
+static_assert(sizeof(WeightRecord) == 16, "WeightRecord size");
+
+
+// Weight files of a sample: <path><sample>.wgt and <path><sample>.shard_<first>.wgt
+std::vector<std::string> FindWeightFiles(const std::string& sample, const std::string& path = "./output/");
+
+// Name of the shard starting at event first
+std::string WeightShardName(const std::string& sample, uint64_t first, const std::string& path = "./output/");
+
+
+// Writer
+class WeightStoreWriter {
+
+public:
+    WeightStoreWriter() {}
+    ~WeightStoreWriter() { Abort(); }
+
+    // Dense file of the events from first on, or indexed file
+    bool Open(const std::string& filename, uint64_t samplehash, uint64_t modelid,
+              bool indexed = false, uint64_t first = 0);
+
+    // Weights of the next n events (dense)
+    bool Write(const float* weight, size_t n);
+
+    // Weight of event index, in increasing order (indexed)
+    bool Write(uint64_t index, float weight);
+
+    // Finalize the file (written to <file>.tmp, renamed here)
+    bool Close();
+
+    // Remove the unfinished file
+    void Abort();
+
+private:
+    FILE* fp_ = nullptr;
+    std::string filename_;
+    WeightFileHeader header_;
+    uint64_t last_ = 0;  // Last written index (indexed)
+    bool error_ = false;
+};
+
+
+// Merge-join reader of one or more weight files
+class WeightStoreReader {
+
+public:
+    WeightStoreReader() {}
+
+    // Open the files, ordered by their first event, false if they overlap
+    bool Open(const std::vector<std::string>& filenames);
+    void Close();
+
+    // Any file has the hash of its kinematics file
+    bool HasSampleHash() const;
+
+    // All files with a sample hash match the HashFile() of kinematicsfile
+    bool CheckSample(uint64_t hash, const std::string& kinematicsfile) const;
+
+    // Weights of the events [first, first + n) present in the files, with found[i]
+    // set for them; returns their number. Calls must have increasing first, weights
+    // of skipped events are counted as unmatched.
+    size_t Join(uint64_t first, size_t n, double* weight, unsigned char* found);
+
+    // All weights consumed
+    bool Done() const { return part_ == parts_.size(); }
+
+    uint64_t GetEntries() const { return nentries_; }
+    uint64_t GetNUnmatched() const { return nunmatched_; }
+    uint64_t GetModelID() const { return parts_.empty() ? 0 : parts_.front()->header.modelid; }
+
+    // Bytes of the files consumed so far
+    uint64_t GetOffset() const { return offset_; }
+
+private:
+    struct Part {
+        MappedFile file;
+        WeightFileHeader header;
+        uint64_t first = 0;  // Index of the first event
+        uint64_t last  = 0;  // Index of the last event
+        uint64_t pos   = 0;  // Next weight
+    };
+
+    std::vector<std::unique_ptr<Part>> parts_;
+    size_t part_ = 0;            // Current file
+    uint64_t nentries_   = 0;
+    uint64_t nunmatched_ = 0;
+    uint64_t offset_     = 0;
+    uint64_t base_       = 0;    // Bytes of the finished files
+};
+
+
+#endif
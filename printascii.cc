@@ -1,33 +1,82 @@
-// Monte Carlo .ROOT tree file to ascii (.csv)
+// Monte Carlo .ROOT tree file to binary event store (.evt) and ascii (.csv)
 // ------------------------------------------------------------------
 //
-// Run with: root printascii.cc+ -b -q
+// Run with: root -e 'gSystem->AddIncludePath("-Iinclude")' printascii.cc+ -b -q
+//
+// Parallel conversion: ... 'printascii.cc+(<files in parallel>, <workers per file>)' -b -q
+// or standalone:        make printascii && ./printascii -j <files in parallel> -t <workers per file>
 //
 // mikael.mieskolainen@cern.ch, 26/07/2018
 
 
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <thread>
 #include <vector>
 #include "TFile.h"
+#include "TROOT.h"
 #include "TString.h"
-#include "TLorentzVector.h"
 #include "TTree.h"
 
-const double M = 0; // Particle mass (not needed here)
+// Own
+#include "include/eventstore.h"
+#include "include/profiler.h"
+#include "include/selection.h"
+#include "include/treeinput.h"
+#include "src/eventstore.cc" // ACLiC compiles this macro as a single unit
+#include "src/profiler.cc"
+#include "src/selection.cc"
+#include "src/treeinput.cc"
 
-bool ProcessData(const TString& filename);
+bool ProcessData(const TString& filename, int nworkers);
+bool ConvertRange(const TString& filename, Long64_t first, Long64_t last,
+                  const TString& evtfile, const TString& csvfile, ULong64_t& naccepted,
+                  TreeReadStats& stats);
+bool ConcatenateFiles(const std::vector<std::string>& inputs, const std::string& output);
+long FileBytes(const std::string& filename);
 
 
 // ****************** FIDUCIAL DEFINITION ******************
 // We cut events here for the DeepEfficiency training phase
 // Note that these should be kept the same through whole
-// algorithmic chain!
-const double FID_PT  = 0.1; // track pt
-const double FID_ETA = 0.9; // track eta
+// algorithmic chain! Cuts are read from ./fiducial.cfg,
+// the same file as used by deeplot.
+Selection fiducial;
+// *********************************************************
+
+
+// ********************* OUTPUT FORMATS ********************
+// Binary columnar event store (./data/*.evt) is read by deeplot,
+// ascii export (./data/*.csv) is kept for deepnet.py and inspection
+const bool WRITE_EVT = true;
+const bool WRITE_CSV = true;
 // *********************************************************
 
 
-// Main function
-int printascii(void){
+// ********************** INPUT READING ********************
+// Only the branches of the event store are read, basket at a time
+// (ROOT bulk API) when true, event by event (TTree::GetEntry) if false
+const bool BULK_READ = true;
+
+// Events per block
+const size_t BLOCKSIZE = 4096;
+// *********************************************************
+
+
+// Stage timing, summary at exit (and a JSON report if a file is given)
+ProfileStage stageread("read tree");
+ProfileStage stageselect("select");
+ProfileStage stageevt("write evt");
+ProfileStage stagecsv("write csv");
+ProfileStage stagemerge("concatenate");
+
+
+// Main function: njobs files converted concurrently, each with nworkers
+// workers over disjoint entry ranges, optional JSON profile report
+int printascii(int njobs = 1, int nworkers = 1, const char* profilefile = "") {
+
+  const long t0 = ProfileNow();
 
   std::vector<TString> filenames;
 
@@ -43,142 +92,310 @@ int printascii(void){
   filenames.push_back("tree2track_kKpkmExp");
   filenames.push_back("tree2track_kKpkmOrexp");
   filenames.push_back("tree2track_kKpkmPower");
-  
+
+  // Fiducial cuts
+  if (!fiducial.LoadDefault()) {
+    return EXIT_FAILURE;
+  }
+  fiducial.Print();
+
+  njobs    = std::max(1, std::min<int>(njobs, filenames.size()));
+  nworkers = std::max(1, nworkers);
+  if (njobs > 1 || nworkers > 1) {
+    ROOT::EnableThreadSafety();
+  }
+
   // Process data
-  for (uint i = 0; i < filenames.size(); ++i) {
-    ProcessData(filenames.at(i));
+  std::atomic<size_t> next(0);
+  auto job = [&]() {
+    size_t i;
+    while ((i = next++) < filenames.size()) {
+      if (!ProcessData(filenames.at(i), nworkers)) {
+        printf("Conversion failed for: %s \n", filenames.at(i).Data());
+      }
+    }
+  };
+  std::vector<std::thread> jobs;
+  for (int i = 0; i < njobs; ++i) {
+    jobs.push_back(std::thread(job));
+  }
+  for (int i = 0; i < njobs; ++i) {
+    jobs[i].join();
   }
-  
+
+  PrintProfile("printascii", ProfileNow() - t0);
+  if (profilefile != NULL && profilefile[0] != '\0') {
+    WriteProfileJSON(profilefile, "printascii", ProfileNow() - t0);
+  }
+
   return EXIT_SUCCESS;
 }
 
 
 // Processor
-bool ProcessData(const TString& filename) {
+bool ProcessData(const TString& filename, int nworkers) {
 
   printf("Processing file: %s \n", filename.Data());
 
-  TFile* f = new TFile("./rootdata/" + filename + ".root");
-
-  // Tree definition
+  // Number of entries
+  TFile* f = TFile::Open("./rootdata/" + filename + ".root");
+  if (f == NULL || f->IsZombie()) {
+    printf("Error opening input file: ./rootdata/%s.root \n", filename.Data());
+    delete f;
+    return false;
+  }
   TTree* tree2track = (TTree*) f->Get("tree2track");
-
-  Int_t run    = 0;
-  Float_t zVtx = 0;
-  Float_t px1 = 0;
-  Float_t py1 = 0;
-  Float_t pz1 = 0;
-  Float_t px2 = 0;
-  Float_t py2 = 0;
-  Float_t pz2 = 0;
-  Float_t sigmaPiTPC1 = 0;
-  Float_t sigmaKaTPC1 = 0;
-  Float_t sigmaPrTPC1 = 0;
-  Float_t sigmaPiTPC2 = 0;
-  Float_t sigmaKaTPC2 = 0;
-  Float_t sigmaPrTPC2 = 0;
-  Float_t sigmaPiTOF1 = 0;
-  Float_t sigmaKaTOF1 = 0;
-  Float_t sigmaPrTOF1 = 0;
-  Float_t sigmaPiTOF2 = 0;
-  Float_t sigmaKaTOF2 = 0;
-  Float_t sigmaPrTOF2 = 0;
-  Float_t pxMc1 = 0;
-  Float_t pyMc1 = 0;
-  Float_t pzMc1 = 0;
-  Float_t pxMc2 = 0;
-  Float_t pyMc2 = 0;
-  Float_t pzMc2 = 0;
-  Int_t pidCode1 = 0;
-  Int_t pidCode2 = 0;
-
-  // Connect tree branches
-  tree2track->SetBranchAddress("run", &run);
-  tree2track->SetBranchAddress("pxMc1", &pxMc1);
-  tree2track->SetBranchAddress("pyMc1", &pyMc1);
-  tree2track->SetBranchAddress("pzMc1", &pzMc1);
-  tree2track->SetBranchAddress("pxMc2", &pxMc2);
-  tree2track->SetBranchAddress("pyMc2", &pyMc2);
-  tree2track->SetBranchAddress("pzMc2", &pzMc2);
-  tree2track->SetBranchAddress("pidCode1", &pidCode1);
-  tree2track->SetBranchAddress("pidCode2", &pidCode2);
-  tree2track->SetBranchAddress("zVtx", &zVtx);
-  tree2track->SetBranchAddress("px1", &px1);
-  tree2track->SetBranchAddress("py1", &py1);
-  tree2track->SetBranchAddress("pz1", &pz1);
-  tree2track->SetBranchAddress("px2", &px2);
-  tree2track->SetBranchAddress("py2", &py2);
-  tree2track->SetBranchAddress("pz2", &pz2);
-  tree2track->SetBranchAddress("sigmaPiTPC1", &sigmaPiTPC1);
-  tree2track->SetBranchAddress("sigmaKaTPC1", &sigmaKaTPC1);
-  tree2track->SetBranchAddress("sigmaPrTPC1", &sigmaPrTPC1);
-  tree2track->SetBranchAddress("sigmaPiTPC2", &sigmaPiTPC2);
-  tree2track->SetBranchAddress("sigmaKaTPC2", &sigmaKaTPC2);
-  tree2track->SetBranchAddress("sigmaPrTPC2", &sigmaPrTPC2);
-  tree2track->SetBranchAddress("sigmaPiTOF1", &sigmaPiTOF1);
-  tree2track->SetBranchAddress("sigmaKaTOF1", &sigmaKaTOF1);
-  tree2track->SetBranchAddress("sigmaPrTOF1", &sigmaPrTOF1);
-  tree2track->SetBranchAddress("sigmaPiTOF2", &sigmaPiTOF2);
-  tree2track->SetBranchAddress("sigmaKaTOF2", &sigmaKaTOF2);
-  tree2track->SetBranchAddress("sigmaPrTOF2", &sigmaPrTOF2);
-
-  // Output file
-  TString outputfile;
-  outputfile = "./data/" + filename +  ".csv";
-  FILE* asciif = fopen(outputfile.Data(), "w");
-  if (asciif == NULL) {
-    printf("Error opening output file!\n");
+  if (tree2track == NULL) {
+    printf("No tree2track in: ./rootdata/%s.root \n", filename.Data());
+    delete f;
     return false;
   }
-  
-  // Loop over events
-  for (uint k = 0; k < tree2track->GetEntries(); ++k) {
+  const Long64_t N = tree2track->GetEntries();
+  delete f;
 
-    tree2track->GetEntry(k);
+  // Output files
+  const TString evtfile = WRITE_EVT ? "./data/" + filename + ".evt" : "";
+  const TString csvfile = WRITE_CSV ? "./data/" + filename + ".csv" : "";
 
-    //printf("Event %d / %u \n", k, tree2track->GetEntries() );
+  ULong64_t naccepted = 0;
+  TreeReadStats stats;
 
-    TLorentzVector p1_gen;
-    TLorentzVector p2_gen;
+  if (nworkers <= 1 || N < nworkers) {
 
-    TLorentzVector p1_rec;
-    TLorentzVector p2_rec;
+    // Serial mode
+    if (!ConvertRange(filename, 0, N, evtfile, csvfile, naccepted, stats)) {
+      return false;
+    }
+
+  } else {
+
+    // Each worker converts its own entry range to its own shard
+    std::vector<std::string> evtshards;
+    std::vector<std::string> csvshards;
+    std::vector<ULong64_t> shardaccepted(nworkers, 0);
+    std::vector<char> shardok(nworkers, 0);
+    std::vector<TreeReadStats> shardstats(nworkers);
+    std::vector<std::thread> workers;
 
-    // Generated (only MC)
-    p1_gen.SetXYZM(pxMc1,pyMc1,pzMc1,M);
-    p2_gen.SetXYZM(pxMc2,pyMc2,pzMc2,M);
+    for (int w = 0; w < nworkers; ++w) {
+      const Long64_t first = N * w / nworkers;
+      const Long64_t last  = N * (w + 1) / nworkers;
+      const TString shard  = TString::Format(".shard%d", w);
 
-    // Reconstructed
-    p1_rec.SetXYZM(px1,py1,pz1,M);
-    p2_rec.SetXYZM(px2,py2,pz2,M);
+      evtshards.push_back((evtfile + shard).Data());
+      csvshards.push_back((csvfile + shard).Data());
+
+      const TString evtshard = WRITE_EVT ? evtfile + shard : "";
+      const TString csvshard = WRITE_CSV ? csvfile + shard : "";
+      workers.push_back(std::thread([=, &shardaccepted, &shardok, &shardstats]() {
+        shardok[w] = ConvertRange(filename, first, last, evtshard, csvshard, shardaccepted[w], shardstats[w]);
+      }));
+    }
+    bool ok = true;
+    for (int w = 0; w < nworkers; ++w) {
+      workers[w].join();
+      ok = ok && shardok[w];
+      naccepted += shardaccepted[w];
+      stats.Add(shardstats[w]);
+    }
+
+    // Concatenate shards in entry order
+    {
+      ScopedTimer timer(stagemerge);
+      if (ok && WRITE_EVT) {
+        ok = EvtConcatenate(evtshards, evtfile.Data());
+        timer.Add(0, FileBytes(evtfile.Data()));
+      }
+      if (ok && WRITE_CSV) {
+        ok = ConcatenateFiles(csvshards, csvfile.Data());
+        timer.Add(0, FileBytes(csvfile.Data()));
+      }
+    }
+    for (int w = 0; w < nworkers; ++w) {
+      if (WRITE_EVT) { std::remove(evtshards[w].c_str()); }
+      if (WRITE_CSV) { std::remove(csvshards[w].c_str()); }
+    }
+    if (!ok) {
+      printf("Error merging output shards of: %s \n", filename.Data());
+      return false;
+    }
+  }
+
+  printf("%s:: Entries = %lld, within fiducial = %llu (%d workers) \n",
+         filename.Data(), N, naccepted, nworkers);
+  stats.Print(filename.Data());
+
+  return true;
+}
+
+
+// Convert entries [first, last) of ./rootdata/<filename>.root,
+// empty output filename means no output of that type
+bool ConvertRange(const TString& filename, Long64_t first, Long64_t last,
+                  const TString& evtfile, const TString& csvfile, ULong64_t& naccepted,
+                  TreeReadStats& stats) {
+
+  // Own file and reader per worker, only the output branches are read
+  TreeInput input;
+  if (!input.Open(("./rootdata/" + filename + ".root").Data(), first, last, BULK_READ)) {
+    return false;
+  }
+
+  // Output files
+  FILE* asciif = NULL;
+  if (csvfile.Length() > 0) {
+    asciif = fopen(csvfile.Data(), "w");
+    if (asciif == NULL) {
+      printf("Error opening output file!\n");
+      return false;
+    }
+  }
+  EventStoreWriter evtwriter;
+  if (evtfile.Length() > 0) {
+    if (!evtwriter.Open(evtfile.Data())) {
+      printf("Error opening output file!\n");
+      if (asciif != NULL) { fclose(asciif); }
+      return false;
+    }
+  }
+
+  // Loop over events
+  EventBlock block;
+  EventRecord ev;
+  std::vector<unsigned char> mask;
+  while (true) {
+    {
+      ScopedTimer timer(stageread);
+      timer.Add(input.ReadBlock(block, BLOCKSIZE));
+    }
+    if (block.n == 0) {
+      break;
+    }
 
     // -------------------------------------------------------------
     // *********** FIDUCIAL PHASE-SPACE DEFINITION CUTS ************
-    if (p1_gen.Perp() > FID_PT && p2_gen.Perp() > FID_PT &&
-        std::abs(p1_gen.Eta()) < FID_ETA && std::abs(p2_gen.Eta()) < FID_ETA ) {
-      // Event within fiducial
-    } else {
-      continue; // Do not accept
+    // Generated (only MC) tracks
+    size_t m = 0;
+    {
+      ScopedTimer timer(stageselect);
+      mask.resize(block.n);
+      m = fiducial.Select(block, mask.data(), PX1_GEN);
+      timer.Add(block.n);
     }
+    naccepted += m;
     // -------------------------------------------------------------
 
-    // Did we reconstruct both?
-    int reco = 0;
-    if (p1_rec.Px() > -999 && p2_rec.Px() > - 999) {
-       reco = 1;
+    // Accepted events, did we reconstruct both? (ev.reco, set by the reader)
+    if (evtfile.Length() > 0) {
+      ScopedTimer timer(stageevt);
+      for (size_t i = 0; i < block.n; ++i) {
+        if (mask[i]) {
+          block.Get(i, ev);
+          evtwriter.Write(ev);
+        }
+      }
+      timer.Add(m);
     }
 
-    fprintf(asciif, "%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%d,%d,%d\n",
-      p1_gen.Px(),p1_gen.Py(),p1_gen.Pz(),
-      p2_gen.Px(),p2_gen.Py(),p2_gen.Pz(),
-      p1_rec.Px(),p1_rec.Py(),p1_rec.Pz(),
-      p2_rec.Px(),p2_rec.Py(),p2_rec.Pz(),
-      pidCode1, pidCode2,
-      reco);
+    if (asciif != NULL) {
+      ScopedTimer timer(stagecsv);
+      long bytes = 0;
+      for (size_t i = 0; i < block.n; ++i) {
+        if (!mask[i]) {
+          continue; // Do not accept
+        }
+        block.Get(i, ev);
+        bytes += fprintf(asciif, "%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%0.6f,%d,%d,%d\n",
+          ev.mom[PX1_GEN],ev.mom[PY1_GEN],ev.mom[PZ1_GEN],
+          ev.mom[PX2_GEN],ev.mom[PY2_GEN],ev.mom[PZ2_GEN],
+          ev.mom[PX1_REC],ev.mom[PY1_REC],ev.mom[PZ1_REC],
+          ev.mom[PX2_REC],ev.mom[PY2_REC],ev.mom[PZ2_REC],
+          ev.pidCode[0], ev.pidCode[1],
+          ev.reco);
+      }
+      timer.Add(m, bytes);
+    }
   }
 
-  fclose(asciif);
-  delete f;
+  bool ok = !input.Error();
+  input.Close();
+  stats = input.GetStats();
+  stageread.Count(0, stats.bytesread);
 
-  return true;
+  if (evtfile.Length() > 0) {
+    ScopedTimer timer(stageevt);
+    ok = evtwriter.Close() && ok;
+    timer.Add(0, FileBytes(evtfile.Data()));
+  }
+  if (asciif != NULL) {
+    ScopedTimer timer(stagecsv);
+    ok = (fclose(asciif) == 0) && ok;
+  }
+
+  return ok;
+}
+
+
+// Append files in order into output
+bool ConcatenateFiles(const std::vector<std::string>& inputs, const std::string& output) {
+
+  FILE* out = fopen(output.c_str(), "wb");
+  if (out == NULL) {
+    printf("Error opening output file: %s \n", output.c_str());
+    return false;
+  }
+  std::vector<char> buffer(1 << 22);
+  bool ok = true;
+  for (size_t i = 0; i < inputs.size() && ok; ++i) {
+    FILE* fp = fopen(inputs[i].c_str(), "rb");
+    if (fp == NULL) {
+      printf("Error opening input file: %s \n", inputs[i].c_str());
+      ok = false;
+      break;
+    }
+    size_t nb;
+    while ((nb = fread(buffer.data(), 1, buffer.size(), fp)) > 0) {
+      if (fwrite(buffer.data(), 1, nb, out) != nb) {
+        ok = false;
+        break;
+      }
+    }
+    fclose(fp);
+  }
+  ok = (fclose(out) == 0) && ok;
+
+  return ok;
+}
+
+
+// File size in bytes (0 if not available)
+long FileBytes(const std::string& filename) {
+  std::error_code ec;
+  const uintmax_t bytes = std::filesystem::file_size(filename, ec);
+  return ec ? 0 : bytes;
+}
+
+
+#ifdef PRINTASCII_MAIN
+// Standalone build (see makefile)
+int main(int argc, char* argv[]) {
+
+  int njobs    = 1;
+  int nworkers = 1;
+  std::string profilefile;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if ((arg == "-j" || arg == "--jobs") && i + 1 < argc) {
+      njobs = std::max(1, atoi(argv[++i]));
+    } else if ((arg == "-t" || arg == "--threads") && i + 1 < argc) {
+      nworkers = std::max(1, atoi(argv[++i]));
+    } else if (arg == "--profile" && i + 1 < argc) {
+      profilefile = argv[++i];
+    } else {
+      printf("Usage: ./printascii [-j|--jobs <files in parallel>] [-t|--threads <workers per file>] [--profile <file.json>] \n");
+      return EXIT_FAILURE;
+    }
+  }
+  return printascii(njobs, nworkers, profilefile.c_str());
 }
+#endif
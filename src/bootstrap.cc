@@ -0,0 +1,118 @@
+// Poisson bootstrap replicas of histograms, filled in the same event pass
+// ------------------------------------------------------------------------
+
+
+// C++
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+// Own
+#include "bootstrap.h"
+
+
+// Largest Poisson(1) weight drawn, P(k > 12) ~ 1e-10
+const int BOOT_KMAX = 12;
+
+// Thresholds of the Poisson(1) CDF in units of 2^-32, T[k] = CDF(k)
+static std::array<uint32_t, BOOT_KMAX> PoissonTable() {
+    std::array<uint32_t, BOOT_KMAX> T;
+    double p   = std::exp(-1.0);
+    double cdf = 0.0;
+    for (int k = 0; k < BOOT_KMAX; ++k) {
+        cdf += p;
+        p   /= (k + 1);
+        T[k] = (uint32_t)std::min(std::ceil(cdf * 4294967296.0), 4294967295.0);
+    }
+    return T;
+}
+
+// 64-bit finalizer (SplitMix64)
+static inline uint64_t Mix64(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// 32-bit finalizer (MurmurHash3), vectorizes with 32-bit multiplies
+static inline uint32_t Mix32(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85EBCA6BU;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35U;
+    h ^= h >> 16;
+    return h;
+}
+
+void PoissonWeights(size_t n, const uint64_t* index, int R, uint64_t seed, double* w) {
+
+    static const std::array<uint32_t, BOOT_KMAX> T = PoissonTable();
+    const int stride = BootstrapStride(R);
+
+    for (size_t i = 0; i < n; ++i) {
+
+        // Key of the event, then one bijective 32-bit draw per replica
+        const uint64_t key = Mix64(seed ^ Mix64(index[i]));
+        const uint32_t k0  = (uint32_t)key;
+        const uint32_t k1  = (uint32_t)(key >> 32);
+        double* wi = w + i * stride;
+
+        for (int r = 0; r < R; ++r) {
+            const uint32_t u = Mix32(k0 ^ Mix32(k1 + (uint32_t)r));
+
+            // Inversion by counting the CDF thresholds below u (branch-free)
+            int k = 0;
+            for (int j = 0; j < BOOT_KMAX; ++j) {
+                k += (u >= T[j]);
+            }
+            wi[r] = k;
+        }
+        for (int r = R; r < stride; ++r) {
+            wi[r] = 0.0;
+        }
+    }
+}
+
+void BootstrapHist::Init(int ncells, int R, uint64_t seed) {
+    ncells_ = ncells;
+    R_      = R;
+    stride_ = BootstrapStride(R);
+    seed_   = seed;
+    sumw_.assign((size_t)ncells * stride_, 0.0);
+}
+
+void BootstrapHist::Reset() {
+    std::fill(sumw_.begin(), sumw_.end(), 0.0);
+}
+
+bool BootstrapHist::Add(const BootstrapHist& other) {
+    if (other.ncells_ != ncells_ || other.R_ != R_ || other.seed_ != seed_) {
+        return false;
+    }
+    for (size_t i = 0; i < sumw_.size(); ++i) {
+        sumw_[i] += other.sumw_[i];
+    }
+    return true;
+}
+
+void BootstrapHist::GetError(std::vector<double>& err) const {
+
+    err.assign(ncells_, 0.0);
+    if (R_ < 2) {
+        return;
+    }
+    for (int c = 0; c < ncells_; ++c) {
+        const double* s = sumw_.data() + (size_t)c * stride_;
+        double mean = 0.0;
+        for (int r = 0; r < R_; ++r) {
+            mean += s[r];
+        }
+        mean /= R_;
+        double var = 0.0;
+        for (int r = 0; r < R_; ++r) {
+            var += (s[r] - mean) * (s[r] - mean);
+        }
+        err[c] = std::sqrt(var / (R_ - 1));
+    }
+}
@@ -0,0 +1,61 @@
+// Content hash of byte ranges and files
+// ------------------------------------------------------------------------
+
+
+// C++
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+// Own
+#include "contenthash.h"
+#include "mmapfile.h"
+
+
+static inline uint64_t Rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// Final avalanche (MurmurHash3 fmix64)
+static inline uint64_t Mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+uint64_t HashBytes(const char* data, size_t size, uint64_t seed) {
+
+    const uint64_t P1 = 0x9e3779b185ebca87ULL;
+    const uint64_t P2 = 0xc2b2ae3d27d4eb4fULL;
+
+    // Independent lanes keep the multiplier pipelines busy
+    uint64_t lane[4] = {seed + P1, seed + P2, seed, seed - P1};
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        for (int l = 0; l < 4; ++l) {
+            uint64_t x;
+            std::memcpy(&x, data + i + 8 * l, sizeof(x));
+            lane[l] = Rotl(lane[l] + x * P2, 31) * P1;
+        }
+    }
+    uint64_t h = Rotl(lane[0], 1) + Rotl(lane[1], 7) + Rotl(lane[2], 12) + Rotl(lane[3], 18);
+    for (; i < size; ++i) {
+        h = (h ^ (unsigned char)data[i]) * P1;
+    }
+    return Mix(h ^ size);
+}
+
+uint64_t HashFile(const std::string& filename) {
+
+    MappedFile file;
+    if (!file.Open(filename)) {
+        printf("HashFile:: Cannot open file: %s \n", filename.c_str());
+        return 0;
+    }
+    const uint64_t hash = HashBytes(file.Data(), file.Size());
+
+    return (hash != 0) ? hash : 1;
+}
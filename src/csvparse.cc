@@ -0,0 +1,186 @@
+// Fast ascii kinematics parser
+// ------------------------------------------------------------------------
+
+
+// C++
+#include <cstdint>
+#include <cstdlib>
+
+// SIMD
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Own
+#include "csvparse.h"
+
+
+// Number of fields per line
+const int NFIELDS = NKIN + 3;
+
+// Exact powers of ten (10^22 is the largest exactly representable)
+static const double POW10[16] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+    1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15
+};
+
+
+int ScanDelimiters(const char* s, const char* bufend, const char** delim, int maxn) {
+
+    int n = 0;
+    const char* p = s;
+
+#if defined(__AVX2__)
+    const __m256i comma32 = _mm256_set1_epi8(',');
+    const __m256i nl32    = _mm256_set1_epi8('\n');
+    while (p + 32 <= bufend) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, comma32), _mm256_cmpeq_epi8(v, nl32)));
+        while (mask != 0) {
+            const char* d = p + __builtin_ctz(mask);
+            delim[n++] = d;
+            if (*d == '\n' || n == maxn) { return n; }
+            mask &= mask - 1;
+        }
+        p += 32;
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i comma16 = _mm_set1_epi8(',');
+    const __m128i nl16    = _mm_set1_epi8('\n');
+    while (p + 16 <= bufend) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(v, comma16), _mm_cmpeq_epi8(v, nl16)));
+        while (mask != 0) {
+            const char* d = p + __builtin_ctz(mask);
+            delim[n++] = d;
+            if (*d == '\n' || n == maxn) { return n; }
+            mask &= mask - 1;
+        }
+        p += 16;
+    }
+#endif
+    // Scalar tail (or no SIMD available)
+    for (; p < bufend; ++p) {
+        if (*p == ',' || *p == '\n') {
+            delim[n++] = p;
+            if (*p == '\n' || n == maxn) { return n; }
+        }
+    }
+    return n;
+}
+
+bool ParseFixedDouble(const char* s, const char* end, double& value) {
+
+    bool negative = false;
+    if (s < end && *s == '-') {
+        negative = true;
+        ++s;
+    }
+
+    // Mantissa as an integer, m < 10^15 < 2^53 is exact
+    uint64_t m = 0;
+    int ndigits = 0;
+    int nfrac   = 0;
+    bool dot    = false;
+    for (; s < end; ++s) {
+        const unsigned d = (unsigned char)(*s) - '0';
+        if (d < 10) {
+            m = m * 10 + d;
+            ++ndigits;
+            nfrac += dot;
+        } else if (*s == '.' && !dot) {
+            dot = true;
+        } else {
+            return false;
+        }
+    }
+    if (ndigits == 0 || ndigits > 15) {
+        return false;
+    }
+
+    // Both operands are exact, so the IEEE division is correctly rounded,
+    // the same result as strtod gives
+    const double x = (double)m / POW10[nfrac];
+    value = negative ? -x : x;
+
+    return true;
+}
+
+bool ParseFixedInt(const char* s, const char* end, int& value) {
+
+    bool negative = false;
+    if (s < end && *s == '-') {
+        negative = true;
+        ++s;
+    }
+    if (s == end || end - s > 9) {
+        return false;
+    }
+    int x = 0;
+    for (; s < end; ++s) {
+        const unsigned d = (unsigned char)(*s) - '0';
+        if (d >= 10) {
+            return false;
+        }
+        x = x * 10 + d;
+    }
+    value = negative ? -x : x;
+
+    return true;
+}
+
+bool ParseCSVLineSlow(const char* s, const char* lineend, EventRecord& ev) {
+
+    char* e = nullptr;
+    for (int j = 0; j < NKIN; ++j) {
+        ev.mom[j] = strtod(s, &e);
+        if (e == s || e >= lineend || *e != ',') {
+            return false;
+        }
+        s = e + 1;
+    }
+    int* ints[3] = {&ev.pidCode[0], &ev.pidCode[1], &ev.reco};
+    for (int j = 0; j < 3; ++j) {
+        *ints[j] = (int)strtol(s, &e, 10);
+        if (e == s || e > lineend || (j < 2 && *e != ',')) {
+            return false;
+        }
+        s = e + 1;
+    }
+    return true;
+}
+
+const char* ParseCSVLineFast(const char* s, const char* bufend, EventRecord& ev) {
+
+    // Delimiters, the last one must be the newline terminating this line
+    const char* delim[NFIELDS];
+    if (ScanDelimiters(s, bufend, delim, NFIELDS) != NFIELDS || *delim[NFIELDS - 1] != '\n') {
+        return nullptr;
+    }
+
+    const char* a = s;
+    for (int j = 0; j < NKIN; ++j) {
+        if (!ParseFixedDouble(a, delim[j], ev.mom[j])) {
+            return nullptr;
+        }
+        a = delim[j] + 1;
+    }
+    if (!ParseFixedInt(a, delim[NKIN], ev.pidCode[0]) ||
+        !ParseFixedInt(delim[NKIN] + 1, delim[NKIN + 1], ev.pidCode[1]) ||
+        !ParseFixedInt(delim[NKIN + 1] + 1, delim[NKIN + 2], ev.reco)) {
+        return nullptr;
+    }
+    return delim[NFIELDS - 1];
+}
+
+bool ParseCSVLine(const char* s, const char* lineend, const char* bufend, EventRecord& ev) {
+
+    if (ParseCSVLineFast(s, bufend, ev) == lineend) {
+        return true;
+    }
+    // Unusual input, use the slow path
+    return ParseCSVLineSlow(s, lineend, ev);
+}
@@ -0,0 +1,444 @@
+// Memory mapped kinematics and DeepEfficiency weight input
+// ------------------------------------------------------------------------
+
+
+// C++
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Own
+#include "eventinput.h"
+#include "csvparse.h"
+
+
+namespace {
+
+// Whitespace-only line (e.g. trailing newline at the end of file)
+bool IsBlank(const char* s, const char* end) {
+    for (; s < end; ++s) {
+        if (!std::isspace((unsigned char)*s)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+
+// ------------------------------------------------------------------------
+// Kinematics
+
+bool KinematicsInput::Open(const std::string& name, const std::string& datapath) {
+
+    const std::string evtfile = datapath + name + ".evt";
+    if (FileExists(evtfile)) {
+        return OpenFile(evtfile);
+    }
+    return OpenFile(datapath + name + ".csv");
+}
+
+bool KinematicsInput::OpenFile(const std::string& filename) {
+
+    Close();
+
+    binary_ = filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".evt") == 0;
+    error_  = false;
+    nread_  = 0;
+    pos_    = 0;
+    chunk_  = 0;
+    chunkpos_   = 0;
+    buffer_.n   = 0;
+    buffer_pos_ = 0;
+
+    if (!file_.Open(filename)) {
+        printf("KinematicsInput:: Cannot open file: %s \n", filename.c_str());
+        return false;
+    }
+    if (!binary_) {
+        return true;
+    }
+
+    // Event store header and schema
+    const char* data = file_.Data();
+    const size_t size = file_.Size();
+    if (size < sizeof(EvtFileHeader)) {
+        printf("KinematicsInput:: Truncated event store: %s \n", filename.c_str());
+        Close();
+        return false;
+    }
+    std::memcpy(&header_, data, sizeof(EvtFileHeader));
+    columns_.clear();
+    if (header_.ncolumns < 1024 &&
+        sizeof(EvtFileHeader) + header_.ncolumns * sizeof(EvtColumnDesc) <= size) {
+        columns_.resize(header_.ncolumns);
+        std::memcpy(columns_.data(), data + sizeof(EvtFileHeader),
+                    header_.ncolumns * sizeof(EvtColumnDesc));
+    }
+    if (!EvtCheckSchema(header_, columns_)) {
+        printf("KinematicsInput:: Incompatible event store: %s \n", filename.c_str());
+        Close();
+        return false;
+    }
+
+    // Chunk index (walks only the chunk headers), the columns of each chunk
+    // must fill exactly its byte count so that the views stay inside the mapping
+    chunkoffset_.clear();
+    chunkfirst_.clear();
+    uint64_t offset = header_.dataoffset;
+    uint64_t first  = 0;
+    if (offset < sizeof(EvtFileHeader) + header_.ncolumns * sizeof(EvtColumnDesc)) {
+        offset = size;
+    }
+    for (uint64_t i = 0; i < header_.nchunks; ++i) {
+        EvtChunkHeader chead;
+        if (offset > size || size - offset < sizeof(EvtChunkHeader)) {
+            break;
+        }
+        std::memcpy(&chead, data + offset, sizeof(EvtChunkHeader));
+        if (chead.magic != EVT_CHUNKMAGIC || chead.nevents > header_.chunksize ||
+            chead.nbytes != EvtChunkBytes(columns_, chead.nevents) || chead.nbytes > size - offset) {
+            break;
+        }
+        chunkoffset_.push_back(offset);
+        chunkfirst_.push_back(first);
+        offset += chead.nbytes;
+        first  += chead.nevents;
+    }
+    if (chunkoffset_.size() != header_.nchunks || first != header_.nevents) {
+        printf("KinematicsInput:: Corrupted event store (chunks %lu / %lu): %s \n",
+               (unsigned long)chunkoffset_.size(), (unsigned long)header_.nchunks, filename.c_str());
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void KinematicsInput::Close() {
+    file_.Close();
+    chunkoffset_.clear();
+    chunkfirst_.clear();
+}
+
+bool KinematicsInput::GetChunkView(uint64_t i, EvtChunkView& view) const {
+
+    if (!binary_ || i >= chunkoffset_.size()) {
+        return false;
+    }
+    const char* p = file_.Data() + chunkoffset_[i];
+    EvtChunkHeader chead;
+    std::memcpy(&chead, p, sizeof(EvtChunkHeader));
+
+    view.n     = chead.nevents;
+    view.first = chunkfirst_[i];
+    p += sizeof(EvtChunkHeader);
+    for (int j = 0; j < N_EVTCOLUMNS; ++j) {
+        view.column[j] = p;
+        view.type[j]   = columns_[j].type;
+        p += EvtAlign(view.n * EvtTypeSize(view.type[j]));
+    }
+    return true;
+}
+
+size_t KinematicsInput::ReadBlock(EventBlock& block, size_t maxn) {
+
+    if (!file_.IsOpen()) {
+        block.n = 0;
+        return 0;
+    }
+    return binary_ ? ReadBlockEVT(block, maxn) : ReadBlockCSV(block, maxn);
+}
+
+size_t KinematicsInput::ReadBlockEVT(EventBlock& block, size_t maxn) {
+
+    block.Resize(maxn);
+    block.first = nread_;
+
+    size_t n = 0;
+    EvtChunkView view;
+    while (n < maxn && GetChunkView(chunk_, view)) {
+
+        const size_t take = std::min<uint64_t>(maxn - n, view.n - chunkpos_);
+
+        for (int j = 0; j < N_EVTCOLUMNS; ++j) {
+            const char* src = view.column[j] + chunkpos_ * EvtTypeSize(view.type[j]);
+            if (j < NKIN) {
+                EvtDecodeColumn(src, view.type[j], take, block.mom[j].data() + n);
+            } else if (j == RECO) {
+                EvtDecodeColumn(src, view.type[j], take, block.reco.data() + n);
+            } else {
+                EvtDecodeColumn(src, view.type[j], take, block.pidCode[j - PIDCODE1].data() + n);
+            }
+        }
+        n         += take;
+        chunkpos_ += take;
+        if (chunkpos_ == view.n) {
+            ++chunk_;
+            chunkpos_ = 0;
+            file_.Consumed(chunk_ < chunkoffset_.size() ? chunkoffset_[chunk_] : file_.Size());
+        }
+    }
+    block.n = n;
+    nread_ += n;
+
+    return n;
+}
+
+size_t KinematicsInput::ReadBlockCSV(EventBlock& block, size_t maxn) {
+
+    block.Resize(maxn);
+    block.first = nread_;
+
+    const char* data = file_.Data();
+    const size_t size = file_.Size();
+
+    size_t n = 0;
+    EventRecord ev;
+    while (n < maxn && pos_ < size && !error_) {
+
+        const char* s = data + pos_;
+
+        // Fast path finds the line end itself
+        if (fastparse_) {
+            const char* nl = ParseCSVLineFast(s, data + size, ev);
+            if (nl != nullptr) {
+                pos_ = (nl - data) + 1;
+                block.Set(n, ev);
+                ++n;
+                continue;
+            }
+        }
+
+        const char* nl  = static_cast<const char*>(std::memchr(s, '\n', size - pos_));
+        const char* end = (nl != nullptr) ? nl : data + size;
+
+        bool ok = false;
+        if (nl != nullptr) {
+            ok = ParseCSVLineSlow(s, end, ev);
+        } else {
+            // Last line without newline, parse from a terminated copy
+            std::string line(s, end);
+            ok = ParseCSVLineSlow(line.c_str(), line.c_str() + line.size(), ev);
+        }
+        pos_ = (end - data) + 1;
+
+        if (!ok) {
+            if (IsBlank(s, end)) {
+                continue;
+            }
+            printf("Kinematics inputfile:: Error in parsing (line %lu)! \n",
+                   (unsigned long)(nread_ + n + 1));
+            error_ = true;
+            break;
+        }
+        block.Set(n, ev);
+        ++n;
+    }
+    file_.Consumed(pos_);
+
+    block.n = n;
+    nread_ += n;
+
+    return n;
+}
+
+uint64_t KinematicsInput::Skip(uint64_t n) {
+
+    // Events already buffered for Next()
+    const uint64_t buffered = std::min<uint64_t>(n, buffer_.n - buffer_pos_);
+    buffer_pos_ += buffered;
+    n -= buffered;
+
+    if (!file_.IsOpen() || n == 0) {
+        return buffered;
+    }
+
+    if (binary_) {
+        if (chunkfirst_.empty()) {
+            return buffered;
+        }
+        const uint64_t target = std::min<uint64_t>(nread_ + n, header_.nevents);
+        const uint64_t skipped = target - nread_;
+
+        // Chunk containing the target event
+        chunk_ = std::upper_bound(chunkfirst_.begin(), chunkfirst_.end(), target) - chunkfirst_.begin() - 1;
+        chunkpos_ = target - chunkfirst_[chunk_];
+        nread_ = target;
+        file_.Consumed(chunkoffset_[chunk_]);
+
+        return buffered + skipped;
+    }
+
+    // Ascii: skip n non-blank lines
+    const char* data = file_.Data();
+    const size_t size = file_.Size();
+    uint64_t skipped = 0;
+    while (skipped < n && pos_ < size) {
+        const char* s   = data + pos_;
+        const char* nl  = static_cast<const char*>(std::memchr(s, '\n', size - pos_));
+        const char* end = (nl != nullptr) ? nl : data + size;
+        if (!IsBlank(s, end)) {
+            ++skipped;
+        }
+        pos_ = (end - data) + 1;
+    }
+    file_.Consumed(pos_);
+    nread_ += skipped;
+
+    return buffered + skipped;
+}
+
+uint64_t KinematicsInput::CountEntries() const {
+
+    if (!file_.IsOpen()) {
+        return 0;
+    }
+    if (binary_) {
+        return header_.nevents;
+    }
+    const char* data = file_.Data();
+    const size_t size = file_.Size();
+    uint64_t n = 0;
+    size_t pos = 0;
+    while (pos < size) {
+        const char* s   = data + pos;
+        const char* nl  = static_cast<const char*>(std::memchr(s, '\n', size - pos));
+        const char* end = (nl != nullptr) ? nl : data + size;
+        if (!IsBlank(s, end)) {
+            ++n;
+        }
+        pos = (end - data) + 1;
+    }
+    return n;
+}
+
+bool KinematicsInput::Next(EventRecord& ev) {
+
+    if (buffer_pos_ >= buffer_.n) {
+        const size_t BLOCKSIZE = 4096;
+        if (ReadBlock(buffer_, BLOCKSIZE) == 0) {
+            return false;
+        }
+        buffer_pos_ = 0;
+    }
+    buffer_.Get(buffer_pos_, ev);
+    ++buffer_pos_;
+
+    return true;
+}
+
+
+// ------------------------------------------------------------------------
+// Weights
+
+bool WeightInput::Open(const std::string& filename) {
+
+    pos_   = 0;
+    nread_ = 0;
+    error_ = false;
+    return file_.Open(filename);
+}
+
+void WeightInput::Close() {
+    file_.Close();
+}
+
+size_t WeightInput::Read(double* dst, size_t maxn) {
+
+    const char* data = file_.Data();
+    const size_t size = file_.Size();
+
+    size_t n = 0;
+    while (n < maxn && !error_) {
+
+        // Skip whitespace
+        while (pos_ < size && std::isspace((unsigned char)data[pos_])) {
+            ++pos_;
+        }
+        if (pos_ >= size) {
+            break;
+        }
+
+        // Token end
+        size_t end = pos_;
+        while (end < size && !std::isspace((unsigned char)data[end])) {
+            ++end;
+        }
+
+        const char* s = data + pos_;
+        char* e = nullptr;
+        if (end < size) {
+            dst[n] = strtod(s, &e);
+            error_ = (e != data + end);
+        } else {
+            // Last token without terminator, parse from a terminated copy
+            std::string token(s, data + end);
+            dst[n] = strtod(token.c_str(), &e);
+            error_ = (e != token.c_str() + token.size());
+        }
+        if (error_) {
+            printf("WeightInput:: Error in parsing (line %lu)! \n", (unsigned long)(nread_ + n + 1));
+            break;
+        }
+        pos_ = end;
+        ++n;
+    }
+    file_.Consumed(pos_);
+    nread_ += n;
+
+    return n;
+}
+
+uint64_t WeightInput::CountEntries() const {
+
+    const char* data = file_.Data();
+    const size_t size = file_.Size();
+
+    uint64_t n = 0;
+    size_t pos = 0;
+    while (pos < size) {
+        while (pos < size && std::isspace((unsigned char)data[pos])) {
+            ++pos;
+        }
+        if (pos >= size) {
+            break;
+        }
+        while (pos < size && !std::isspace((unsigned char)data[pos])) {
+            ++pos;
+        }
+        ++n;
+    }
+    return n;
+}
+
+bool WeightInput::Next(double& weight) {
+    return Read(&weight, 1) == 1;
+}
+
+uint64_t WeightInput::Skip(uint64_t n) {
+
+    const char* data = file_.Data();
+    const size_t size = file_.Size();
+
+    uint64_t skipped = 0;
+    while (skipped < n) {
+        while (pos_ < size && std::isspace((unsigned char)data[pos_])) {
+            ++pos_;
+        }
+        if (pos_ >= size) {
+            break;
+        }
+        while (pos_ < size && !std::isspace((unsigned char)data[pos_])) {
+            ++pos_;
+        }
+        ++skipped;
+    }
+    file_.Consumed(pos_);
+    nread_ += skipped;
+
+    return skipped;
+}
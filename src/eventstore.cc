@@ -0,0 +1,405 @@
+// Binary columnar event store (.evt)
+// ------------------------------------------------------------------------
+
+
+// C++
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Own
+#include "eventstore.h"
+
+
+const char* EVT_COLUMNNAMES[N_EVTCOLUMNS] = {
+    "px1_gen", "py1_gen", "pz1_gen",
+    "px2_gen", "py2_gen", "pz2_gen",
+    "px1_rec", "py1_rec", "pz1_rec",
+    "px2_rec", "py2_rec", "pz2_rec",
+    "pidCode1", "pidCode2",
+    "reco"
+};
+
+
+uint32_t EvtTypeSize(uint32_t type) {
+    switch (type) {
+        case EVT_F32: return 4;
+        case EVT_F64: return 8;
+        case EVT_I16: return 2;
+        case EVT_I32: return 4;
+        case EVT_U8:  return 1;
+        default:      return 0;
+    }
+}
+
+uint64_t EvtChunkBytes(const std::vector<EvtColumnDesc>& columns, uint64_t nevents) {
+    uint64_t nbytes = sizeof(EvtChunkHeader);
+    for (size_t j = 0; j < columns.size(); ++j) {
+        nbytes += EvtAlign(nevents * EvtTypeSize(columns[j].type));
+    }
+    return nbytes;
+}
+
+void EventBlock::Resize(size_t size) {
+    for (int j = 0; j < NKIN; ++j) {
+        mom[j].resize(size);
+    }
+    pidCode[0].resize(size);
+    pidCode[1].resize(size);
+    reco.resize(size);
+}
+
+void EventBlock::Get(size_t i, EventRecord& ev) const {
+    for (int j = 0; j < NKIN; ++j) {
+        ev.mom[j] = mom[j][i];
+    }
+    ev.pidCode[0] = pidCode[0][i];
+    ev.pidCode[1] = pidCode[1][i];
+    ev.reco       = reco[i];
+}
+
+void EventBlock::Set(size_t i, const EventRecord& ev) {
+    for (int j = 0; j < NKIN; ++j) {
+        mom[j][i] = ev.mom[j];
+    }
+    pidCode[0][i] = ev.pidCode[0];
+    pidCode[1][i] = ev.pidCode[1];
+    reco[i]       = ev.reco;
+}
+
+// Column schema must contain our columns in the right order,
+// momenta can be either single or double precision
+bool EvtCheckSchema(const EvtFileHeader& header, const std::vector<EvtColumnDesc>& columns) {
+
+    if (std::memcmp(header.magic, EVT_MAGIC, sizeof(EVT_MAGIC)) != 0) {
+        printf("EventStore:: Not an event store file (bad magic) \n");
+        return false;
+    }
+    if (header.version == 0 || header.version > EVT_VERSION) {
+        printf("EventStore:: Unsupported format version %u (this build reads <= %u) \n",
+               header.version, EVT_VERSION);
+        return false;
+    }
+    if (header.ncolumns != N_EVTCOLUMNS || columns.size() != N_EVTCOLUMNS) {
+        printf("EventStore:: Unexpected number of columns %u \n", header.ncolumns);
+        return false;
+    }
+    for (int j = 0; j < N_EVTCOLUMNS; ++j) {
+        if (std::strncmp(columns[j].name, EVT_COLUMNNAMES[j], sizeof(columns[j].name)) != 0) {
+            printf("EventStore:: Column %d is '%.24s', expected '%s' \n",
+                   j, columns[j].name, EVT_COLUMNNAMES[j]);
+            return false;
+        }
+        if (EvtTypeSize(columns[j].type) == 0) {
+            printf("EventStore:: Column '%s' has unknown type %u \n",
+                   EVT_COLUMNNAMES[j], columns[j].type);
+            return false;
+        }
+    }
+    return true;
+}
+
+void EvtDecodeColumn(const char* src, uint32_t type, size_t n, double* dst) {
+    switch (type) {
+        case EVT_F32: {
+            const float* p = reinterpret_cast<const float*>(src);
+            for (size_t i = 0; i < n; ++i) { dst[i] = p[i]; }
+            break;
+        }
+        case EVT_F64:
+            std::memcpy(dst, src, n * sizeof(double));
+            break;
+        case EVT_I16: {
+            const int16_t* p = reinterpret_cast<const int16_t*>(src);
+            for (size_t i = 0; i < n; ++i) { dst[i] = p[i]; }
+            break;
+        }
+        case EVT_I32: {
+            const int32_t* p = reinterpret_cast<const int32_t*>(src);
+            for (size_t i = 0; i < n; ++i) { dst[i] = p[i]; }
+            break;
+        }
+        case EVT_U8: {
+            const uint8_t* p = reinterpret_cast<const uint8_t*>(src);
+            for (size_t i = 0; i < n; ++i) { dst[i] = p[i]; }
+            break;
+        }
+    }
+}
+
+void EvtDecodeColumn(const char* src, uint32_t type, size_t n, int* dst) {
+    switch (type) {
+        case EVT_F32: {
+            const float* p = reinterpret_cast<const float*>(src);
+            for (size_t i = 0; i < n; ++i) { dst[i] = (int)p[i]; }
+            break;
+        }
+        case EVT_F64: {
+            const double* p = reinterpret_cast<const double*>(src);
+            for (size_t i = 0; i < n; ++i) { dst[i] = (int)p[i]; }
+            break;
+        }
+        case EVT_I16: {
+            const int16_t* p = reinterpret_cast<const int16_t*>(src);
+            for (size_t i = 0; i < n; ++i) { dst[i] = p[i]; }
+            break;
+        }
+        case EVT_I32:
+            std::memcpy(dst, src, n * sizeof(int32_t));
+            break;
+        case EVT_U8: {
+            const uint8_t* p = reinterpret_cast<const uint8_t*>(src);
+            for (size_t i = 0; i < n; ++i) { dst[i] = p[i]; }
+            break;
+        }
+    }
+}
+
+
+// ------------------------------------------------------------------------
+// Writer
+
+bool EventStoreWriter::Open(const std::string& filename, bool doubleprec, uint32_t chunksize) {
+
+    Close();
+
+    if ((fp_ = fopen(filename.c_str(), "wb")) == NULL) {
+        printf("EventStoreWriter:: Cannot open output file: %s \n", filename.c_str());
+        return false;
+    }
+
+    // Schema
+    columns_.assign(N_EVTCOLUMNS, EvtColumnDesc());
+    for (int j = 0; j < N_EVTCOLUMNS; ++j) {
+        std::memset(&columns_[j], 0, sizeof(EvtColumnDesc));
+        std::strncpy(columns_[j].name, EVT_COLUMNNAMES[j], sizeof(columns_[j].name) - 1);
+
+        if (j < NKIN) {
+            columns_[j].type = doubleprec ? EVT_F64 : EVT_F32;
+        } else if (j == RECO) {
+            columns_[j].type = EVT_U8;
+        } else {
+            columns_[j].type = EVT_I16; // PDG codes of pi/K/p fit here
+        }
+    }
+
+    std::memset(&header_, 0, sizeof(EvtFileHeader));
+    std::memcpy(header_.magic, EVT_MAGIC, sizeof(EVT_MAGIC));
+    header_.version    = EVT_VERSION;
+    header_.ncolumns   = N_EVTCOLUMNS;
+    header_.chunksize  = chunksize > 0 ? chunksize : EVT_CHUNKSIZE;
+    header_.dataoffset = EvtAlign(sizeof(EvtFileHeader) + N_EVTCOLUMNS * sizeof(EvtColumnDesc));
+
+    // Write preliminary header, event and chunk counts are patched at close
+    std::vector<char> head(header_.dataoffset, 0);
+    std::memcpy(head.data(), &header_, sizeof(EvtFileHeader));
+    std::memcpy(head.data() + sizeof(EvtFileHeader), columns_.data(),
+                N_EVTCOLUMNS * sizeof(EvtColumnDesc));
+    if (fwrite(head.data(), 1, head.size(), fp_) != head.size()) {
+        printf("EventStoreWriter:: Error writing header: %s \n", filename.c_str());
+        fclose(fp_); fp_ = nullptr;
+        return false;
+    }
+
+    buffer_.Resize(header_.chunksize);
+    buffer_.n = 0;
+    nevents_  = 0;
+    nchunks_  = 0;
+
+    return true;
+}
+
+bool EventStoreWriter::Write(const EventRecord& ev) {
+
+    if (fp_ == nullptr) {
+        return false;
+    }
+    buffer_.Set(buffer_.n, ev);
+    ++buffer_.n;
+
+    if (buffer_.n == header_.chunksize) {
+        return FlushChunk();
+    }
+    return true;
+}
+
+bool EventStoreWriter::FlushChunk() {
+
+    const size_t n = buffer_.n;
+    if (n == 0) {
+        return true;
+    }
+
+    // Encode all columns into one contiguous chunk
+    const uint64_t nbytes = EvtChunkBytes(columns_, n);
+    std::vector<char> raw(nbytes, 0);
+
+    EvtChunkHeader chead;
+    std::memset(&chead, 0, sizeof(EvtChunkHeader));
+    chead.magic   = EVT_CHUNKMAGIC;
+    chead.nevents = n;
+    chead.nbytes  = nbytes;
+    std::memcpy(raw.data(), &chead, sizeof(EvtChunkHeader));
+
+    char* dst = raw.data() + sizeof(EvtChunkHeader);
+    for (int j = 0; j < N_EVTCOLUMNS; ++j) {
+
+        const uint32_t type = columns_[j].type;
+
+        if (j < NKIN) {
+            const double* src = buffer_.mom[j].data();
+            if (type == EVT_F64) {
+                std::memcpy(dst, src, n * sizeof(double));
+            } else {
+                float* p = reinterpret_cast<float*>(dst);
+                for (size_t i = 0; i < n; ++i) { p[i] = (float)src[i]; }
+            }
+        } else {
+            const int* src = (j == RECO) ? buffer_.reco.data() : buffer_.pidCode[j - PIDCODE1].data();
+            if (type == EVT_U8) {
+                uint8_t* p = reinterpret_cast<uint8_t*>(dst);
+                for (size_t i = 0; i < n; ++i) { p[i] = (uint8_t)src[i]; }
+            } else {
+                int16_t* p = reinterpret_cast<int16_t*>(dst);
+                for (size_t i = 0; i < n; ++i) { p[i] = (int16_t)src[i]; }
+            }
+        }
+        dst += EvtAlign(n * EvtTypeSize(type));
+    }
+
+    if (fwrite(raw.data(), 1, raw.size(), fp_) != raw.size()) {
+        printf("EventStoreWriter:: Error writing chunk %lu \n", (unsigned long)nchunks_);
+        return false;
+    }
+
+    nevents_ += n;
+    ++nchunks_;
+    buffer_.n = 0;
+
+    return true;
+}
+
+bool EventStoreWriter::Close() {
+
+    if (fp_ == nullptr) {
+        return true;
+    }
+    bool ok = FlushChunk();
+
+    // Patch the final counts into the header
+    header_.nevents = nevents_;
+    header_.nchunks = nchunks_;
+    if (fseek(fp_, 0, SEEK_SET) != 0 ||
+        fwrite(&header_, sizeof(EvtFileHeader), 1, fp_) != 1) {
+        printf("EventStoreWriter:: Error finalizing header \n");
+        ok = false;
+    }
+    fclose(fp_);
+    fp_ = nullptr;
+
+    return ok;
+}
+
+
+// ------------------------------------------------------------------------
+// Concatenation
+
+bool EvtConcatenate(const std::vector<std::string>& inputs, const std::string& output) {
+
+    if (inputs.empty()) {
+        printf("EvtConcatenate:: No input files \n");
+        return false;
+    }
+
+    FILE* out = fopen(output.c_str(), "wb");
+    if (out == NULL) {
+        printf("EvtConcatenate:: Cannot open output file: %s \n", output.c_str());
+        return false;
+    }
+
+    EvtFileHeader header;
+    std::vector<EvtColumnDesc> columns;
+    std::vector<char> buffer(1 << 22);
+    uint64_t nevents = 0;
+    uint64_t nchunks = 0;
+    uint32_t chunksize = 0;
+    bool ok = true;
+
+    for (size_t i = 0; i < inputs.size() && ok; ++i) {
+
+        FILE* fp = fopen(inputs[i].c_str(), "rb");
+        if (fp == NULL) {
+            printf("EvtConcatenate:: Cannot open input file: %s \n", inputs[i].c_str());
+            ok = false;
+            break;
+        }
+
+        // Header and schema, must be the same in all inputs
+        EvtFileHeader h;
+        std::vector<EvtColumnDesc> c;
+        if (fread(&h, sizeof(EvtFileHeader), 1, fp) == 1 && h.ncolumns > 0 && h.ncolumns < 1024) {
+            c.resize(h.ncolumns);
+            if (fread(c.data(), sizeof(EvtColumnDesc), h.ncolumns, fp) != h.ncolumns) {
+                c.clear();
+            }
+        }
+        if (!EvtCheckSchema(h, c) ||
+            (i > 0 && (c.size() != columns.size() ||
+                       std::memcmp(c.data(), columns.data(), c.size() * sizeof(EvtColumnDesc)) != 0))) {
+            printf("EvtConcatenate:: Incompatible input file: %s \n", inputs[i].c_str());
+            fclose(fp);
+            ok = false;
+            break;
+        }
+
+        // Output header area from the first input, counts are patched at the end
+        if (i == 0) {
+            header  = h;
+            columns = c;
+            std::vector<char> head(header.dataoffset, 0);
+            std::memcpy(head.data(), &header, sizeof(EvtFileHeader));
+            std::memcpy(head.data() + sizeof(EvtFileHeader), columns.data(),
+                        columns.size() * sizeof(EvtColumnDesc));
+            if (fwrite(head.data(), 1, head.size(), out) != head.size()) {
+                ok = false;
+            }
+        }
+
+        // Chunks are self-contained, copy them as they are
+        if (ok && fseek(fp, h.dataoffset, SEEK_SET) == 0) {
+            size_t nb;
+            while ((nb = fread(buffer.data(), 1, buffer.size(), fp)) > 0) {
+                if (fwrite(buffer.data(), 1, nb, out) != nb) {
+                    ok = false;
+                    break;
+                }
+            }
+        } else {
+            ok = false;
+        }
+        fclose(fp);
+
+        nevents  += h.nevents;
+        nchunks  += h.nchunks;
+        chunksize = std::max(chunksize, h.chunksize);
+    }
+
+    // Final counts
+    if (ok) {
+        header.nevents   = nevents;
+        header.nchunks   = nchunks;
+        header.chunksize = chunksize;
+        if (fseek(out, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(EvtFileHeader), 1, out) != 1) {
+            ok = false;
+        }
+    }
+    if (fclose(out) != 0) {
+        ok = false;
+    }
+    if (!ok) {
+        printf("EvtConcatenate:: Error writing: %s \n", output.c_str());
+    }
+
+    return ok;
+}
@@ -0,0 +1,96 @@
+// Native fixed-binning histograms (1D and 2D)
+// ------------------------------------------------------------------------
+
+
+// C++
+#include <algorithm>
+#include <vector>
+
+// Own
+#include "fasthist.h"
+
+
+// ------------------------------------------------------------------------
+// 1D
+
+void FastHist1D::Init(int N, double minval, double maxval) {
+    axis_ = FastAxis(N, minval, maxval);
+    sumw_.assign(N + 2, 0.0);
+    sumw2_.assign(N + 2, 0.0);
+    Reset();
+}
+
+void FastHist1D::Reset() {
+    std::fill(sumw_.begin(), sumw_.end(), 0.0);
+    std::fill(sumw2_.begin(), sumw2_.end(), 0.0);
+    std::fill(stats_, stats_ + 4, 0.0);
+    entries_ = 0.0;
+}
+
+void FastHist1D::Add(const FastHist1D& other) {
+    for (size_t i = 0; i < sumw_.size(); ++i) {
+        sumw_[i]  += other.sumw_[i];
+        sumw2_[i] += other.sumw2_[i];
+    }
+    for (int i = 0; i < 4; ++i) {
+        stats_[i] += other.stats_[i];
+    }
+    entries_ += other.entries_;
+}
+
+void FastHist1D::ToROOT(TH1D* h) const {
+
+    std::copy(sumw_.begin(), sumw_.end(), h->GetArray());
+
+    // Errors only if the ROOT histogram keeps them (Sumw2)
+    if (h->GetSumw2N() > 0) {
+        std::copy(sumw2_.begin(), sumw2_.end(), h->GetSumw2()->GetArray());
+    }
+    double stats[4];
+    std::copy(stats_, stats_ + 4, stats);
+    h->PutStats(stats);
+    h->SetEntries(entries_);
+}
+
+
+// ------------------------------------------------------------------------
+// 2D
+
+void FastHist2D::Init(int N1, double minval1, double maxval1, int N2, double minval2, double maxval2) {
+    xaxis_ = FastAxis(N1, minval1, maxval1);
+    yaxis_ = FastAxis(N2, minval2, maxval2);
+    sumw_.assign((N1 + 2) * (N2 + 2), 0.0);
+    sumw2_.assign((N1 + 2) * (N2 + 2), 0.0);
+    Reset();
+}
+
+void FastHist2D::Reset() {
+    std::fill(sumw_.begin(), sumw_.end(), 0.0);
+    std::fill(sumw2_.begin(), sumw2_.end(), 0.0);
+    std::fill(stats_, stats_ + 7, 0.0);
+    entries_ = 0.0;
+}
+
+void FastHist2D::Add(const FastHist2D& other) {
+    for (size_t i = 0; i < sumw_.size(); ++i) {
+        sumw_[i]  += other.sumw_[i];
+        sumw2_[i] += other.sumw2_[i];
+    }
+    for (int i = 0; i < 7; ++i) {
+        stats_[i] += other.stats_[i];
+    }
+    entries_ += other.entries_;
+}
+
+void FastHist2D::ToROOT(TH2D* h) const {
+
+    std::copy(sumw_.begin(), sumw_.end(), h->GetArray());
+
+    if (h->GetSumw2N() > 0) {
+        std::copy(sumw2_.begin(), sumw2_.end(), h->GetSumw2()->GetArray());
+    }
+    double stats[7];
+    std::copy(stats_, stats_ + 7, stats);
+    h->PutStats(stats);
+    h->SetEntries(entries_);
+}
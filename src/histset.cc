@@ -0,0 +1,457 @@
+// Full set of deeplot histogram triplets for one sample
+// ------------------------------------------------------------------------
+
+
+// C++
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// ROOT
+#include "TFile.h"
+#include "TObjString.h"
+
+// Own
+#include "histset.h"
+#include "plotstyle.h"
+
+
+const double PI = 3.14159265359;
+
+// Number of bins
+const int Nbin1D = 100;
+const int Nbin2D = 80;
+
+
+HistSet::HistSet(const std::string& PREDICTFILE, HistBackend backend) {
+
+    name_ = PREDICTFILE;
+
+    h1M = new h1Triplet(PREDICTFILE + "/h1M", ";System M (GeV); events", Nbin1D, 0.0, 4.0, "northeast", backend);
+        h1.push_back(h1M);
+    h1Y = new h1Triplet(PREDICTFILE + "/h1Y", ";System Y; events", Nbin1D, -1.0, 1.0, "northeast", backend);
+        h1.push_back(h1Y);
+    h1Pt = new h1Triplet(PREDICTFILE + "/h1Pt", ";System P_{T} (GeV); events", Nbin1D, 0.0, 2.0, "northeast", backend);
+        h1.push_back(h1Pt);
+    h1pt1 = new h1Triplet(PREDICTFILE + "/h1pt1", ";Track p_{T} (GeV); events", Nbin1D, 0.0, 2.0, "northeast", backend);
+        h1.push_back(h1pt1);
+    h1eta1 = new h1Triplet(PREDICTFILE + "/h1eta1", ";Track #eta; events", Nbin1D, -1.0, 1.0, "southeast", backend);
+        h1.push_back(h1eta1);
+    h1dY = new h1Triplet(PREDICTFILE + "/h1dY", ";#Deltay #equiv y_{1}-y_{2}; events", Nbin1D, -2.0, 2.0, "northeast", backend);
+        h1.push_back(h1dY);
+
+    h2etaphi = new h2Triplet(PREDICTFILE + "/h2etaphi", ";Track #eta; Track #phi (rad)", Nbin2D, -1.0, 1.0, Nbin2D,  -PI, PI, backend);
+        h2.push_back(h2etaphi);
+    h2etaeta = new h2Triplet(PREDICTFILE + "/h2etaeta", ";Track #eta^{(1)}; Track #eta^{(2)}", Nbin2D, -1.0, 1.0, Nbin2D,  -1.0, 1.0, backend);
+        h2.push_back(h2etaeta);
+    h2pt1pt2 = new h2Triplet(PREDICTFILE + "/h2pt1pt2", ";Track p_{T}^{(1)}; Track p_{T}^{(2)}", Nbin2D, 0.0, 2.0, Nbin2D,  0.0, 2.0, backend);
+        h2.push_back(h2pt1pt2);
+    h2Mdeltaphi = new h2Triplet(PREDICTFILE + "/h2Mdeltaphi", ";System M (GeV); Pair #Delta#phi (rad)", Nbin2D, 0.0, 4.0, Nbin2D,  0, PI, backend);
+        h2.push_back(h2Mdeltaphi);
+    h2MPt = new h2Triplet(PREDICTFILE + "/h2MPt", ";System M (GeV); System P_{T} (GeV)", Nbin2D, 0.0, 4.0, Nbin2D,  0, 2.5, backend);
+        h2.push_back(h2MPt);
+    h2Mpt1 = new h2Triplet(PREDICTFILE + "/h2Mpt1", ";System M (GeV); Track p_{T} (GeV)", Nbin2D, 0.0, 4.0, Nbin2D,  0, 2.5, backend);
+        h2.push_back(h2Mpt1);
+
+    h1W = new TH1D((PREDICTFILE + "/h1W").c_str(), ";DeepEfficiency-6D output w; events", 200, 0, 1.0);
+}
+
+HistSet::~HistSet() {
+    for (uint i = 0; i < h1.size(); ++i) {
+        delete h1.at(i);
+    }
+    for (uint i = 0; i < h2.size(); ++i) {
+        delete h2.at(i);
+    }
+    delete h1W;
+}
+
+void HistSet::EnableBootstrap(int R, uint64_t seed) {
+    if (R <= 0 || nboot_ > 0) {
+        return;
+    }
+    nboot_    = R;
+    bootseed_ = seed;
+    for (uint i = 0; i < h1.size(); ++i) {
+        h1.at(i)->EnableBootstrap(R, seed);
+    }
+    for (uint i = 0; i < h2.size(); ++i) {
+        h2.at(i)->EnableBootstrap(R, seed);
+    }
+}
+
+void HistSet::SetModels(const std::vector<std::string>& labels) {
+    if (labels.size() < 2 || !models_.empty()) {
+        return;
+    }
+    models_ = labels;
+    for (uint i = 0; i < h1.size(); ++i) {
+        h1.at(i)->SetModels(labels);
+    }
+    for (uint i = 0; i < h2.size(); ++i) {
+        h2.at(i)->SetModels(labels);
+    }
+}
+
+void HistSet::FillModel(size_t k, size_t n, const ObservablesBlock& rec, const unsigned char* reco,
+                        const double* weight) {
+
+    // 1D
+    h1M->FillCorr(k, n, rec.M.data(), reco, weight);
+    h1Y->FillCorr(k, n, rec.Y.data(), reco, weight);
+    h1Pt->FillCorr(k, n, rec.Pt.data(), reco, weight);
+    h1pt1->FillCorr(k, n, rec.pt1.data(), reco, weight);
+    h1eta1->FillCorr(k, n, rec.eta1.data(), reco, weight);
+    h1dY->FillCorr(k, n, rec.dY.data(), reco, weight);
+
+    // 2D
+    h2etaphi->FillCorr(k, n, rec.eta1.data(), rec.phi1.data(), reco, weight);
+    h2etaeta->FillCorr(k, n, rec.eta1.data(), rec.eta2.data(), reco, weight);
+    h2Mdeltaphi->FillCorr(k, n, rec.M.data(), rec.deltaphi.data(), reco, weight);
+    h2MPt->FillCorr(k, n, rec.M.data(), rec.Pt.data(), reco, weight);
+    h2Mpt1->FillCorr(k, n, rec.M.data(), rec.pt1.data(), reco, weight);
+    h2pt1pt2->FillCorr(k, n, rec.pt1.data(), rec.pt2.data(), reco, weight);
+}
+
+void HistSet::FillBatch(size_t n, const ObservablesBlock& gen, const ObservablesBlock& rec,
+                        const unsigned char* reco, const double* weight,
+                        const uint64_t* index) {
+
+    // Poisson weights of the events, shared by all histograms
+    const double* p = nullptr;
+    if (nboot_ > 0 && index != nullptr) {
+        poisson_.resize(n * BootstrapStride(nboot_));
+        PoissonWeights(n, index, nboot_, bootseed_, poisson_.data());
+        p = poisson_.data();
+    }
+
+    // 1D
+    h1M->FillBatch(n, gen.M.data(), rec.M.data(), reco, weight, p);
+    h1Y->FillBatch(n, gen.Y.data(), rec.Y.data(), reco, weight, p);
+    h1Pt->FillBatch(n, gen.Pt.data(), rec.Pt.data(), reco, weight, p);
+    h1pt1->FillBatch(n, gen.pt1.data(), rec.pt1.data(), reco, weight, p);
+    h1eta1->FillBatch(n, gen.eta1.data(), rec.eta1.data(), reco, weight, p);
+    h1dY->FillBatch(n, gen.dY.data(), rec.dY.data(), reco, weight, p);
+
+    // 2D
+    h2etaphi->FillBatch(n, gen.eta1.data(), gen.phi1.data(), rec.eta1.data(), rec.phi1.data(), reco, weight, p);
+    h2etaeta->FillBatch(n, gen.eta1.data(), gen.eta2.data(), rec.eta1.data(), rec.eta2.data(), reco, weight, p);
+    h2Mdeltaphi->FillBatch(n, gen.M.data(), gen.deltaphi.data(), rec.M.data(), rec.deltaphi.data(), reco, weight, p);
+    h2MPt->FillBatch(n, gen.M.data(), gen.Pt.data(), rec.M.data(), rec.Pt.data(), reco, weight, p);
+    h2Mpt1->FillBatch(n, gen.M.data(), gen.pt1.data(), rec.M.data(), rec.pt1.data(), reco, weight, p);
+    h2pt1pt2->FillBatch(n, gen.pt1.data(), gen.pt2.data(), rec.pt1.data(), rec.pt2.data(), reco, weight, p);
+
+    // DEBUG fills
+    for (size_t i = 0; i < n; ++i) {
+        h1W->Fill(1.0/weight[i]);
+    }
+}
+
+bool HistSet::Add(const HistSet& other) {
+
+    // Replicas of other seeds or counts, or other models, do not add up
+    if (other.nboot_ != nboot_ || (nboot_ > 0 && other.bootseed_ != bootseed_) || other.models_ != models_) {
+        printf("HistSet:: Cannot add %s: %d bootstrap replicas (seed %llu) and %lu models, not %d (seed %llu) and %lu \n",
+               other.name_.c_str(), other.nboot_, (unsigned long long)other.bootseed_, (unsigned long)other.GetNModels(),
+               nboot_, (unsigned long long)bootseed_, (unsigned long)GetNModels());
+        return false;
+    }
+    for (uint i = 0; i < h1.size(); ++i) {
+        if (!h1.at(i)->Add(*other.h1.at(i))) {
+            return false;
+        }
+    }
+    for (uint i = 0; i < h2.size(); ++i) {
+        if (!h2.at(i)->Add(*other.h2.at(i))) {
+            return false;
+        }
+    }
+    h1W->Add(other.h1W);
+
+    return true;
+}
+
+void HistSet::Sync() {
+    for (uint i = 0; i < h1.size(); ++i) {
+        h1.at(i)->Sync();
+    }
+    for (uint i = 0; i < h2.size(); ++i) {
+        h2.at(i)->Sync();
+    }
+}
+
+double HistSet::Chi2() {
+
+    double chi2sum = 0.0;
+    for (uint i = 0; i < h1.size(); ++i) {
+        chi2sum += h1.at(i)->Chi2();
+    }
+    for (uint i = 0; i < h2.size(); ++i) {
+        h2.at(i)->Sync();
+    }
+    printf("=======================================================\n");
+    printf("AVERAGE: <Chi2 / ndf> = %0.2f \n", chi2sum / (double)h1.size());
+    for (size_t k = 0; k < models_.size(); ++k) {
+        double sum = 0.0;
+        for (uint i = 0; i < h1.size(); ++i) {
+            sum += h1.at(i)->chi2ndfs_[k];
+        }
+        printf("  %s: <Chi2 / ndf> = %0.2f \n", models_[k].c_str(), sum / (double)h1.size());
+    }
+    printf("=======================================================\n");
+
+    return chi2sum / (double)h1.size();
+}
+
+void HistSet::SaveFig(size_t i) {
+    if (i < h1.size()) {
+        h1.at(i)->SaveFig();
+    } else if (i < h1.size() + h2.size()) {
+        h2.at(i - h1.size())->SaveFig();
+    } else {
+        std::string name = name_ + "/hx_weights";
+        PlotFilled(h1W, name, false, false);
+    }
+}
+
+void HistSet::SaveFig() {
+    for (size_t i = 0; i < GetNFigures(); ++i) {
+        SaveFig(i);
+    }
+}
+
+// Key name without the sample directory
+static std::string KeyName(const std::string& name, const std::string& suffix) {
+    const size_t slash = name.rfind('/');
+    return ((slash == std::string::npos) ? name : name.substr(slash + 1)) + suffix;
+}
+
+std::string HistSet::Manifest() const {
+
+    std::string text = "# deeplot histogram archive\n";
+    char line[512];
+    snprintf(line, sizeof(line), "version %d\nsample %s\n", HISTSET_VERSION, name_.c_str());
+    text += line;
+
+    for (uint i = 0; i < h1.size(); ++i) {
+        const h1Triplet* t = h1.at(i);
+        snprintf(line, sizeof(line), "h1 %s %d %0.17g %0.17g\n",
+                 KeyName(t->name_, "").c_str(), t->N_, t->minval_, t->maxval_);
+        text += line;
+    }
+    for (uint i = 0; i < h2.size(); ++i) {
+        const h2Triplet* t = h2.at(i);
+        const TAxis* x = t->hTrue->GetXaxis();
+        const TAxis* y = t->hTrue->GetYaxis();
+        snprintf(line, sizeof(line), "h2 %s %d %0.17g %0.17g %d %0.17g %0.17g\n",
+                 KeyName(t->name_, "").c_str(), x->GetNbins(), x->GetXmin(), x->GetXmax(),
+                 y->GetNbins(), y->GetXmin(), y->GetXmax());
+        text += line;
+    }
+    const TAxis* w = h1W->GetXaxis();
+    snprintf(line, sizeof(line), "h1W %d %0.17g %0.17g\n", w->GetNbins(), w->GetXmin(), w->GetXmax());
+    text += line;
+    if (nboot_ > 0) {
+        snprintf(line, sizeof(line), "bootstrap %d %llu\n", nboot_, (unsigned long long)bootseed_);
+        text += line;
+    }
+    if (!models_.empty()) {
+        text += "models";
+        for (size_t k = 0; k < models_.size(); ++k) {
+            text += " " + models_[k];
+        }
+        text += "\n";
+    }
+
+    return text;
+}
+
+bool HistSet::Write(const std::string& path, bool chi2) const {
+
+    const std::string rootfile = path + "/histograms.root";
+    TFile f(rootfile.c_str(), "RECREATE");
+    if (f.IsZombie()) {
+        printf("HistSet:: Cannot open output file: %s \n", rootfile.c_str());
+        return false;
+    }
+    for (uint i = 0; i < h1.size(); ++i) {
+        const h1Triplet* t = h1.at(i);
+        t->hTrue->Write(KeyName(t->name_, "True").c_str());
+        t->hReco->Write(KeyName(t->name_, "Reco").c_str());
+        t->hCorr->Write(KeyName(t->name_, "Corr").c_str());
+        t->h2ObsWeight->Write(KeyName(t->name_, "ObsWeight").c_str());
+        for (size_t k = 0; k < t->hCorrModel.size(); ++k) {
+            t->hCorrModel[k]->Write(KeyName(t->name_, "Corr_" + models_[k + 1]).c_str());
+        }
+        if (nboot_ > 0) {
+            t->hRecoBoot->Write(KeyName(t->name_, "RecoBoot").c_str());
+            t->hCorrBoot->Write(KeyName(t->name_, "CorrBoot").c_str());
+        }
+    }
+    for (uint i = 0; i < h2.size(); ++i) {
+        const h2Triplet* t = h2.at(i);
+        t->hTrue->Write(KeyName(t->name_, "True").c_str());
+        t->hReco->Write(KeyName(t->name_, "Reco").c_str());
+        t->hCorr->Write(KeyName(t->name_, "Corr").c_str());
+        for (size_t k = 0; k < t->hCorrModel.size(); ++k) {
+            t->hCorrModel[k]->Write(KeyName(t->name_, "Corr_" + models_[k + 1]).c_str());
+        }
+        if (nboot_ > 0) {
+            t->hRecoBoot->Write(KeyName(t->name_, "RecoBoot").c_str());
+            t->hCorrBoot->Write(KeyName(t->name_, "CorrBoot").c_str());
+        }
+    }
+    h1W->Write("h1W");
+    TObjString manifest(Manifest().c_str());
+    manifest.Write("manifest");
+    char line[256];
+    snprintf(line, sizeof(line), "first %llu\nnentries %llu\nnfiducial %llu\ntotal %llu\n",
+             (unsigned long long)counters.first, (unsigned long long)counters.nentries,
+             (unsigned long long)counters.nfiducial, (unsigned long long)counters.total);
+    TObjString countertext(line);
+    countertext.Write("counters");
+    f.Close();
+
+    if (!chi2) {
+        return true;
+    }
+
+    const std::string chi2file = path + "/chi2.txt";
+    FILE* fp = fopen(chi2file.c_str(), "w");
+    if (fp == NULL) {
+        printf("HistSet:: Cannot open output file: %s \n", chi2file.c_str());
+        return false;
+    }
+    const size_t nmodels = GetNModels();
+    std::vector<double> chi2sum(nmodels, 0.0);
+    fprintf(fp, "# histogram chi2/ndf (corrected vs generated)");
+    for (size_t k = 0; k < models_.size(); ++k) {
+        fprintf(fp, " %s", models_[k].c_str());
+    }
+    fprintf(fp, "\n");
+    for (uint i = 0; i < h1.size(); ++i) {
+        const h1Triplet* t = h1.at(i);
+        fprintf(fp, "%s", KeyName(t->name_, "").c_str());
+        for (size_t k = 0; k < nmodels; ++k) {
+            const double chi2ndf = (k < t->chi2ndfs_.size()) ? t->chi2ndfs_[k] : t->chi2ndf_;
+            fprintf(fp, " %0.6f", chi2ndf);
+            chi2sum[k] += chi2ndf;
+        }
+        fprintf(fp, "\n");
+    }
+    fprintf(fp, "average");
+    for (size_t k = 0; k < nmodels; ++k) {
+        fprintf(fp, " %0.6f", chi2sum[k] / (double)h1.size());
+    }
+    fprintf(fp, "\n");
+
+    return fclose(fp) == 0;
+}
+
+// Add the stored histogram key of file f into h
+static bool LoadHist(TFile& f, const std::string& key, TH1* h) {
+    TH1* stored = dynamic_cast<TH1*>(f.Get(key.c_str()));
+    if (stored == nullptr) {
+        printf("HistSet:: No histogram '%s' in: %s \n", key.c_str(), f.GetName());
+        return false;
+    }
+    h->Reset();
+    h->Add(stored);
+    delete stored;
+    return true;
+}
+
+bool HistSet::Read(const std::string& path) {
+
+    const std::string rootfile = path + "/histograms.root";
+    TFile f(rootfile.c_str(), "READ");
+    if (f.IsZombie()) {
+        printf("HistSet:: Cannot open input file: %s \n", rootfile.c_str());
+        return false;
+    }
+    TObjString* manifest = dynamic_cast<TObjString*>(f.Get("manifest"));
+    if (manifest == nullptr) {
+        printf("HistSet:: No manifest in: %s \n", rootfile.c_str());
+        return false;
+    }
+    const std::string stored = manifest->GetString().Data();
+    delete manifest;
+
+    // Bootstrap replicas and models as stored
+    const size_t pos = stored.find("\nbootstrap ");
+    if (pos != std::string::npos && nboot_ == 0) {
+        int R = 0;
+        unsigned long long seed = 0;
+        if (sscanf(stored.c_str() + pos + 1, "bootstrap %d %llu", &R, &seed) == 2) {
+            EnableBootstrap(R, seed);
+        }
+    }
+    const size_t mpos = stored.find("\nmodels ");
+    if (mpos != std::string::npos && models_.empty()) {
+        std::istringstream labels(stored.substr(mpos + 8, stored.find('\n', mpos + 1) - mpos - 8));
+        std::vector<std::string> models;
+        std::string label;
+        while (labels >> label) {
+            models.push_back(label);
+        }
+        SetModels(models);
+    }
+    const bool same = (Manifest() == stored);
+    if (!same) {
+        printf("HistSet:: %s has a different histogram layout than this build (rerun the event loop) \n",
+               rootfile.c_str());
+        return false;
+    }
+
+    bool ok = true;
+    for (uint i = 0; i < h1.size() && ok; ++i) {
+        h1Triplet* t = h1.at(i);
+        ok = LoadHist(f, KeyName(t->name_, "True"), t->hTrue) &&
+             LoadHist(f, KeyName(t->name_, "Reco"), t->hReco) &&
+             LoadHist(f, KeyName(t->name_, "Corr"), t->hCorr) &&
+             LoadHist(f, KeyName(t->name_, "ObsWeight"), t->h2ObsWeight);
+        for (size_t k = 0; k < t->hCorrModel.size() && ok; ++k) {
+            ok = LoadHist(f, KeyName(t->name_, "Corr_" + models_[k + 1]), t->hCorrModel[k]);
+        }
+        if (ok && nboot_ > 0) {
+            ok = LoadHist(f, KeyName(t->name_, "RecoBoot"), t->hRecoBoot) &&
+                 LoadHist(f, KeyName(t->name_, "CorrBoot"), t->hCorrBoot);
+            t->LoadBootstrap();
+        }
+    }
+    for (uint i = 0; i < h2.size() && ok; ++i) {
+        h2Triplet* t = h2.at(i);
+        ok = LoadHist(f, KeyName(t->name_, "True"), t->hTrue) &&
+             LoadHist(f, KeyName(t->name_, "Reco"), t->hReco) &&
+             LoadHist(f, KeyName(t->name_, "Corr"), t->hCorr);
+        for (size_t k = 0; k < t->hCorrModel.size() && ok; ++k) {
+            ok = LoadHist(f, KeyName(t->name_, "Corr_" + models_[k + 1]), t->hCorrModel[k]);
+        }
+        if (ok && nboot_ > 0) {
+            ok = LoadHist(f, KeyName(t->name_, "RecoBoot"), t->hRecoBoot) &&
+                 LoadHist(f, KeyName(t->name_, "CorrBoot"), t->hCorrBoot);
+            t->LoadBootstrap();
+        }
+    }
+    ok = ok && LoadHist(f, "h1W", h1W);
+
+    // Counters (zero if not stored)
+    counters = SampleCounters();
+    TObjString* countertext = dynamic_cast<TObjString*>(f.Get("counters"));
+    if (countertext != nullptr) {
+        std::istringstream lines(countertext->GetString().Data());
+        std::string key;
+        unsigned long long value = 0;
+        while (lines >> key >> value) {
+            if      (key == "first")     { counters.first     = value; }
+            else if (key == "nentries")  { counters.nentries  = value; }
+            else if (key == "nfiducial") { counters.nfiducial = value; }
+            else if (key == "total")     { counters.total     = value; }
+        }
+        delete countertext;
+    }
+    f.Close();
+
+    return ok;
+}
@@ -0,0 +1,159 @@
+// Two-track kinematics and observables in structure-of-arrays form
+// ------------------------------------------------------------------------
+
+
+// C++
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Own
+#include "kinematics.h"
+
+
+const double KIN_PI    = 3.14159265358979323846; // TMath::Pi()
+const double KIN_TWOPI = 2.0 * KIN_PI;
+
+// Events per inner block (temporaries on the stack)
+const size_t KINSTRIDE = 256;
+
+
+size_t ObservablesBlock::Select(size_t n, const unsigned char* mask) {
+    size_t m = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (mask[i]) {
+            if (m != i) {
+                M[m]        = M[i];
+                Y[m]        = Y[i];
+                Pt[m]       = Pt[i];
+                dY[m]       = dY[i];
+                eta1[m]     = eta1[i];
+                eta2[m]     = eta2[i];
+                phi1[m]     = phi1[i];
+                pt1[m]      = pt1[i];
+                pt2[m]      = pt2[i];
+                deltaphi[m] = deltaphi[i];
+            }
+            ++m;
+        }
+    }
+    return m;
+}
+
+void AssignMasses(size_t n, const int* pidCode, double* mass) {
+    for (size_t i = 0; i < n; ++i) {
+        mass[i] = PIDMass(pidCode[i]);
+    }
+}
+
+// Pseudorapidity from TVector3::CosTheta(), same as TVector3::PseudoRapidity()
+static inline double PseudoRapidity(double cosTheta, double pz) {
+    if (cosTheta * cosTheta < 1) {
+        return -0.5 * std::log((1.0 - cosTheta) / (1.0 + cosTheta));
+    }
+    if (pz == 0) {
+        return 0;
+    }
+    return (pz > 0) ? 10e10 : -10e10;
+}
+
+// Azimuth, same as TVector3::Phi()
+static inline double Azimuth(double px, double py) {
+    return (px == 0.0 && py == 0.0) ? 0.0 : std::atan2(py, px);
+}
+
+void ComputeObservables(size_t n, const TrackColumns& t1, const TrackColumns& t2, ObservablesBlock& obs) {
+
+    obs.Resize(n);
+
+    // Per track and per system intermediates (on the stack, so that
+    // the compiler can prove they do not alias the input columns)
+    double pt1_[KINSTRIDE];
+    double pt2_[KINSTRIDE];
+    double M_[KINSTRIDE];
+    double Pt_[KINSTRIDE];
+    double E1[KINSTRIDE];
+    double E2[KINSTRIDE];
+    double cos1[KINSTRIDE];
+    double cos2[KINSTRIDE];
+    double phi2[KINSTRIDE];
+
+    for (size_t i0 = 0; i0 < n; i0 += KINSTRIDE) {
+        const size_t m = std::min(KINSTRIDE, n - i0);
+
+        const double* px1 = t1.px + i0;
+        const double* py1 = t1.py + i0;
+        const double* pz1 = t1.pz + i0;
+        const double* m1  = t1.m  + i0;
+        const double* px2 = t2.px + i0;
+        const double* py2 = t2.py + i0;
+        const double* pz2 = t2.pz + i0;
+        const double* m2  = t2.m  + i0;
+
+        double* __restrict M        = obs.M.data() + i0;
+        double* __restrict Y        = obs.Y.data() + i0;
+        double* __restrict Pt       = obs.Pt.data() + i0;
+        double* __restrict dY       = obs.dY.data() + i0;
+        double* __restrict eta1     = obs.eta1.data() + i0;
+        double* __restrict eta2     = obs.eta2.data() + i0;
+        double* __restrict phi1     = obs.phi1.data() + i0;
+        double* __restrict pt1      = obs.pt1.data() + i0;
+        double* __restrict pt2      = obs.pt2.data() + i0;
+        double* __restrict deltaphi = obs.deltaphi.data() + i0;
+
+        // 1. Square roots and sums (vectorized)
+        for (size_t j = 0; j < m; ++j) {
+
+            // Track 1
+            const double perp2_1 = px1[j]*px1[j] + py1[j]*py1[j];
+            const double mag2_1  = perp2_1 + pz1[j]*pz1[j];
+            const double mag_1   = std::sqrt(mag2_1);
+            E1[j]   = std::sqrt(mag2_1 + m1[j]*m1[j]);
+            pt1_[j] = std::sqrt(perp2_1);
+            cos1[j] = (mag_1 == 0.0) ? 1.0 : pz1[j] / mag_1;
+
+            // Track 2
+            const double perp2_2 = px2[j]*px2[j] + py2[j]*py2[j];
+            const double mag2_2  = perp2_2 + pz2[j]*pz2[j];
+            const double mag_2   = std::sqrt(mag2_2);
+            E2[j]   = std::sqrt(mag2_2 + m2[j]*m2[j]);
+            pt2_[j] = std::sqrt(perp2_2);
+            cos2[j] = (mag_2 == 0.0) ? 1.0 : pz2[j] / mag_2;
+
+            // System
+            const double px = px1[j] + px2[j];
+            const double py = py1[j] + py2[j];
+            const double pz = pz1[j] + pz2[j];
+            const double E  = E1[j] + E2[j];
+
+            const double mag2 = px*px + py*py + pz*pz;
+            const double mm   = E*E - mag2;
+            M_[j]  = (mm < 0.0) ? -std::sqrt(-mm) : std::sqrt(mm);
+            Pt_[j] = std::sqrt(px*px + py*py);
+            Y[j]   = py; // TLorentzVector::Y()
+        }
+
+        // 2. Logarithms and angles
+        for (size_t j = 0; j < m; ++j) {
+            eta1[j] = PseudoRapidity(cos1[j], pz1[j]);
+            eta2[j] = PseudoRapidity(cos2[j], pz2[j]);
+            dY[j]   = 0.5 * std::log((E1[j] + pz1[j]) / (E1[j] - pz1[j]))
+                    - 0.5 * std::log((E2[j] + pz2[j]) / (E2[j] - pz2[j]));
+            phi1[j] = Azimuth(px1[j], py1[j]);
+            phi2[j] = Azimuth(px2[j], py2[j]);
+        }
+
+        std::copy(M_, M_ + m, M);
+        std::copy(Pt_, Pt_ + m, Pt);
+        std::copy(pt1_, pt1_ + m, pt1);
+        std::copy(pt2_, pt2_ + m, pt2);
+
+        // 3. Azimuthal difference wrapped to [-pi, pi) (vectorized)
+        for (size_t j = 0; j < m; ++j) {
+            double d = phi1[j] - phi2[j];
+            d = (d >= KIN_PI) ? d - KIN_TWOPI : d;
+            d = (d < -KIN_PI) ? d + KIN_TWOPI : d;
+            deltaphi[j] = d;
+        }
+    }
+}
@@ -0,0 +1,307 @@
+// DeepEfficiency MLP inference (float32, batched)
+// ------------------------------------------------------------------------
+
+
+// C++
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+// Own
+#include "mlp.h"
+
+
+bool MLP::Load(const std::string& filename) {
+
+    layers_.clear();
+    filename_ = filename;
+
+    FILE* fp = fopen(filename.c_str(), "rb");
+    if (fp == NULL) {
+        printf("MLP:: Cannot open network file: %s \n", filename.c_str());
+        return false;
+    }
+
+    char magic[8];
+    uint32_t version = 0;
+    uint32_t nlayers = 0;
+    if (fread(magic, 1, 8, fp) != 8 || std::memcmp(magic, MLP_MAGIC, 8) != 0) {
+        printf("MLP:: Not a network file (bad magic): %s \n", filename.c_str());
+        fclose(fp);
+        return false;
+    }
+    if (fread(&version, sizeof(version), 1, fp) != 1 || version > MLP_VERSION) {
+        printf("MLP:: Unsupported format version %u (this build reads <= %u) \n", version, MLP_VERSION);
+        fclose(fp);
+        return false;
+    }
+    if (fread(&nlayers, sizeof(nlayers), 1, fp) != 1 || nlayers == 0) {
+        printf("MLP:: No layers in: %s \n", filename.c_str());
+        fclose(fp);
+        return false;
+    }
+
+    for (uint32_t l = 0; l < nlayers; ++l) {
+        MLPLayer layer;
+        uint32_t desc[4];
+        if (fread(desc, sizeof(uint32_t), 4, fp) != 4) {
+            printf("MLP:: Truncated layer %u header \n", l);
+            fclose(fp);
+            return false;
+        }
+        layer.nin        = desc[0];
+        layer.nout       = desc[1];
+        layer.activation = desc[2];
+
+        if (layer.activation > MLP_SIGMOID) {
+            printf("MLP:: Layer %u has unknown activation %u \n", l, layer.activation);
+            fclose(fp);
+            return false;
+        }
+        if (l > 0 && layer.nin != layers_.back().nout) {
+            printf("MLP:: Layer %u input dimension %u does not match previous output %u \n",
+                   l, layer.nin, layers_.back().nout);
+            fclose(fp);
+            return false;
+        }
+        layer.W.resize((size_t)layer.nin * layer.nout);
+        layer.b.resize(layer.nout);
+        if (fread(layer.W.data(), sizeof(float), layer.W.size(), fp) != layer.W.size() ||
+            fread(layer.b.data(), sizeof(float), layer.b.size(), fp) != layer.b.size()) {
+            printf("MLP:: Truncated layer %u parameters \n", l);
+            fclose(fp);
+            return false;
+        }
+        layers_.push_back(layer);
+    }
+    fclose(fp);
+
+    return true;
+}
+
+bool MLP::Save(const std::string& filename) const {
+
+    FILE* fp = fopen(filename.c_str(), "wb");
+    if (fp == NULL) {
+        printf("MLP:: Cannot open output file: %s \n", filename.c_str());
+        return false;
+    }
+    const uint32_t nlayers = layers_.size();
+    bool ok = fwrite(MLP_MAGIC, 1, 8, fp) == 8 &&
+              fwrite(&MLP_VERSION, sizeof(uint32_t), 1, fp) == 1 &&
+              fwrite(&nlayers, sizeof(uint32_t), 1, fp) == 1;
+
+    for (uint32_t l = 0; l < nlayers && ok; ++l) {
+        const MLPLayer& layer = layers_[l];
+        const uint32_t desc[4] = {layer.nin, layer.nout, layer.activation, 0};
+        ok = fwrite(desc, sizeof(uint32_t), 4, fp) == 4 &&
+             fwrite(layer.W.data(), sizeof(float), layer.W.size(), fp) == layer.W.size() &&
+             fwrite(layer.b.data(), sizeof(float), layer.b.size(), fp) == layer.b.size();
+    }
+    if (fclose(fp) != 0 || !ok) {
+        printf("MLP:: Error writing: %s \n", filename.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// Register block of the dense layer: MLP_ROWS events x MLP_COLS outputs
+const size_t MLP_ROWS = 4;
+const size_t MLP_COLS = 16;
+
+// One register block, x[MLP_ROWS][nin] with W, b and y offset to the first output
+static inline void DenseBlock(size_t nin, size_t nout, const float* x, const float* W,
+                              const float* b, float* y) {
+
+#if defined(__AVX2__) && defined(__FMA__)
+    const __m256 b0 = _mm256_loadu_ps(b);
+    const __m256 b1 = _mm256_loadu_ps(b + 8);
+    __m256 c00 = b0, c01 = b1;
+    __m256 c10 = b0, c11 = b1;
+    __m256 c20 = b0, c21 = b1;
+    __m256 c30 = b0, c31 = b1;
+
+    for (size_t k = 0; k < nin; ++k) {
+        const __m256 w0 = _mm256_loadu_ps(W + k * nout);
+        const __m256 w1 = _mm256_loadu_ps(W + k * nout + 8);
+        __m256 a;
+        a = _mm256_broadcast_ss(x + k);
+        c00 = _mm256_fmadd_ps(a, w0, c00); c01 = _mm256_fmadd_ps(a, w1, c01);
+        a = _mm256_broadcast_ss(x + nin + k);
+        c10 = _mm256_fmadd_ps(a, w0, c10); c11 = _mm256_fmadd_ps(a, w1, c11);
+        a = _mm256_broadcast_ss(x + 2 * nin + k);
+        c20 = _mm256_fmadd_ps(a, w0, c20); c21 = _mm256_fmadd_ps(a, w1, c21);
+        a = _mm256_broadcast_ss(x + 3 * nin + k);
+        c30 = _mm256_fmadd_ps(a, w0, c30); c31 = _mm256_fmadd_ps(a, w1, c31);
+    }
+    _mm256_storeu_ps(y, c00);            _mm256_storeu_ps(y + 8, c01);
+    _mm256_storeu_ps(y + nout, c10);     _mm256_storeu_ps(y + nout + 8, c11);
+    _mm256_storeu_ps(y + 2 * nout, c20); _mm256_storeu_ps(y + 2 * nout + 8, c21);
+    _mm256_storeu_ps(y + 3 * nout, c30); _mm256_storeu_ps(y + 3 * nout + 8, c31);
+#else
+    float acc[MLP_ROWS][MLP_COLS];
+    for (size_t r = 0; r < MLP_ROWS; ++r) {
+        for (size_t j = 0; j < MLP_COLS; ++j) {
+            acc[r][j] = b[j];
+        }
+    }
+    for (size_t k = 0; k < nin; ++k) {
+        const float* w = W + k * nout;
+        for (size_t r = 0; r < MLP_ROWS; ++r) {
+            const float a = x[r * nin + k];
+            for (size_t j = 0; j < MLP_COLS; ++j) {
+                acc[r][j] += a * w[j];
+            }
+        }
+    }
+    for (size_t r = 0; r < MLP_ROWS; ++r) {
+        for (size_t j = 0; j < MLP_COLS; ++j) {
+            y[r * nout + j] = acc[r][j];
+        }
+    }
+#endif
+}
+
+// Dense layer for n rows: y[n][nout] = x[n][nin] W + b
+void MLPDense(size_t n, size_t nin, size_t nout, const float* x, const float* W, const float* b, float* y) {
+
+    size_t i = 0;
+    for (; i + MLP_ROWS <= n; i += MLP_ROWS) {
+        const float* xi = x + i * nin;
+        float* yi = y + i * nout;
+
+        // Accumulators stay in registers, the weight columns are
+        // streamed once per block of rows
+        size_t o0 = 0;
+        for (; o0 + MLP_COLS <= nout; o0 += MLP_COLS) {
+            DenseBlock(nin, nout, xi, W + o0, b + o0, yi + o0);
+        }
+
+        // Remaining outputs
+        for (size_t r = 0; r < MLP_ROWS; ++r) {
+            for (size_t o = o0; o < nout; ++o) {
+                float sum = b[o];
+                for (size_t k = 0; k < nin; ++k) {
+                    sum += xi[r * nin + k] * W[k * nout + o];
+                }
+                yi[r * nout + o] = sum;
+            }
+        }
+    }
+
+    // Remaining rows
+    for (; i < n; ++i) {
+        const float* xi = x + i * nin;
+        float* yi = y + i * nout;
+        std::copy(b, b + nout, yi);
+        for (size_t k = 0; k < nin; ++k) {
+            const float a = xi[k];
+            const float* w = W + k * nout;
+            for (size_t o = 0; o < nout; ++o) {
+                yi[o] += a * w[o];
+            }
+        }
+    }
+}
+
+// Rational approximation of tanh (float precision, vectorizable),
+// the same form as used by Eigen / TensorFlow float CPU kernels
+static void Tanh(size_t n, float* x) {
+
+    const float alpha_1  =  4.89352455891786e-03f;
+    const float alpha_3  =  6.37261928875436e-04f;
+    const float alpha_5  =  1.48572235717979e-05f;
+    const float alpha_7  =  5.12229709037114e-08f;
+    const float alpha_9  = -8.60467152213735e-11f;
+    const float alpha_11 =  2.00018790482477e-13f;
+    const float alpha_13 = -2.76076847742355e-16f;
+    const float beta_0   =  4.89352518554385e-03f;
+    const float beta_2   =  2.26843463243900e-03f;
+    const float beta_4   =  1.18534705686654e-04f;
+    const float beta_6   =  1.19825839466702e-06f;
+    const float clamp    =  7.90531110763549805f;
+
+    for (size_t i = 0; i < n; ++i) {
+        const float v  = std::min(clamp, std::max(-clamp, x[i]));
+        const float v2 = v * v;
+
+        float p = alpha_13;
+        p = p * v2 + alpha_11;
+        p = p * v2 + alpha_9;
+        p = p * v2 + alpha_7;
+        p = p * v2 + alpha_5;
+        p = p * v2 + alpha_3;
+        p = p * v2 + alpha_1;
+        p = p * v;
+
+        float q = beta_6;
+        q = q * v2 + beta_4;
+        q = q * v2 + beta_2;
+        q = q * v2 + beta_0;
+
+        // Small arguments: tanh(x) = x
+        x[i] = (std::abs(x[i]) < 0.0004f) ? x[i] : p / q;
+    }
+}
+
+static void Sigmoid(size_t n, float* x) {
+    for (size_t i = 0; i < n; ++i) {
+        x[i] = 1.0f / (1.0f + std::exp(-x[i]));
+    }
+}
+
+void MLPActivate(uint32_t activation, size_t n, float* x) {
+    if (activation == MLP_TANH) {
+        Tanh(n, x);
+    }
+    if (activation == MLP_SIGMOID) {
+        Sigmoid(n, x);
+    }
+}
+
+void MLP::Predict(size_t n, const float* x, float* out, MLPWorkspace& ws) const {
+
+    if (layers_.empty()) {
+        return;
+    }
+    size_t maxwidth = 0;
+    for (size_t l = 0; l < layers_.size(); ++l) {
+        maxwidth = std::max<size_t>(maxwidth, layers_[l].nout);
+    }
+    ws.a.resize(MLP_BATCH * maxwidth);
+    ws.b.resize(MLP_BATCH * maxwidth);
+
+    const size_t nin  = GetNInput();
+    const size_t nout = GetNOutput();
+
+    // Batches of MLP_BATCH events through all layers
+    for (size_t i0 = 0; i0 < n; i0 += MLP_BATCH) {
+        const size_t m = std::min(MLP_BATCH, n - i0);
+
+        const float* input = x + i0 * nin;
+        float* output = ws.a.data();
+
+        for (size_t l = 0; l < layers_.size(); ++l) {
+            const MLPLayer& layer = layers_[l];
+
+            // Last layer directly to the output
+            if (l + 1 == layers_.size()) {
+                output = out + i0 * nout;
+            }
+            MLPDense(m, layer.nin, layer.nout, input, layer.W.data(), layer.b.data(), output);
+            MLPActivate(layer.activation, m * layer.nout, output);
+
+            // Swap scratch buffers
+            input  = output;
+            output = (output == ws.a.data()) ? ws.b.data() : ws.a.data();
+        }
+    }
+}
@@ -0,0 +1,334 @@
+// DeepEfficiency MLP training (float32, data parallel mini-batches)
+// ------------------------------------------------------------------------
+
+
+// C++
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Own
+#include "mlptrain.h"
+
+
+// Barrier of the lockstep threads (a mini-batch step takes microseconds,
+// too short for sleeping on a condition variable)
+class SpinBarrier {
+
+public:
+    explicit SpinBarrier(int n) : n_(n) {}
+
+    void Wait() {
+        const unsigned gen = gen_.load(std::memory_order_acquire);
+        if (count_.fetch_add(1, std::memory_order_acq_rel) + 1 == n_) {
+            count_.store(0, std::memory_order_relaxed);
+            gen_.fetch_add(1, std::memory_order_release);
+            return;
+        }
+        int spins = 0;
+        while (gen_.load(std::memory_order_acquire) == gen) {
+            if (++spins > 1000) {
+                std::this_thread::yield(); // More threads than cores
+            }
+        }
+    }
+
+private:
+    const int n_;
+    std::atomic<int> count_{0};
+    std::atomic<unsigned> gen_{0};
+};
+
+
+// y[k][r] = x[r][k] for x[m][n]
+static void Transpose(size_t m, size_t n, const float* x, float* y) {
+    for (size_t r = 0; r < m; ++r) {
+        for (size_t k = 0; k < n; ++k) {
+            y[k * m + r] = x[r * n + k];
+        }
+    }
+}
+
+
+bool MLPTrainer::Init(const std::vector<uint32_t>& nodes, float sigma, uint64_t seed,
+                      const MLPTrainParam& param) {
+
+    if (nodes.size() < 2 || nodes.back() != 1) {
+        printf("MLPTrainer:: Network needs an input and one output node \n");
+        return false;
+    }
+    if (param.batchsize == 0 || param.nthreads < 1) {
+        printf("MLPTrainer:: Invalid batch size %lu or number of threads %d \n",
+               (unsigned long)param.batchsize, param.nthreads);
+        return false;
+    }
+    param_ = param;
+
+    // More threads than rows of a batch would have nothing to do
+    param_.nthreads = std::min<size_t>(param_.nthreads, param_.batchsize);
+
+    std::mt19937_64 rng(seed);
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+
+    const size_t nlayers = nodes.size() - 1;
+    net_.layers_.assign(nlayers, MLPLayer());
+    WT_.assign(nlayers, std::vector<float>());
+    segments_.clear();
+    nparam_   = 0;
+    maxwidth_ = 0;
+
+    for (size_t l = 0; l < nlayers; ++l) {
+        MLPLayer& layer = net_.layers_[l];
+        layer.nin        = nodes[l];
+        layer.nout       = nodes[l + 1];
+        layer.activation = (l + 1 == nlayers) ? MLP_SIGMOID : MLP_TANH;
+        layer.W.resize((size_t)layer.nin * layer.nout);
+        layer.b.assign(layer.nout, 0.0f);
+        for (size_t i = 0; i < layer.W.size(); ++i) {
+            layer.W[i] = sigma * normal(rng);
+        }
+        WT_[l].resize(layer.W.size());
+        Transpose(layer.nin, layer.nout, layer.W.data(), WT_[l].data());
+
+        segments_.push_back({layer.W.data(), WT_[l].data(), nparam_, layer.W.size(), layer.nin, layer.nout});
+        nparam_ += layer.W.size();
+        segments_.push_back({layer.b.data(), nullptr, nparam_, layer.b.size(), 1, layer.nout});
+        nparam_ += layer.b.size();
+
+        maxwidth_ = std::max<size_t>(maxwidth_, std::max(layer.nin, layer.nout));
+    }
+    zeros_.assign(maxwidth_, 0.0f);
+
+    m_.assign(nparam_, 0.0f);
+    v_.assign(nparam_, 0.0f);
+    gsum_.assign(nparam_, 0.0f);
+    step_ = 0;
+
+    ws_.assign(param_.nthreads, MLPTrainWorkspace());
+    for (size_t t = 0; t < ws_.size(); ++t) {
+        MLPTrainWorkspace& ws = ws_[t];
+        ws.a.resize(nlayers);
+        for (size_t l = 0; l < nlayers; ++l) {
+            ws.a[l].resize(param_.batchsize * net_.layers_[l].nout);
+        }
+        ws.xt.resize(param_.batchsize * maxwidth_);
+        ws.delta.resize(param_.batchsize * maxwidth_);
+        ws.dnext.resize(param_.batchsize * maxwidth_);
+        ws.grad.resize(nparam_);
+    }
+
+    return true;
+}
+
+double MLPTrainer::TrainEpoch(size_t n, const float* x, const float* y, double& lastcost) {
+
+    double sumcost = 0.0;
+    lastcost = 0.0;
+    if (n == 0 || ws_.empty()) {
+        return 0.0;
+    }
+
+    // All threads step through the same batches, the calling thread is thread 0
+    SpinBarrier barrier(ws_.size());
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < ws_.size(); ++t) {
+        threads.emplace_back(&MLPTrainer::Worker, this, (int)t, n, x, y,
+                             std::ref(barrier), std::ref(sumcost), std::ref(lastcost));
+    }
+    Worker(0, n, x, y, barrier, sumcost, lastcost);
+    for (size_t t = 0; t < threads.size(); ++t) {
+        threads[t].join();
+    }
+
+    const size_t nbatches = (n + param_.batchsize - 1) / param_.batchsize;
+    step_ += nbatches;
+
+    return sumcost / nbatches;
+}
+
+void MLPTrainer::Worker(int t, size_t n, const float* x, const float* y, SpinBarrier& barrier,
+                        double& sumcost, double& lastcost) {
+
+    const size_t T   = ws_.size();
+    const size_t nin = net_.GetNInput();
+    uint64_t step = step_;
+
+    for (size_t i0 = 0; i0 < n; i0 += param_.batchsize) {
+        const size_t m  = std::min(param_.batchsize, n - i0);
+        const size_t r0 = i0 + m * t / T;
+        const size_t r1 = i0 + m * (t + 1) / T;
+
+        // Gradient of the rows of this thread
+        Gradient(ws_[t], r1 - r0, x + r0 * nin, y + r0);
+        barrier.Wait();
+
+        double loss = 0.0;
+        if (t == 0) {
+            for (size_t k = 0; k < T; ++k) {
+                loss += ws_[k].loss;
+            }
+        }
+
+        // Reduction and update of the parameter range of this thread
+        Update(t, ++step);
+        barrier.Wait();
+
+        // Cost with the weights before the update (as sess.run([optimizer, cost]))
+        if (t == 0) {
+            double reg = 0.0;
+            for (size_t k = 0; k < T; ++k) {
+                reg += ws_[k].reg;
+            }
+            lastcost = loss + 0.5 * param_.beta * reg;
+            sumcost += lastcost;
+        }
+    }
+}
+
+void MLPTrainer::Gradient(MLPTrainWorkspace& ws, size_t m, const float* x, const float* y) {
+
+    ws.loss = 0.0;
+    if (m == 0) {
+        std::fill(ws.grad.begin(), ws.grad.end(), 0.0f);
+        return;
+    }
+    const std::vector<MLPLayer>& layers = net_.layers_;
+    const size_t nlayers = layers.size();
+
+    // Forward pass, the layer outputs are kept for the backward pass
+    const float* input = x;
+    for (size_t l = 0; l < nlayers; ++l) {
+        const MLPLayer& layer = layers[l];
+        float* output = ws.a[l].data();
+        MLPDense(m, layer.nin, layer.nout, input, layer.W.data(), layer.b.data(), output);
+        MLPActivate(layer.activation, m * layer.nout, output);
+        input = output;
+    }
+
+    // Cross-entropy of the clipped sigmoid output, d cost / d z = p - y
+    // (zero where the clipping is active)
+    const float* p  = ws.a[nlayers - 1].data();
+    const float eps = param_.epsilon;
+    float* delta = ws.delta.data();
+    float* dnext = ws.dnext.data();
+    for (size_t r = 0; r < m; ++r) {
+        const double pc = std::min(std::max(p[r], eps), 1.0f - eps);
+        ws.loss -= y[r] * std::log(pc) + (1.0 - y[r]) * std::log(1.0 - pc);
+        delta[r] = (p[r] >= eps && p[r] <= 1.0f - eps) ? p[r] - y[r] : 0.0f;
+    }
+
+    // Backward pass, all products with the same dense kernel:
+    // dW = a^T delta, delta_below = (delta W^T) f'(a)
+    for (size_t l = nlayers; l-- > 0;) {
+        const MLPLayer& layer = layers[l];
+        const size_t nin  = layer.nin;
+        const size_t nout = layer.nout;
+        const float* a = (l == 0) ? x : ws.a[l - 1].data();
+
+        float* gW = ws.grad.data() + segments_[2 * l].offset;
+        float* gb = ws.grad.data() + segments_[2 * l + 1].offset;
+
+        Transpose(m, nin, a, ws.xt.data());
+        MLPDense(nin, m, nout, ws.xt.data(), delta, zeros_.data(), gW);
+
+        std::fill(gb, gb + nout, 0.0f);
+        for (size_t r = 0; r < m; ++r) {
+            for (size_t o = 0; o < nout; ++o) {
+                gb[o] += delta[r * nout + o];
+            }
+        }
+
+        if (l > 0) {
+            MLPDense(m, nout, nin, delta, WT_[l].data(), zeros_.data(), dnext);
+
+            const uint32_t activation = layers[l - 1].activation;
+            if (activation == MLP_TANH) {
+                for (size_t i = 0; i < m * nin; ++i) {
+                    dnext[i] *= 1.0f - a[i] * a[i];
+                }
+            }
+            if (activation == MLP_SIGMOID) {
+                for (size_t i = 0; i < m * nin; ++i) {
+                    dnext[i] *= a[i] * (1.0f - a[i]);
+                }
+            }
+            std::swap(delta, dnext);
+        }
+    }
+}
+
+void MLPTrainer::Update(int t, uint64_t step) {
+
+    MLPTrainWorkspace& ws = ws_[t];
+    ws.reg = 0.0;
+
+    // Parameter range of this thread (cache line aligned)
+    const size_t T     = ws_.size();
+    const size_t range = (nparam_ + 16 * T - 1) / (16 * T) * 16;
+    const size_t lo    = std::min(nparam_, t * range);
+    const size_t hi    = std::min(nparam_, lo + range);
+    if (lo >= hi) {
+        return;
+    }
+
+    // Sum of the thread gradients in thread order
+    float* g = gsum_.data();
+    std::copy(ws_[0].grad.begin() + lo, ws_[0].grad.begin() + hi, g + lo);
+    for (size_t k = 1; k < T; ++k) {
+        const float* gk = ws_[k].grad.data();
+        for (size_t j = lo; j < hi; ++j) {
+            g[j] += gk[j];
+        }
+    }
+
+    // Adam with the bias correction in the step size (as TensorFlow)
+    const float b1  = param_.adambeta1;
+    const float b2  = param_.adambeta2;
+    const float lrt = param_.learningrate * std::sqrt(1.0 - std::pow((double)b2, (double)step)) /
+                      (1.0 - std::pow((double)b1, (double)step));
+    const float eps = param_.adamepsilon;
+
+    for (size_t s = 0; s < segments_.size(); ++s) {
+        const Segment& seg = segments_[s];
+        const size_t j0 = std::max(lo, seg.offset);
+        const size_t j1 = std::min(hi, seg.offset + seg.size);
+        if (j0 >= j1) {
+            continue;
+        }
+        float* w = seg.param + (j0 - seg.offset);
+        float* m = m_.data() + j0;
+        float* v = v_.data() + j0;
+        const float* gj = g + j0;
+        const size_t len = j1 - j0;
+
+        // L2 regularization of the weights
+        const bool weight = (seg.transpose != nullptr);
+        const float beta  = weight ? param_.beta : 0.0f;
+        if (weight) {
+            double reg = 0.0;
+            for (size_t i = 0; i < len; ++i) {
+                reg += w[i] * w[i];
+            }
+            ws.reg += reg;
+        }
+
+        for (size_t i = 0; i < len; ++i) {
+            const float gi = gj[i] + beta * w[i];
+            m[i] = b1 * m[i] + (1.0f - b1) * gi;
+            v[i] = b2 * v[i] + (1.0f - b2) * gi * gi;
+            w[i] -= lrt * m[i] / (std::sqrt(v[i]) + eps);
+        }
+
+        // Transposed copy for the backward pass
+        if (weight) {
+            for (size_t i = j0 - seg.offset; i < j1 - seg.offset; ++i) {
+                seg.transpose[(i % seg.nout) * seg.nin + i / seg.nout] = seg.param[i];
+            }
+        }
+    }
+}
@@ -0,0 +1,84 @@
+// Read-only memory mapped file
+// ------------------------------------------------------------------------
+
+
+// C++
+#include <cstdio>
+#include <string>
+
+// POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Own
+#include "mmapfile.h"
+
+
+bool MappedFile::Open(const std::string& filename, bool sequential) {
+
+    Close();
+
+    fd_ = open(filename.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd_, &st) != 0) {
+        Close();
+        return false;
+    }
+    size_     = st.st_size;
+    released_ = 0;
+    filename_ = filename;
+
+    // Empty file is valid, just nothing to map
+    if (size_ == 0) {
+        return true;
+    }
+    void* ptr = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (ptr == MAP_FAILED) {
+        printf("MappedFile:: mmap failed: %s \n", filename.c_str());
+        Close();
+        return false;
+    }
+    data_ = static_cast<const char*>(ptr);
+
+    if (sequential) {
+        madvise(ptr, size_, MADV_SEQUENTIAL);
+        madvise(ptr, size_, MADV_WILLNEED);
+    }
+    return true;
+}
+
+void MappedFile::Close() {
+
+    if (data_ != nullptr) {
+        munmap(const_cast<char*>(data_), size_);
+        data_ = nullptr;
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+    size_ = 0;
+}
+
+void MappedFile::Consumed(size_t offset) {
+
+    // Work in large page aligned steps, so this costs nothing per event
+    const size_t STEP = 64 << 20;
+    if (data_ == nullptr || offset < released_ + STEP) {
+        return;
+    }
+    const size_t pagesize = sysconf(_SC_PAGESIZE);
+    const size_t end = offset / pagesize * pagesize;
+    madvise(const_cast<char*>(data_) + released_, end - released_, MADV_DONTNEED);
+    released_ = end;
+}
+
+bool FileExists(const std::string& filename) {
+    struct stat st;
+    return stat(filename.c_str(), &st) == 0;
+}
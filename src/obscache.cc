@@ -0,0 +1,273 @@
+// On-disk cache of the observable columns of a sample
+// ------------------------------------------------------------------------
+
+
+// C++
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Own
+#include "obscache.h"
+
+
+// Observable columns in file order
+static std::vector<double>* Column(ObservablesBlock& obs, int c) {
+    std::vector<double>* columns[N_OBSCOLUMNS] = {
+        &obs.M, &obs.Y, &obs.Pt, &obs.dY, &obs.eta1, &obs.eta2, &obs.phi1, &obs.pt1, &obs.pt2, &obs.deltaphi};
+    return columns[c];
+}
+
+static const std::vector<double>* Column(const ObservablesBlock& obs, int c) {
+    return Column(const_cast<ObservablesBlock&>(obs), c);
+}
+
+// Chunk size in bytes for n events (8 byte aligned)
+static uint64_t ChunkBytes(uint64_t n) {
+    return sizeof(ObsChunkHeader) + (2 * N_OBSCOLUMNS * sizeof(double) * n) + (2 * n + 7) / 8 * 8;
+}
+
+
+// ------------------------------------------------------------------------
+// Key
+
+uint64_t ObsCacheKey(uint64_t inputhash, const Selection& selection) {
+
+    if (inputhash == 0) {
+        return 0;
+    }
+    const uint32_t version = OBSCACHE_VERSION;
+    uint64_t key = HashBytes(reinterpret_cast<const char*>(&version), sizeof(version), inputhash);
+
+    // Mass assignment
+    const int pdg[] = {0, 11, 13, 211, 321, 2212};
+    for (size_t k = 0; k < sizeof(pdg) / sizeof(pdg[0]); ++k) {
+        const double mass = PIDMass(pdg[k]);
+        key = HashBytes(reinterpret_cast<const char*>(&mass), sizeof(mass), key);
+    }
+
+    // Fiducial cuts (the mask is cached)
+    const std::vector<Cut>& cuts = selection.GetCuts();
+    for (size_t k = 0; k < cuts.size(); ++k) {
+        const int32_t code[2] = {cuts[k].variable, cuts[k].op};
+        key = HashBytes(reinterpret_cast<const char*>(code), sizeof(code), key);
+        key = HashBytes(reinterpret_cast<const char*>(&cuts[k].value), sizeof(cuts[k].value), key);
+    }
+
+    return (key != 0) ? key : 1;
+}
+
+
+// ------------------------------------------------------------------------
+// Writer
+
+bool ObsCacheWriter::Open(const std::string& filename, uint64_t key) {
+
+    Abort();
+
+    filename_ = filename;
+    const std::string tmpfile = filename + ".tmp";
+    if ((fp_ = fopen(tmpfile.c_str(), "wb")) == NULL) {
+        printf("ObsCacheWriter:: Cannot open output file: %s \n", tmpfile.c_str());
+        return false;
+    }
+
+    std::memset(&header_, 0, sizeof(ObsCacheHeader));
+    std::memcpy(header_.magic, OBSCACHE_MAGIC, sizeof(OBSCACHE_MAGIC));
+    header_.version = OBSCACHE_VERSION;
+    header_.key     = key;
+
+    // Preliminary header, event and chunk counts are patched at close
+    if (fwrite(&header_, sizeof(ObsCacheHeader), 1, fp_) != 1) {
+        printf("ObsCacheWriter:: Error writing header: %s \n", tmpfile.c_str());
+        Abort();
+        return false;
+    }
+    error_ = false;
+    next_  = 0;
+    pending_.clear();
+
+    return true;
+}
+
+bool ObsCacheWriter::Write(uint64_t first, size_t n, const ObservablesBlock& gen, const ObservablesBlock& rec,
+                           const int* reco, const unsigned char* fiducial) {
+
+    if (fp_ == nullptr || n == 0) {
+        return fp_ != nullptr;
+    }
+
+    // Encode outside the lock
+    std::vector<char> raw(ChunkBytes(n), 0);
+    ObsChunkHeader chead;
+    chead.first   = first;
+    chead.nevents = n;
+    std::memcpy(raw.data(), &chead, sizeof(ObsChunkHeader));
+
+    char* dst = raw.data() + sizeof(ObsChunkHeader);
+    for (int c = 0; c < 2 * N_OBSCOLUMNS; ++c) {
+        const std::vector<double>* src = (c < N_OBSCOLUMNS) ? Column(gen, c) : Column(rec, c - N_OBSCOLUMNS);
+        std::memcpy(dst, src->data(), n * sizeof(double));
+        dst += n * sizeof(double);
+    }
+    for (size_t i = 0; i < n; ++i) {
+        dst[i]     = (reco[i] != 0);
+        dst[n + i] = (fiducial[i] != 0);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (first < next_ || pending_.count(first) > 0) {
+        printf("ObsCacheWriter:: Events from %lu written twice \n", (unsigned long)first);
+        error_ = true;
+        return false;
+    }
+    pending_[first].swap(raw);
+
+    return Flush();
+}
+
+// Write out the pending chunks which continue the file
+bool ObsCacheWriter::Flush() {
+
+    while (!error_ && !pending_.empty() && pending_.begin()->first == next_) {
+        const std::vector<char>& raw = pending_.begin()->second;
+        ObsChunkHeader chead;
+        std::memcpy(&chead, raw.data(), sizeof(ObsChunkHeader));
+
+        if (fwrite(raw.data(), 1, raw.size(), fp_) != raw.size()) {
+            printf("ObsCacheWriter:: Error writing chunk %lu \n", (unsigned long)header_.nchunks);
+            error_ = true;
+            break;
+        }
+        next_ += chead.nevents;
+        header_.nevents += chead.nevents;
+        ++header_.nchunks;
+        pending_.erase(pending_.begin());
+    }
+    return !error_;
+}
+
+bool ObsCacheWriter::Close() {
+
+    if (fp_ == nullptr) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!pending_.empty()) {
+        printf("ObsCacheWriter:: Events missing from %lu \n", (unsigned long)next_);
+        error_ = true;
+    }
+    if (!error_ && (fseek(fp_, 0, SEEK_SET) != 0 || fwrite(&header_, sizeof(ObsCacheHeader), 1, fp_) != 1)) {
+        printf("ObsCacheWriter:: Error finalizing header \n");
+        error_ = true;
+    }
+    const bool closed = (fclose(fp_) == 0);
+    fp_ = nullptr;
+
+    const std::string tmpfile = filename_ + ".tmp";
+    if (error_ || !closed || std::rename(tmpfile.c_str(), filename_.c_str()) != 0) {
+        std::remove(tmpfile.c_str());
+        return false;
+    }
+    return true;
+}
+
+void ObsCacheWriter::Abort() {
+    if (fp_ != nullptr) {
+        fclose(fp_);
+        fp_ = nullptr;
+        std::remove((filename_ + ".tmp").c_str());
+    }
+    pending_.clear();
+}
+
+
+// ------------------------------------------------------------------------
+// Reader
+
+bool ObsCacheReader::Open(const std::string& filename, uint64_t key) {
+
+    Close();
+    chunkoffset_.clear();
+    chunk_    = 0;
+    chunkpos_ = 0;
+    nread_    = 0;
+
+    if (key == 0 || !file_.Open(filename) || file_.Size() < sizeof(ObsCacheHeader)) {
+        Close();
+        return false;
+    }
+    std::memcpy(&header_, file_.Data(), sizeof(ObsCacheHeader));
+    if (std::memcmp(header_.magic, OBSCACHE_MAGIC, sizeof(OBSCACHE_MAGIC)) != 0 ||
+        header_.version != OBSCACHE_VERSION || header_.key != key) {
+        Close();
+        return false;
+    }
+
+    // Chunk index, validated against the file size
+    uint64_t offset = sizeof(ObsCacheHeader);
+    uint64_t nevents = 0;
+    for (uint64_t k = 0; k < header_.nchunks; ++k) {
+        ObsChunkHeader chead;
+        if (offset + sizeof(ObsChunkHeader) > file_.Size()) {
+            break;
+        }
+        std::memcpy(&chead, file_.Data() + offset, sizeof(ObsChunkHeader));
+        if (chead.first != nevents || offset + ChunkBytes(chead.nevents) > file_.Size()) {
+            break;
+        }
+        chunkoffset_.push_back(offset);
+        offset  += ChunkBytes(chead.nevents);
+        nevents += chead.nevents;
+    }
+    if (chunkoffset_.size() != header_.nchunks || nevents != header_.nevents || offset != file_.Size()) {
+        printf("ObsCacheReader:: Truncated or corrupted cache: %s \n", filename.c_str());
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+size_t ObsCacheReader::ReadBlock(size_t maxn, uint64_t& first, ObservablesBlock& gen, ObservablesBlock& rec,
+                                 std::vector<int>& reco, std::vector<unsigned char>& fiducial) {
+
+    gen.Resize(maxn);
+    rec.Resize(maxn);
+    reco.resize(maxn);
+    fiducial.resize(maxn);
+    first = nread_;
+
+    size_t n = 0;
+    while (n < maxn && chunk_ < chunkoffset_.size()) {
+
+        const char* base = file_.Data() + chunkoffset_[chunk_];
+        ObsChunkHeader chead;
+        std::memcpy(&chead, base, sizeof(ObsChunkHeader));
+        const size_t take = std::min<uint64_t>(maxn - n, chead.nevents - chunkpos_);
+
+        const char* src = base + sizeof(ObsChunkHeader);
+        for (int c = 0; c < 2 * N_OBSCOLUMNS; ++c) {
+            std::vector<double>* dst = (c < N_OBSCOLUMNS) ? Column(gen, c) : Column(rec, c - N_OBSCOLUMNS);
+            std::memcpy(dst->data() + n, src + (c * chead.nevents + chunkpos_) * sizeof(double), take * sizeof(double));
+        }
+        const char* flags = src + 2 * N_OBSCOLUMNS * chead.nevents * sizeof(double);
+        for (size_t i = 0; i < take; ++i) {
+            reco[n + i] = flags[chunkpos_ + i];
+        }
+        std::memcpy(fiducial.data() + n, flags + chead.nevents + chunkpos_, take);
+
+        n         += take;
+        chunkpos_ += take;
+        if (chunkpos_ == chead.nevents) {
+            ++chunk_;
+            chunkpos_ = 0;
+            file_.Consumed(chunk_ < chunkoffset_.size() ? chunkoffset_[chunk_] : file_.Size());
+        }
+    }
+    nread_ += n;
+
+    return n;
+}
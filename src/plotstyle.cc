@@ -0,0 +1,82 @@
+// Global ROOT plot style and single histogram figures
+// ------------------------------------------------------------------------
+
+
+// C++
+#include <string>
+
+// ROOT
+#include "TCanvas.h"
+#include "TColor.h"
+#include "TH1.h"
+#include "TStyle.h"
+
+// Own
+#include "plotstyle.h"
+
+
+// Global Style Setup
+void SetROOTStyle() {
+
+  gStyle->SetOptStat(0); // Statistics BOX OFF with argument 0
+  gStyle->SetTitleSize(0.0475,"t"); // Title with "t" (or anything else than xyz)
+  gStyle->SetStatY(1.0);
+  gStyle->SetStatX(1.0);
+  gStyle->SetStatW(0.15);
+  gStyle->SetStatH(0.09);
+}
+
+
+// Set "nice" 2D-plot style
+void SetPlotStyle() {
+
+  // Set Smooth color gradients
+  const Int_t NRGBs = 5;
+  const Int_t NCont = 255;
+
+  Double_t stops[NRGBs] = { 0.00, 0.34, 0.61, 0.84, 1.00 };
+  Double_t red[NRGBs]   = { 0.00, 0.00, 0.87, 1.00, 0.51 };
+  Double_t green[NRGBs] = { 0.00, 0.81, 1.00, 0.20, 0.00 };
+  Double_t blue[NRGBs]  = { 0.51, 1.00, 0.12, 0.00, 0.00 };
+  TColor::CreateGradientColorTable(NRGBs, stops, red, green, blue, NCont);
+  gStyle->SetNumberContours(NCont);
+
+  // Black-Red palette
+  gStyle->SetPalette(53); // 53,56 for inverted
+
+  // Number of decimals in text in TH2 plots
+  //gStyle->SetPaintTextFormat("4.2f");
+
+  //gStyle->SetTitleOffset(1.4,"x");  //X-axis title offset from axis
+  //gStyle->SetTitleOffset(1.4,"y");  //X-axis title offset from axis
+  //gStyle->SetTitleSize(0.04,"x");   //X-axis title size
+  //gStyle->SetTitleSize(0.04,"y");
+  //gStyle->SetTitleSize(0.04,"z");
+  //gStyle->SetLabelOffset(0.025);
+
+}
+
+// Plot and save a filled 1D-histogram
+void PlotFilled(TH1D* h1, std::string& name, bool logscale, bool normalize) {
+
+    TCanvas* c = new TCanvas((name + "_c").c_str(),"c", 800, 650);
+    if (logscale) {
+        c->cd()->SetLogy();
+    }
+    if (normalize) { // Make it discrete probability distribution
+        double norm = 1.0/h1->GetEntries();
+        //double norm = 1.0/h1->Integral();
+        h1->Scale(norm);
+    }
+
+    h1->GetYaxis()->SetTitleOffset(1.45);
+    h1->SetFillColor(19);
+    h1->SetLineWidth(1.5);
+    h1->SetMarkerStyle(20);
+    h1->SetMarkerSize(0.5);
+    h1->SetStats(0);
+    h1->Draw(); // "ep"
+    c->SaveAs( ("./figs/" + name + ".pdf").c_str() );
+
+    delete c;
+}
@@ -0,0 +1,110 @@
+// Stage timing and throughput counters
+// ------------------------------------------------------------------------
+
+
+// C++
+#include <cstdio>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// POSIX
+#include <unistd.h>
+
+// Own
+#include "profiler.h"
+
+
+// Registry (constructed on first use, independent of the static init order)
+static std::vector<ProfileStage*>& Stages() {
+    static std::vector<ProfileStage*> stages;
+    return stages;
+}
+
+static std::mutex& StagesMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+ProfileStage::ProfileStage(const std::string& name) : name_(name) {
+    std::lock_guard<std::mutex> lock(StagesMutex());
+    Stages().push_back(this);
+}
+
+const std::vector<ProfileStage*>& GetProfileStages() {
+    return Stages();
+}
+
+void PrintProfile(const std::string& title, long wallns) {
+
+    const double wall = wallns * 1e-9;
+    const double MB   = 1024.0 * 1024.0;
+
+    printf("Profile:: %s (wall time %0.3f s) \n", title.c_str(), wall);
+    printf("  %-16s %9s %10s %7s %10s %12s %12s %10s %10s \n",
+           "stage", "calls", "busy (s)", "wall%", "wait (s)", "events", "Mevents/s", "MB", "MB/s");
+
+    const std::vector<ProfileStage*>& stages = GetProfileStages();
+    for (size_t i = 0; i < stages.size(); ++i) {
+        const ProfileStage& s = *stages[i];
+        if (s.ncalls == 0 && s.nevents == 0 && s.nbytes == 0) {
+            continue; // Not used in this run
+        }
+        const double busy  = s.busy * 1e-9;
+        const double erate = (busy > 0) ? s.nevents / busy / 1e6 : 0.0;
+        const double brate = (busy > 0) ? s.nbytes / MB / busy : 0.0;
+
+        printf("  %-16s %9ld %10.3f %6.1f%% %10.3f %12ld %12.2f %10.1f %10.1f \n",
+               s.name_.c_str(), s.ncalls.load(), busy, (wall > 0) ? 100.0 * busy / wall : 0.0,
+               s.wait * 1e-9, s.nevents.load(), erate, s.nbytes / MB, brate);
+    }
+}
+
+bool WriteProfileJSON(const std::string& filename, const std::string& title, long wallns) {
+
+    FILE* fp = fopen(filename.c_str(), "w");
+    if (fp == NULL) {
+        printf("Profile:: Cannot open output file: %s \n", filename.c_str());
+        return false;
+    }
+
+    char host[256] = "unknown";
+    gethostname(host, sizeof(host) - 1);
+    char stamp[64];
+    const std::time_t now = std::time(nullptr);
+    std::strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"program\": \"%s\",\n", title.c_str());
+    fprintf(fp, "  \"host\": \"%s\",\n", host);
+    fprintf(fp, "  \"time\": \"%s\",\n", stamp);
+    fprintf(fp, "  \"hardware_threads\": %u,\n", std::thread::hardware_concurrency());
+    fprintf(fp, "  \"wall_s\": %0.6f,\n", wallns * 1e-9);
+    fprintf(fp, "  \"stages\": [");
+
+    const std::vector<ProfileStage*>& stages = GetProfileStages();
+    bool first = true;
+    for (size_t i = 0; i < stages.size(); ++i) {
+        const ProfileStage& s = *stages[i];
+        if (s.ncalls == 0 && s.nevents == 0 && s.nbytes == 0) {
+            continue;
+        }
+        const double busy = s.busy * 1e-9;
+        fprintf(fp, "%s\n    {\"name\": \"%s\", \"calls\": %ld, \"busy_s\": %0.6f, \"wait_s\": %0.6f, \"events\": %ld, "
+                "\"bytes\": %ld, \"events_per_s\": %0.1f, \"bytes_per_s\": %0.1f}",
+                first ? "" : ",", s.name_.c_str(), s.ncalls.load(), busy, s.wait * 1e-9, s.nevents.load(), s.nbytes.load(),
+                (busy > 0) ? s.nevents / busy : 0.0, (busy > 0) ? s.nbytes / busy : 0.0);
+        first = false;
+    }
+    fprintf(fp, "\n  ]\n}\n");
+
+    if (fclose(fp) != 0) {
+        printf("Profile:: Error writing: %s \n", filename.c_str());
+        return false;
+    }
+    printf("Profile:: Report written to: %s \n", filename.c_str());
+
+    return true;
+}
@@ -0,0 +1,98 @@
+// Deferred figure rendering in parallel worker processes
+// ------------------------------------------------------------------------
+
+
+// C++
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <vector>
+
+// POSIX
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Own
+#include "render.h"
+
+
+void RenderQueue::Push(const std::function<void()>& job) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.push_back(job);
+}
+
+bool RenderQueue::Run(int nproc) {
+
+    std::vector<std::function<void()>> jobs;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs.swap(jobs_);
+    }
+    nproc = std::max(1, std::min<int>(nproc, jobs.size()));
+
+    // Serial mode
+    if (nproc <= 1) {
+        for (size_t i = 0; i < jobs.size(); ++i) {
+            jobs[i]();
+        }
+        return true;
+    }
+
+    // Next job index, shared by the worker processes
+    void* shared = mmap(nullptr, sizeof(std::atomic<size_t>), PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        printf("RenderQueue:: Cannot map shared memory, rendering serially \n");
+        for (size_t i = 0; i < jobs.size(); ++i) {
+            jobs[i]();
+        }
+        return true;
+    }
+    std::atomic<size_t>* next = new (shared) std::atomic<size_t>(0);
+
+    // Buffered output would be duplicated in the children
+    fflush(stdout);
+    fflush(stderr);
+
+    std::vector<pid_t> workers;
+    for (int w = 0; w < nproc; ++w) {
+        const pid_t pid = fork();
+        if (pid == 0) {
+            size_t i;
+            while ((i = (*next)++) < jobs.size()) {
+                jobs[i]();
+            }
+            fflush(stdout);
+            _exit(0); // No ROOT teardown in the children
+        }
+        if (pid < 0) {
+            printf("RenderQueue:: fork() failed, continuing with %d workers \n", w);
+            break;
+        }
+        workers.push_back(pid);
+    }
+
+    // Jobs left over if no worker could be started
+    size_t i;
+    if (workers.empty()) {
+        while ((i = (*next)++) < jobs.size()) {
+            jobs[i]();
+        }
+    }
+
+    bool ok = true;
+    for (size_t w = 0; w < workers.size(); ++w) {
+        int status = 0;
+        if (waitpid(workers[w], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            printf("RenderQueue:: Worker process %d failed \n", (int)workers[w]);
+            ok = false;
+        }
+    }
+    munmap(shared, sizeof(std::atomic<size_t>));
+
+    return ok;
+}
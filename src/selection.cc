@@ -0,0 +1,203 @@
+// Track pair selection (fiducial phase space) from a cut file
+// ------------------------------------------------------------------------
+
+
+// C++
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Own
+#include "selection.h"
+
+
+static const char* VARIABLE_NAMES[] = {"px", "py", "pz", "pt", "p", "eta", "abseta"};
+static const char* OPERATOR_NAMES[] = {"<", "<=", ">", ">="};
+
+
+bool Selection::LoadDefault() {
+
+    std::ifstream file(SELECTION_FILE);
+    if (!file.is_open()) {
+        printf("Selection:: No cut file %s, using the default cuts \n", SELECTION_FILE);
+        return Parse(SELECTION_DEFAULT, "default");
+    }
+    return Load(SELECTION_FILE);
+}
+
+bool Selection::Load(const std::string& filename) {
+
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        printf("Selection:: Cannot open cut file: %s \n", filename.c_str());
+        return false;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+
+    return Parse(text.str(), filename);
+}
+
+bool Selection::Parse(const std::string& text, const std::string& source) {
+
+    cuts_.clear();
+    compiled_.clear();
+    source_ = source;
+
+    std::istringstream lines(text);
+    std::string line;
+    int lineno = 0;
+
+    while (std::getline(lines, line)) {
+        ++lineno;
+
+        // Comments and empty lines
+        const size_t hash = line.find('#');
+        if (hash != std::string::npos) {
+            line = line.substr(0, hash);
+        }
+        std::istringstream tokens(line);
+        std::string var;
+        std::string op;
+        std::string value;
+        if (!(tokens >> var)) {
+            continue;
+        }
+        std::string extra;
+        if (!(tokens >> op >> value) || (tokens >> extra)) {
+            printf("Selection:: %s line %d: expected <variable> <operator> <value> \n", source.c_str(), lineno);
+            return false;
+        }
+        if (var == "|eta|") {
+            var = "abseta";
+        }
+
+        Cut cut;
+        int v = 0;
+        for (; v <= CUT_ABSETA && var != VARIABLE_NAMES[v]; ++v) {}
+        if (v > CUT_ABSETA) {
+            printf("Selection:: %s line %d: unknown variable '%s' \n", source.c_str(), lineno, var.c_str());
+            return false;
+        }
+        int o = 0;
+        for (; o <= CUT_GE && op != OPERATOR_NAMES[o]; ++o) {}
+        if (o > CUT_GE) {
+            printf("Selection:: %s line %d: unknown operator '%s' \n", source.c_str(), lineno, op.c_str());
+            return false;
+        }
+        char* end = nullptr;
+        cut.value = std::strtod(value.c_str(), &end);
+        if (end == value.c_str() || *end != '\0' || !std::isfinite(cut.value)) {
+            printf("Selection:: %s line %d: bad value '%s' \n", source.c_str(), lineno, value.c_str());
+            return false;
+        }
+        cut.variable = static_cast<CutVariable>(v);
+        cut.op       = static_cast<CutOperator>(o);
+        cuts_.push_back(cut);
+    }
+    Compile();
+
+    return true;
+}
+
+// Lower cuts to sqrt free tests and order them by cost
+void Selection::Compile() {
+
+    compiled_.clear();
+
+    for (size_t k = 0; k < cuts_.size(); ++k) {
+        const Cut& cut = cuts_[k];
+        const bool less = (cut.op == CUT_LT || cut.op == CUT_LE);
+        const double c  = cut.value;
+
+        CompiledCut cc;
+        cc.op = cut.op;
+
+        switch (cut.variable) {
+            case CUT_PX:
+            case CUT_PY:
+            case CUT_PZ:
+                cc.form = CompiledCut::LINEAR;
+                cc.comp = cut.variable - CUT_PX;
+                cc.c    = c;
+                cc.cost = 1;
+                break;
+
+            case CUT_PT:
+            case CUT_P:
+            case CUT_ABSETA: {
+                // Non-negative variable against a negative (or zero) value
+                if (c < 0 || (c == 0 && cut.op == CUT_LT)) {
+                    if (!less) {
+                        continue; // Always passes
+                    }
+                    cc.form = CompiledCut::NEVER;
+                    cc.cost = 0;
+                    break;
+                }
+                cc.form = CompiledCut::QUAD;
+                if (cut.variable == CUT_ABSETA) {
+                    // |eta| op c <=> pz^2 - sinh^2(c) pt^2 op 0
+                    const double s = std::sinh(c);
+                    cc.a    = -s * s;
+                    cc.b    = 1.0;
+                    cc.c    = 0.0;
+                    cc.cost = 3;
+                } else {
+                    cc.a    = 1.0;
+                    cc.b    = (cut.variable == CUT_P) ? 1.0 : 0.0;
+                    cc.c    = c * c;
+                    cc.cost = (cut.variable == CUT_P) ? 3 : 2;
+                }
+                break;
+            }
+
+            default: // CUT_ETA
+                cc.form = CompiledCut::ETA;
+                cc.s    = std::sinh(c);
+                cc.a    = cc.s * cc.s;
+                cc.cost = 4;
+                break;
+        }
+        compiled_.push_back(cc);
+    }
+
+    std::stable_sort(compiled_.begin(), compiled_.end(),
+        [](const CompiledCut& x, const CompiledCut& y) { return x.cost < y.cost; });
+}
+
+size_t Selection::Select(const EventBlock& block, unsigned char* mask, int first) const {
+
+    const double* px1 = block.mom[first].data();
+    const double* py1 = block.mom[first + 1].data();
+    const double* pz1 = block.mom[first + 2].data();
+    const double* px2 = block.mom[first + 3].data();
+    const double* py2 = block.mom[first + 4].data();
+    const double* pz2 = block.mom[first + 5].data();
+
+    size_t m = 0;
+    for (size_t i = 0; i < block.n; ++i) {
+        const double t1[3] = {px1[i], py1[i], pz1[i]};
+        const double t2[3] = {px2[i], py2[i], pz2[i]};
+        mask[i] = Pass(t1, t2);
+        m += mask[i];
+    }
+    return m;
+}
+
+void Selection::Print() const {
+    std::string expr;
+    for (size_t k = 0; k < cuts_.size(); ++k) {
+        char buff[128];
+        snprintf(buff, sizeof(buff), "%s%s %s %g", (k > 0) ? " && " : "",
+                 VARIABLE_NAMES[cuts_[k].variable], OPERATOR_NAMES[cuts_[k].op], cuts_[k].value);
+        expr += buff;
+    }
+    printf("Selection:: %s: %s (both tracks, %lu compiled tests) \n",
+           source_.c_str(), expr.empty() ? "no cuts" : expr.c_str(), (unsigned long)compiled_.size());
+}
@@ -0,0 +1,268 @@
+// Monte Carlo tree2track (.root) input with branch pruning and bulk basket reads
+// ------------------------------------------------------------------------
+
+
+// C++
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// ROOT
+#include "Bytes.h"
+#include "TBranch.h"
+#include "TBufferFile.h"
+#include "TFile.h"
+#include "TMath.h"
+#include "TObjArray.h"
+#include "TTree.h"
+#include "ROOT/TBulkBranchRead.hxx"
+
+// Own
+#include "treeinput.h"
+
+
+const char* TREE_BRANCHNAMES[N_TREEBRANCHES] = {
+    "pxMc1", "pyMc1", "pzMc1",
+    "pxMc2", "pyMc2", "pzMc2",
+    "px1",   "py1",   "pz1",
+    "px2",   "py2",   "pz2",
+    "pidCode1", "pidCode2"
+};
+
+// Bulk read buffer initial size (grows to the basket size)
+const Int_t BULK_BUFSIZE = 32 * 1024;
+
+
+void TreeReadStats::Add(const TreeReadStats& other) {
+    bulk          = (nactive == 0) ? other.bulk : (bulk && other.bulk);
+    nbranches     = std::max(nbranches, other.nbranches);
+    nactive       = std::max(nactive, other.nactive);
+    nentries     += other.nentries;
+    totbytes_all += other.totbytes_all;
+    zipbytes_all += other.zipbytes_all;
+    totbytes     += other.totbytes;
+    zipbytes     += other.zipbytes;
+    bytesread    += other.bytesread;
+}
+
+void TreeReadStats::Print(const std::string& title) const {
+    const double MB = 1024.0 * 1024.0;
+    printf("%s:: Branches read %d / %d (%s), decompressed %0.1f MB -> %0.1f MB, "
+           "compressed %0.1f MB -> %0.1f MB, read from file %0.1f MB \n",
+           title.c_str(), nactive, nbranches, bulk ? "bulk" : "GetEntry",
+           totbytes_all / MB, totbytes / MB, zipbytes_all / MB, zipbytes / MB, bytesread / MB);
+}
+
+
+bool TreeInput::Open(const std::string& filename, Long64_t first, Long64_t last, bool bulk) {
+
+    Close();
+    error_    = false;
+    filename_ = filename;
+
+    file_ = TFile::Open(filename.c_str());
+    if (file_ == nullptr || file_->IsZombie()) {
+        printf("TreeInput:: Error opening input file: %s \n", filename.c_str());
+        delete file_;
+        file_ = nullptr;
+        return false;
+    }
+    tree_ = (TTree*) file_->Get("tree2track");
+    if (tree_ == nullptr) {
+        printf("TreeInput:: No tree2track in: %s \n", filename.c_str());
+        Close();
+        return false;
+    }
+
+    nentries_ = tree_->GetEntries();
+    first_    = std::min(std::max<Long64_t>(first, 0), nentries_);
+    last_     = (last < 0) ? nentries_ : std::min(last, nentries_);
+    last_     = std::max(first_, last_);
+    next_     = first_;
+
+    // Only the event store branches are active
+    tree_->SetBranchStatus("*", 0);
+    for (int j = 0; j < N_TREEBRANCHES; ++j) {
+        Column& column = columns_[j];
+        column.branch  = tree_->GetBranch(TREE_BRANCHNAMES[j]);
+        if (column.branch == nullptr) {
+            printf("TreeInput:: No branch '%s' in: %s \n", TREE_BRANCHNAMES[j], filename.c_str());
+            Close();
+            return false;
+        }
+        tree_->SetBranchStatus(TREE_BRANCHNAMES[j], 1);
+        tree_->AddBranchToCache(TREE_BRANCHNAMES[j], true);
+
+        column.buffer.reset(new TBufferFile(TBuffer::kWrite, BULK_BUFSIZE));
+        column.basketfirst = 0;
+        column.basketn     = 0;
+        column.data        = nullptr;
+    }
+
+    // Bulk reads need flat fixed size branches, probe the first basket of each
+    bulk_ = bulk;
+    for (int j = 0; j < N_TREEBRANCHES && bulk_ && first_ < last_; ++j) {
+        bulk_ = LoadBasket(columns_[j], first_);
+    }
+    if (bulk && !bulk_) {
+        printf("TreeInput:: Bulk reads not supported by %s, using TTree::GetEntry \n", filename.c_str());
+    }
+    if (!bulk_) {
+        for (int j = 0; j < N_TREEBRANCHES; ++j) {
+            if (j < NKIN) {
+                tree_->SetBranchAddress(TREE_BRANCHNAMES[j], &columns_[j].value.f);
+            } else {
+                tree_->SetBranchAddress(TREE_BRANCHNAMES[j], &columns_[j].value.i);
+            }
+        }
+    }
+
+    // Size accounting over the entry range (from the branch totals)
+    stats_ = TreeReadStats();
+    stats_.bulk     = bulk_;
+    stats_.nactive  = N_TREEBRANCHES;
+    stats_.nentries = last_ - first_;
+    const double frac = (nentries_ > 0) ? (last_ - first_) / (double) nentries_ : 0.0;
+
+    TObjArray* branches = tree_->GetListOfBranches();
+    stats_.nbranches = branches->GetEntries();
+    for (int b = 0; b < stats_.nbranches; ++b) {
+        const TBranch* branch = (const TBranch*) branches->At(b);
+        stats_.totbytes_all += branch->GetTotBytes("*") * frac;
+        stats_.zipbytes_all += branch->GetZipBytes("*") * frac;
+    }
+    for (int j = 0; j < N_TREEBRANCHES; ++j) {
+        stats_.totbytes += columns_[j].branch->GetTotBytes("*") * frac;
+        stats_.zipbytes += columns_[j].branch->GetZipBytes("*") * frac;
+    }
+
+    return true;
+}
+
+void TreeInput::Close() {
+    if (file_ != nullptr) {
+        stats_.bytesread = file_->GetBytesRead();
+    }
+    delete file_; // Owns the tree
+    file_ = nullptr;
+    tree_ = nullptr;
+    for (int j = 0; j < N_TREEBRANCHES; ++j) {
+        columns_[j].branch = nullptr;
+        columns_[j].buffer.reset();
+        columns_[j].data   = nullptr;
+    }
+}
+
+TreeReadStats TreeInput::GetStats() const {
+    TreeReadStats stats = stats_;
+    if (file_ != nullptr) {
+        stats.bytesread = file_->GetBytesRead();
+    }
+    return stats;
+}
+
+// Decompress the basket containing entry into the column buffer
+bool TreeInput::LoadBasket(Column& column, Long64_t entry) {
+
+    // Bulk reads start from the basket boundary
+    const Long64_t* basketentry = column.branch->GetBasketEntry();
+    const Int_t ibasket = TMath::BinarySearch(column.branch->GetWriteBasket() + 1, basketentry, entry);
+    if (ibasket < 0) {
+        return false;
+    }
+    const Long64_t first = basketentry[ibasket];
+    const Int_t n = column.branch->GetBulkRead().GetEntriesSerialized(first, *column.buffer);
+    if (n <= 0 || entry >= first + n) {
+        return false;
+    }
+    column.basketfirst = first;
+    column.basketn     = n;
+    column.data        = column.buffer->GetCurrent();
+
+    return true;
+}
+
+// Entries [entry, entry + n) of one column, basket by basket
+template <typename T>
+bool TreeInput::ReadColumn(Column& column, Long64_t entry, size_t n, T* dst) {
+
+    size_t k = 0;
+    while (k < n) {
+        if (entry < column.basketfirst || entry >= column.basketfirst + column.basketn) {
+            if (!LoadBasket(column, entry)) {
+                return false;
+            }
+        }
+        const size_t take = std::min<Long64_t>(n - k, column.basketfirst + column.basketn - entry);
+
+        // Serialized in big endian
+        char* src = column.data + (entry - column.basketfirst) * sizeof(T);
+        for (size_t r = 0; r < take; ++r) {
+            frombuf(src, dst + k + r);
+        }
+        k     += take;
+        entry += take;
+    }
+    return true;
+}
+
+size_t TreeInput::ReadBlock(EventBlock& block, size_t maxn) {
+
+    if (tree_ == nullptr || error_) {
+        block.n = 0;
+        return 0;
+    }
+    const size_t n = std::min<Long64_t>(maxn, last_ - next_);
+
+    block.Resize(maxn);
+    block.first = next_ - first_;
+
+    for (int j = 0; j < NKIN; ++j) {
+        mom_[j].resize(n);
+    }
+    pidCode_[0].resize(n);
+    pidCode_[1].resize(n);
+
+    bool ok = true;
+    if (bulk_) {
+        for (int j = 0; j < N_TREEBRANCHES && ok; ++j) {
+            if (j < NKIN) {
+                ok = ReadColumn(columns_[j], next_, n, mom_[j].data());
+            } else {
+                ok = ReadColumn(columns_[j], next_, n, pidCode_[j - PIDCODE1].data());
+            }
+        }
+    } else {
+        for (size_t i = 0; i < n && ok; ++i) {
+            ok = tree_->GetEntry(next_ + i) > 0;
+            for (int j = 0; j < NKIN; ++j) {
+                mom_[j][i] = columns_[j].value.f;
+            }
+            pidCode_[0][i] = columns_[PIDCODE1].value.i;
+            pidCode_[1][i] = columns_[PIDCODE2].value.i;
+        }
+    }
+    if (!ok) {
+        printf("TreeInput:: Error reading entries [%lld, %lld) of: %s \n",
+               next_, next_ + (Long64_t) n, filename_.c_str());
+        error_  = true;
+        block.n = 0;
+        return 0;
+    }
+
+    // To the event block, reconstructed if both tracks are
+    for (int j = 0; j < NKIN; ++j) {
+        std::copy(mom_[j].begin(), mom_[j].end(), block.mom[j].begin());
+    }
+    std::copy(pidCode_[0].begin(), pidCode_[0].end(), block.pidCode[0].begin());
+    std::copy(pidCode_[1].begin(), pidCode_[1].end(), block.pidCode[1].begin());
+    for (size_t i = 0; i < n; ++i) {
+        block.reco[i] = (mom_[PX1_REC][i] > -999 && mom_[PX2_REC][i] > -999) ? 1 : 0;
+    }
+
+    block.n = n;
+    next_  += n;
+
+    return n;
+}
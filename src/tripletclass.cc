@@ -5,7 +5,9 @@
 
 
 // C++
+#include <algorithm>
 #include <string>
+#include <vector>
 
 // ROOT
 #include "TH1.h"
@@ -18,7 +20,8 @@
 
 
 h1Triplet::h1Triplet(const std::string& name, const std::string& labeltext,
-                     int N, double minval, double maxval, const std::string& legendposition) {
+                     int N, double minval, double maxval, const std::string& legendposition,
+                     HistBackend backend) {
     name_ = name;
     N_ = N;
     minval_ = minval;
@@ -33,25 +36,232 @@ h1Triplet::h1Triplet(const std::string& name, const std::string& labeltext,
         hCorr->Sumw2();
     
     h2ObsWeight = new TH2D(("h2" + name).c_str(), labeltext.c_str(), N, minval, maxval, N, 0, 1.0);
+
+    axis_ = FastAxis(N, minval, maxval);
+    native_ = (backend == BACKEND_NATIVE);
+    if (native_) {
+        fTrue.Init(N, minval, maxval);
+        fReco.Init(N, minval, maxval);
+        fCorr.Init(N, minval, maxval);
+        f2ObsWeight.Init(N, minval, maxval, N, 0, 1.0);
+    }
 }
 
-double h1Triplet::SaveFig() {
-    
+// Line colors and markers of the corrected histograms of each model
+const int MODELCOLOR[]  = {59, 62, 8, 95, 6, 28};
+const int MODELMARKER[] = {21, 22, 23, 33, 34, 29};
+const size_t NMODELSTYLE = sizeof(MODELCOLOR) / sizeof(MODELCOLOR[0]);
+
+// Bootstrap replicas to a (cell, replica) histogram and back
+static void BootToROOT(const BootstrapHist& b, TH2D* h) {
+    for (int c = 0; c < b.GetNCells(); ++c) {
+        for (int r = 0; r < b.GetNReplicas(); ++r) {
+            h->SetBinContent(c + 1, r + 1, b.Get(c, r));
+        }
+    }
+}
+
+static void BootFromROOT(const TH2D* h, BootstrapHist& b) {
+    for (int c = 0; c < b.GetNCells(); ++c) {
+        for (int r = 0; r < b.GetNReplicas(); ++r) {
+            b.Set(c, r, h->GetBinContent(c + 1, r + 1));
+        }
+    }
+}
+
+// Replica histogram of ncells x R
+static TH2D* NewBootHist(const std::string& name, int ncells, int R) {
+    return new TH2D(name.c_str(), ";cell;replica", ncells, -0.5, ncells - 0.5, R, -0.5, R - 0.5);
+}
+
+void h1Triplet::EnableBootstrap(int R, uint64_t seed) {
+    if (R <= 0 || bCorr.Enabled()) {
+        return;
+    }
+    bReco.Init(N_ + 2, R, seed);
+    bCorr.Init(N_ + 2, R, seed);
+    hRecoBoot = NewBootHist(name_ + "RecoBoot", N_ + 2, R);
+    hCorrBoot = NewBootHist(name_ + "CorrBoot", N_ + 2, R);
+}
+
+void h1Triplet::SetModels(const std::vector<std::string>& labels) {
+    if (labels.size() < 2 || !hCorrModel.empty()) {
+        return;
+    }
+    models_ = labels;
+    for (size_t k = 1; k < labels.size(); ++k) {
+        TH1D* h = (TH1D*)hCorr->Clone((name_ + "Corr_" + labels[k]).c_str());
+        h->Reset();
+        hCorrModel.push_back(h);
+        if (native_) {
+            fCorrModel.push_back(FastHist1D(N_, minval_, maxval_));
+        }
+    }
+}
+
+void h1Triplet::Sync() {
+    if (native_) {
+        fTrue.ToROOT(hTrue);
+        fReco.ToROOT(hReco);
+        fCorr.ToROOT(hCorr);
+        f2ObsWeight.ToROOT(h2ObsWeight);
+        for (size_t k = 0; k < fCorrModel.size(); ++k) {
+            fCorrModel[k].ToROOT(hCorrModel[k]);
+        }
+    }
+    if (bCorr.Enabled()) {
+        BootToROOT(bReco, hRecoBoot);
+        BootToROOT(bCorr, hCorrBoot);
+    }
+}
+
+void h1Triplet::LoadBootstrap() {
+    if (bCorr.Enabled()) {
+        BootFromROOT(hRecoBoot, bReco);
+        BootFromROOT(hCorrBoot, bCorr);
+    }
+}
+
+// Events per inner block of the batched fills (bin indices on the stack)
+const size_t FILLSTRIDE = 256;
+
+void h1Triplet::FillBatch(size_t n, const double* x_gen, const double* x_rec,
+                          const unsigned char* reco, const double* weight,
+                          const double* poisson) {
+
+    // Bootstrap replicas of reconstructed and corrected (Poisson weight rows)
+    const bool boot  = (poisson != nullptr && bCorr.Enabled());
+    const int stride = BootstrapStride(bCorr.GetNReplicas());
+
+    if (!native_) {
+        for (size_t i = 0; i < n; ++i) {
+            Fill(reco[i], x_gen[i], x_rec[i], weight[i]);
+        }
+        for (size_t i = 0; boot && i < n; ++i) {
+            if (reco[i]) {
+                const int bin = axis_.FindBin(x_rec[i]);
+                bReco.Fill(bin, poisson + i * stride, 1.0);
+                bCorr.Fill(bin, poisson + i * stride, weight[i]);
+            }
+        }
+        return;
+    }
+
+    int bin_gen[FILLSTRIDE];
+    int bin_rec[FILLSTRIDE];
+    int bin_w[FILLSTRIDE];
+    double invweight[FILLSTRIDE];
+
+    for (size_t i0 = 0; i0 < n; i0 += FILLSTRIDE) {
+        const size_t m = std::min(FILLSTRIDE, n - i0);
+        const double* xg = x_gen + i0;
+        const double* xr = x_rec + i0;
+        const double* w  = weight + i0;
+        const unsigned char* r = reco + i0;
+
+        // Vectorized bin lookup (control plot x-axis is the same as the triplet axis)
+        for (size_t j = 0; j < m; ++j) {
+            invweight[j] = 1.0 / w[j]; // Note 1/weight
+        }
+        fTrue.GetAxis().FindBins(m, xg, bin_gen);
+        fReco.GetAxis().FindBins(m, xr, bin_rec);
+        f2ObsWeight.GetYaxis().FindBins(m, invweight, bin_w);
+
+        // Accumulate in event order
+        for (size_t j = 0; j < m; ++j) {
+            fTrue.FillBin(bin_gen[j], xg[j], 1.0);
+            if (r[j]) {
+                fReco.FillBin(bin_rec[j], xr[j], 1.0);
+                fCorr.FillBin(bin_rec[j], xr[j], w[j]);
+                f2ObsWeight.FillBin(bin_rec[j], bin_w[j], xr[j], invweight[j], 1.0);
+                if (boot) {
+                    const double* p = poisson + (i0 + j) * stride;
+                    bReco.Fill(bin_rec[j], p, 1.0);
+                    bCorr.Fill(bin_rec[j], p, w[j]);
+                }
+            }
+        }
+    }
+}
+
+void h1Triplet::FillCorr(size_t k, size_t n, const double* x_rec, const unsigned char* reco,
+                         const double* weight) {
+
+    if (!native_) {
+        TH1D* h = hCorrModel[k - 1];
+        for (size_t i = 0; i < n; ++i) {
+            if (reco[i]) {
+                h->Fill(x_rec[i], weight[i]);
+            }
+        }
+        return;
+    }
+
+    FastHist1D& f = fCorrModel[k - 1];
+    int bin_rec[FILLSTRIDE];
+
+    for (size_t i0 = 0; i0 < n; i0 += FILLSTRIDE) {
+        const size_t m = std::min(FILLSTRIDE, n - i0);
+        f.GetAxis().FindBins(m, x_rec + i0, bin_rec);
+        for (size_t j = 0; j < m; ++j) {
+            if (reco[i0 + j]) {
+                f.FillBin(bin_rec[j], x_rec[i0 + j], weight[i0 + j]);
+            }
+        }
+    }
+}
+
+double h1Triplet::Chi2() {
+
+    Sync();
+
     // ----------------------------------------------------
     // Apply the chi2 test and retrieve the residuals
     printf("***********************************************************\n");
     double res[N_] = {0.0};
     printf("%s:: \n", name_.c_str());
-    double chi2ndf = hTrue->Chi2Test(hCorr,"WW P CHI2/NDF", res);
-    
-    printf("chi2/ndf = %0.3f \n\n", chi2ndf);
+    chi2ndfs_.assign(GetNModels(), 0.0);
+    for (size_t k = 0; k < GetNModels(); ++k) {
+        chi2ndfs_[k] = hTrue->Chi2Test(GetCorr(k),"WW P CHI2/NDF", res);
+        if (models_.empty()) {
+            printf("chi2/ndf = %0.3f \n\n", chi2ndfs_[k]);
+        } else {
+            printf("chi2/ndf = %0.3f (%s) \n\n", chi2ndfs_[k], models_[k].c_str());
+        }
+    }
+    chi2ndf_ = chi2ndfs_[0];
+
+    // Bootstrap uncertainty relative to the corrected contents
+    if (bCorr.Enabled()) {
+        std::vector<double> err;
+        bCorr.GetError(err);
+        double relsum = 0.0;
+        int nbins = 0;
+        for (int i = 1; i <= N_; ++i) {
+            if (hCorr->GetBinContent(i) > 0) {
+                relsum += err[i] / hCorr->GetBinContent(i);
+                ++nbins;
+            }
+        }
+        printf("bootstrap: <sigma / corrected> = %0.4f (%d replicas) \n\n",
+               (nbins > 0) ? relsum / nbins : 0.0, bCorr.GetNReplicas());
+    }
     printf("***********************************************************\n");
     // ---------------------------------------------------
 
-    TCanvas c0("c", "c", 750, 800);
+    return chi2ndf_;
+}
+
+void h1Triplet::SaveFig() {
+
+    if (chi2ndf_ < 0 || chi2ndfs_.size() != GetNModels()) {
+        Chi2();
+    }
+
+    TCanvas c0((name_ + "_c").c_str(), "c", 750, 800);
     
     // Upper plot will be in pad1
-    TPad* pad1 = new TPad("pad1", "pad1", 0, 0.3, 1, 1.0);
+    TPad* pad1 = new TPad((name_ + "_pad1").c_str(), "pad1", 0, 0.3, 1, 1.0);
     pad1->SetBottomMargin(0.015); // Upper and lower plot are joined
     //pad1->SetGridx();           // Vertical grid
     pad1->Draw();                 // Draw the upper pad: pad1
@@ -70,11 +280,29 @@ double h1Triplet::SaveFig() {
     hReco->SetMarkerSize(0.5);
     hReco->Draw("same");
 
-    hCorr->SetLineColor(59);
-    hCorr->SetMarkerColor(59);
-    hCorr->SetMarkerStyle(21);
-    hCorr->SetMarkerSize(0.5);
-    hCorr->Draw("same");
+    for (size_t k = 0; k < GetNModels(); ++k) {
+        TH1D* h = GetCorr(k);
+        h->SetLineColor(MODELCOLOR[k % NMODELSTYLE]);
+        h->SetMarkerColor(MODELCOLOR[k % NMODELSTYLE]);
+        h->SetMarkerStyle(MODELMARKER[k % NMODELSTYLE]);
+        h->SetMarkerSize(0.5);
+        h->Draw("same");
+    }
+
+    // Bootstrap band of the corrected histogram
+    TH1D* hBand = nullptr;
+    if (bCorr.Enabled()) {
+        std::vector<double> err;
+        bCorr.GetError(err);
+        hBand = (TH1D*)hCorr->Clone((name_ + "_band").c_str());
+        for (int i = 0; i < N_ + 2; ++i) {
+            hBand->SetBinError(i, err[i]);
+        }
+        hBand->SetFillColor(59);
+        hBand->SetFillStyle(3004);
+        hBand->SetMarkerSize(0);
+        hBand->Draw("E2 same");
+    }
     
     // Remove x-axis
     hTrue->GetXaxis()->SetLabelOffset(999);
@@ -113,6 +341,14 @@ double h1Triplet::SaveFig() {
         x1 = 0.60; x2 = 0.87;
         y1 = 0.10; y2 = 0.25;
     }
+
+    // Room for the further models
+    const double extra = 0.05 * (GetNModels() - 1);
+    if (legendposition_.compare("southeast") == 0) {
+        y2 += extra;
+    } else {
+        y1 -= extra;
+    }
     TLegend* legend = new TLegend(x1,y1, x2,y2); // x1,y1,x2,y2
 
 
@@ -121,14 +357,24 @@ double h1Triplet::SaveFig() {
 
     legend->AddEntry(hTrue, "Generated");
     legend->AddEntry(hReco, "Reconstructed");
-    legend->AddEntry(hCorr, Form("DeepEfficiency-6D [#chi^{2}_{/ bin}= %0.1f] ", chi2ndf));
+    for (size_t k = 0; k < GetNModels(); ++k) {
+        if (models_.empty()) {
+            legend->AddEntry(hCorr, Form("DeepEfficiency-6D [#chi^{2}_{/ bin}= %0.1f] ", chi2ndfs_[k]));
+        } else {
+            legend->AddEntry(GetCorr(k), Form("DeepEfficiency-6D %s [#chi^{2}_{/ bin}= %0.1f] ",
+                                              models_[k].c_str(), chi2ndfs_[k]));
+        }
+    }
+    if (hBand != nullptr) {
+        legend->AddEntry(hBand, Form("Bootstrap #pm1#sigma (%d replicas)", bCorr.GetNReplicas()), "F");
+    }
 
     legend->Draw();
 
     // ==============================================================
     // Ratio plots
     c0.cd();
-    TPad* pad2 = new TPad("pad2", "pad2", 0, 0.05, 1, 0.3);
+    TPad* pad2 = new TPad((name_ + "_pad2").c_str(), "pad2", 0, 0.05, 1, 0.3);
     pad2->SetTopMargin(0.025);
     pad2->SetBottomMargin(0.25);
     pad2->SetGridx(); // vertical grid
@@ -136,7 +382,7 @@ double h1Triplet::SaveFig() {
     pad2->cd();       // pad2 becomes the current pad
 
     // *** Reconstructed histogram ***
-    TH1D* h3 = (TH1D*)hReco->Clone("h3");
+    TH1D* h3 = (TH1D*)hReco->Clone((name_ + "_h3").c_str());
     h3->Divide(hTrue);
 
     h3->SetMinimum(0.0);  // Define Y ..
@@ -171,10 +417,13 @@ double h1Triplet::SaveFig() {
     line->SetLineWidth(2.0);
     line->Draw();
 
-    // *** Corrected histogram ***
-    TH1D* h4 = (TH1D*)hCorr->Clone("h4");
-    h4->Divide(hTrue);
-    h4->Draw("same");
+    // *** Corrected histograms ***
+    std::vector<TH1D*> h4;
+    for (size_t k = 0; k < GetNModels(); ++k) {
+        h4.push_back((TH1D*)GetCorr(k)->Clone((name_ + "_h4_" + std::to_string(k)).c_str()));
+        h4.back()->Divide(hTrue);
+        h4.back()->Draw("same");
+    }
     
     // Save pdf
     std::string fullfile = "./figs/" + name_ + ".pdf";
@@ -189,10 +438,15 @@ double h1Triplet::SaveFig() {
     delete pad2;
     delete line;
     delete legend;
+    delete h3;
+    for (size_t k = 0; k < h4.size(); ++k) {
+        delete h4[k];
+    }
+    delete hBand;
 
     // -------------------------------------------------------------------
     // Print out 2D-control plot
-    TCanvas c2D("c2D", "c2D", 800, 800);
+    TCanvas c2D((name_ + "_c2D").c_str(), "c2D", 800, 800);
     c2D.cd();
     c2D.SetRightMargin(0.13); // Give space for colorbar
     h2ObsWeight->Draw("COLZ");
@@ -201,14 +455,14 @@ double h1Triplet::SaveFig() {
     h2ObsWeight->GetYaxis()->SetTitle("DeepEfficiency-6D output w");
     fullfile = "./figs/" + name_ + "_vs_weight"+ ".pdf";
     c2D.SaveAs(fullfile.c_str()); 
-
-    return chi2ndf;   
 }
 
 
 h2Triplet::h2Triplet(const std::string& name, const std::string& labeltext,
-            int N1, double minval1, double maxval1, int N2, double minval2, double maxval2) {
+            int N1, double minval1, double maxval1, int N2, double minval2, double maxval2,
+            HistBackend backend) {
     name_ = name;
+    labeltext_ = labeltext;
     N1_ = N1;
     N2_ = N2;
     
@@ -218,12 +472,163 @@ h2Triplet::h2Triplet(const std::string& name, const std::string& labeltext,
         hReco->Sumw2();
     hCorr = new TH2D((name + "Corr").c_str(), ("DeepEfficiency-6D" + labeltext).c_str(), N1, minval1, maxval1, N2, minval2, maxval2);
         hCorr->Sumw2();   
+
+    xaxis_ = FastAxis(N1, minval1, maxval1);
+    yaxis_ = FastAxis(N2, minval2, maxval2);
+    native_ = (backend == BACKEND_NATIVE);
+    if (native_) {
+        fTrue.Init(N1, minval1, maxval1, N2, minval2, maxval2);
+        fReco.Init(N1, minval1, maxval1, N2, minval2, maxval2);
+        fCorr.Init(N1, minval1, maxval1, N2, minval2, maxval2);
+    }
+}
+
+void h2Triplet::EnableBootstrap(int R, uint64_t seed) {
+    if (R <= 0 || bCorr.Enabled()) {
+        return;
+    }
+    const int ncells = (N1_ + 2) * (N2_ + 2);
+    bReco.Init(ncells, R, seed);
+    bCorr.Init(ncells, R, seed);
+    hRecoBoot = NewBootHist(name_ + "RecoBoot", ncells, R);
+    hCorrBoot = NewBootHist(name_ + "CorrBoot", ncells, R);
+}
+
+void h2Triplet::SetModels(const std::vector<std::string>& labels) {
+    if (labels.size() < 2 || !hCorrModel.empty()) {
+        return;
+    }
+    models_ = labels;
+    for (size_t k = 1; k < labels.size(); ++k) {
+        TH2D* h = (TH2D*)hCorr->Clone((name_ + "Corr_" + labels[k]).c_str());
+        h->Reset();
+        h->SetTitle(("DeepEfficiency-6D " + labels[k] + labeltext_).c_str());
+        hCorrModel.push_back(h);
+        if (native_) {
+            fCorrModel.push_back(FastHist2D(N1_, xaxis_.min, xaxis_.max, N2_, yaxis_.min, yaxis_.max));
+        }
+    }
+    hCorr->SetTitle(("DeepEfficiency-6D " + labels[0] + labeltext_).c_str());
+}
+
+void h2Triplet::Sync() {
+    if (native_) {
+        fTrue.ToROOT(hTrue);
+        fReco.ToROOT(hReco);
+        fCorr.ToROOT(hCorr);
+        for (size_t k = 0; k < fCorrModel.size(); ++k) {
+            fCorrModel[k].ToROOT(hCorrModel[k]);
+        }
+    }
+    if (bCorr.Enabled()) {
+        BootToROOT(bReco, hRecoBoot);
+        BootToROOT(bCorr, hCorrBoot);
+    }
+}
+
+void h2Triplet::LoadBootstrap() {
+    if (bCorr.Enabled()) {
+        BootFromROOT(hRecoBoot, bReco);
+        BootFromROOT(hCorrBoot, bCorr);
+    }
+}
+
+void h2Triplet::FillBatch(size_t n, const double* x_gen, const double* y_gen,
+                          const double* x_rec, const double* y_rec,
+                          const unsigned char* reco, const double* weight,
+                          const double* poisson) {
+
+    const bool boot  = (poisson != nullptr && bCorr.Enabled());
+    const int stride = BootstrapStride(bCorr.GetNReplicas());
+
+    if (!native_) {
+        for (size_t i = 0; i < n; ++i) {
+            Fill(reco[i], x_gen[i], y_gen[i], x_rec[i], y_rec[i], weight[i]);
+        }
+        for (size_t i = 0; boot && i < n; ++i) {
+            if (reco[i]) {
+                const int cell = yaxis_.FindBin(y_rec[i]) * (N1_ + 2) + xaxis_.FindBin(x_rec[i]);
+                bReco.Fill(cell, poisson + i * stride, 1.0);
+                bCorr.Fill(cell, poisson + i * stride, weight[i]);
+            }
+        }
+        return;
+    }
+
+    int binx_gen[FILLSTRIDE];
+    int biny_gen[FILLSTRIDE];
+    int binx_rec[FILLSTRIDE];
+    int biny_rec[FILLSTRIDE];
+
+    for (size_t i0 = 0; i0 < n; i0 += FILLSTRIDE) {
+        const size_t m = std::min(FILLSTRIDE, n - i0);
+        const double* xg = x_gen + i0;
+        const double* yg = y_gen + i0;
+        const double* xr = x_rec + i0;
+        const double* yr = y_rec + i0;
+        const double* w  = weight + i0;
+        const unsigned char* r = reco + i0;
+
+        // Vectorized bin lookup
+        fTrue.GetXaxis().FindBins(m, xg, binx_gen);
+        fTrue.GetYaxis().FindBins(m, yg, biny_gen);
+        fReco.GetXaxis().FindBins(m, xr, binx_rec);
+        fReco.GetYaxis().FindBins(m, yr, biny_rec);
+
+        // Accumulate in event order
+        for (size_t j = 0; j < m; ++j) {
+            fTrue.FillBin(binx_gen[j], biny_gen[j], xg[j], yg[j], 1.0);
+            if (r[j]) {
+                fReco.FillBin(binx_rec[j], biny_rec[j], xr[j], yr[j], 1.0);
+                fCorr.FillBin(binx_rec[j], biny_rec[j], xr[j], yr[j], w[j]);
+                if (boot) {
+                    const int cell = biny_rec[j] * (N1_ + 2) + binx_rec[j];
+                    const double* p = poisson + (i0 + j) * stride;
+                    bReco.Fill(cell, p, 1.0);
+                    bCorr.Fill(cell, p, w[j]);
+                }
+            }
+        }
+    }
+}
+
+void h2Triplet::FillCorr(size_t k, size_t n, const double* x_rec, const double* y_rec,
+                         const unsigned char* reco, const double* weight) {
+
+    if (!native_) {
+        TH2D* h = hCorrModel[k - 1];
+        for (size_t i = 0; i < n; ++i) {
+            if (reco[i]) {
+                h->Fill(x_rec[i], y_rec[i], weight[i]);
+            }
+        }
+        return;
+    }
+
+    FastHist2D& f = fCorrModel[k - 1];
+    int binx_rec[FILLSTRIDE];
+    int biny_rec[FILLSTRIDE];
+
+    for (size_t i0 = 0; i0 < n; i0 += FILLSTRIDE) {
+        const size_t m = std::min(FILLSTRIDE, n - i0);
+        f.GetXaxis().FindBins(m, x_rec + i0, binx_rec);
+        f.GetYaxis().FindBins(m, y_rec + i0, biny_rec);
+        for (size_t j = 0; j < m; ++j) {
+            if (reco[i0 + j]) {
+                f.FillBin(binx_rec[j], biny_rec[j], x_rec[i0 + j], y_rec[i0 + j], weight[i0 + j]);
+            }
+        }
+    }
 }
 
 double h2Triplet::SaveFig() {
 
-    TCanvas c0("c", "c", 800, 525);
-    c0.Divide(3, 2, 0.01, 0.02);
+    Sync();
+
+    // Columns: generated, reconstructed and the corrected of each model
+    const int ncol = 2 + GetNModels();
+    TCanvas c0((name_ + "_c").c_str(), "c", 800 * ncol / 3, 525);
+    c0.Divide(ncol, 2, 0.01, 0.02);
 
     // Scale for normalization
     /*
@@ -247,35 +652,47 @@ double h2Triplet::SaveFig() {
         hReco->Draw("COLZ");
         hReco->GetYaxis()->SetTitleOffset(1.3);
         hReco->GetZaxis()->SetRangeUser(0.0, hTrue->GetMaximum());
-    c0.cd(3);
-        hCorr->SetStats(0);          // No statistics on upper plot
-        hCorr->Draw("COLZ");
-        hCorr->GetYaxis()->SetTitleOffset(1.3);
-        hCorr->GetZaxis()->SetRangeUser(0.0, hTrue->GetMaximum());
-
-    c0.cd(5);
-        TH2D* h5 = (TH2D*)hReco->Clone("h5");
+    for (size_t k = 0; k < GetNModels(); ++k) {
+        c0.cd(3 + k);
+        TH2D* h = GetCorr(k);
+        h->SetStats(0);          // No statistics on upper plot
+        h->Draw("COLZ");
+        h->GetYaxis()->SetTitleOffset(1.3);
+        h->GetZaxis()->SetRangeUser(0.0, hTrue->GetMaximum());
+    }
+
+    c0.cd(ncol + 2);
+        TH2D* h5 = (TH2D*)hReco->Clone((name_ + "_h5").c_str());
         h5->Divide(hTrue);
         h5->GetYaxis()->SetTitleOffset(1.3);
         h5->SetStats(0);          // No statistics on upper plot
         h5->Draw("COLZ");
         h5->GetZaxis()->SetRangeUser(0.0, 2.0);
         h5->SetTitle("Ratio: Reconstructed / Generated");
-    c0.cd(6);
-        TH2D* h6 = (TH2D*)hCorr->Clone("h6");
-        h6->Divide(hTrue);
-        h6->GetYaxis()->SetTitleOffset(1.3);
-        h6->SetStats(0);          // No statistics on upper plot
-        h6->Draw("COLZ");
-        h6->GetZaxis()->SetRangeUser(0.0, 2.0);
-        h6->SetTitle(Form("Ratio: DeepEfficiency-6D / Generated"));
+    std::vector<TH2D*> h6;
+    for (size_t k = 0; k < GetNModels(); ++k) {
+        c0.cd(ncol + 3 + k);
+        h6.push_back((TH2D*)GetCorr(k)->Clone((name_ + "_h6_" + std::to_string(k)).c_str()));
+        h6.back()->Divide(hTrue);
+        h6.back()->GetYaxis()->SetTitleOffset(1.3);
+        h6.back()->SetStats(0);  // No statistics on upper plot
+        h6.back()->Draw("COLZ");
+        h6.back()->GetZaxis()->SetRangeUser(0.0, 2.0);
+        if (models_.empty()) {
+            h6.back()->SetTitle(Form("Ratio: DeepEfficiency-6D / Generated"));
+        } else {
+            h6.back()->SetTitle(Form("Ratio: DeepEfficiency-6D %s / Generated", models_[k].c_str()));
+        }
+    }
 
     // Save pdf
     std::string fullfile = "./figs/" + name_ + ".pdf";
     c0.SaveAs(fullfile.c_str());
 
     delete h5;
-    delete h6;
+    for (size_t k = 0; k < h6.size(); ++k) {
+        delete h6[k];
+    }
 
     return 0.0;
 }
\ No newline at end of file
@@ -0,0 +1,333 @@
+// Binary DeepEfficiency weight files (.wgt), keyed by the event index
+// ------------------------------------------------------------------------
+
+
+// C++
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Own
+#include "weightstore.h"
+
+
+std::vector<std::string> FindWeightFiles(const std::string& sample, const std::string& path) {
+
+    std::vector<std::string> files;
+    std::error_code ec;
+    if (!std::filesystem::is_directory(path, ec)) {
+        return files;
+    }
+    const std::string full  = sample + ".wgt";
+    const std::string shard = sample + ".shard_";
+
+    for (const auto& entry : std::filesystem::directory_iterator(path, ec)) {
+        const std::string name = entry.path().filename().string();
+        if (name == full) {
+            files.push_back(entry.path().string());
+            continue;
+        }
+        // <sample>.shard_<digits>.wgt (not a sample with a longer name)
+        if (name.size() > shard.size() + 4 && name.compare(0, shard.size(), shard) == 0 &&
+            name.compare(name.size() - 4, 4, ".wgt") == 0) {
+            const std::string digits = name.substr(shard.size(), name.size() - shard.size() - 4);
+            if (std::all_of(digits.begin(), digits.end(), ::isdigit)) {
+                files.push_back(entry.path().string());
+            }
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    return files;
+}
+
+std::string WeightShardName(const std::string& sample, uint64_t first, const std::string& path) {
+    return path + sample + ".shard_" + std::to_string(first) + ".wgt";
+}
+
+
+// ------------------------------------------------------------------------
+// Writer
+
+bool WeightStoreWriter::Open(const std::string& filename, uint64_t samplehash, uint64_t modelid,
+                             bool indexed, uint64_t first) {
+
+    Abort();
+
+    filename_ = filename;
+    const std::string tmpfile = filename + ".tmp";
+    if ((fp_ = fopen(tmpfile.c_str(), "wb")) == NULL) {
+        printf("WeightStoreWriter:: Cannot open output file: %s \n", tmpfile.c_str());
+        return false;
+    }
+
+    std::memset(&header_, 0, sizeof(WeightFileHeader));
+    std::memcpy(header_.magic, WGT_MAGIC, sizeof(WGT_MAGIC));
+    header_.version    = WGT_VERSION;
+    header_.flags      = indexed ? WGT_INDEXED : 0;
+    header_.samplehash = samplehash;
+    header_.modelid    = modelid;
+    header_.first      = indexed ? 0 : first;
+
+    // Preliminary header, the event count is patched at close
+    if (fwrite(&header_, sizeof(WeightFileHeader), 1, fp_) != 1) {
+        printf("WeightStoreWriter:: Error writing header: %s \n", tmpfile.c_str());
+        Abort();
+        return false;
+    }
+    error_ = false;
+    last_  = 0;
+
+    return true;
+}
+
+bool WeightStoreWriter::Write(const float* weight, size_t n) {
+
+    if (fp_ == nullptr || error_ || (header_.flags & WGT_INDEXED)) {
+        return false;
+    }
+    if (fwrite(weight, sizeof(float), n, fp_) != n) {
+        printf("WeightStoreWriter:: Error writing: %s \n", filename_.c_str());
+        error_ = true;
+        return false;
+    }
+    header_.nevents += n;
+
+    return true;
+}
+
+bool WeightStoreWriter::Write(uint64_t index, float weight) {
+
+    if (fp_ == nullptr || error_ || !(header_.flags & WGT_INDEXED)) {
+        return false;
+    }
+    if (header_.nevents > 0 && index <= last_) {
+        printf("WeightStoreWriter:: Event index %lu after %lu (must increase) \n",
+               (unsigned long)index, (unsigned long)last_);
+        error_ = true;
+        return false;
+    }
+    WeightRecord record;
+    record.index    = index;
+    record.weight   = weight;
+    record.reserved = 0;
+    if (fwrite(&record, sizeof(WeightRecord), 1, fp_) != 1) {
+        printf("WeightStoreWriter:: Error writing: %s \n", filename_.c_str());
+        error_ = true;
+        return false;
+    }
+    last_ = index;
+    ++header_.nevents;
+
+    return true;
+}
+
+bool WeightStoreWriter::Close() {
+
+    if (fp_ == nullptr) {
+        return false;
+    }
+    if (!error_ && (fseek(fp_, 0, SEEK_SET) != 0 || fwrite(&header_, sizeof(WeightFileHeader), 1, fp_) != 1)) {
+        printf("WeightStoreWriter:: Error finalizing header \n");
+        error_ = true;
+    }
+    const bool closed = (fclose(fp_) == 0);
+    fp_ = nullptr;
+
+    const std::string tmpfile = filename_ + ".tmp";
+    if (error_ || !closed || std::rename(tmpfile.c_str(), filename_.c_str()) != 0) {
+        std::remove(tmpfile.c_str());
+        return false;
+    }
+    return true;
+}
+
+void WeightStoreWriter::Abort() {
+    if (fp_ != nullptr) {
+        fclose(fp_);
+        fp_ = nullptr;
+        std::remove((filename_ + ".tmp").c_str());
+    }
+}
+
+
+// ------------------------------------------------------------------------
+// Reader
+
+bool WeightStoreReader::Open(const std::vector<std::string>& filenames) {
+
+    Close();
+
+    for (size_t k = 0; k < filenames.size(); ++k) {
+        std::unique_ptr<Part> p(new Part());
+        const std::string& filename = filenames[k];
+
+        if (!p->file.Open(filename) || p->file.Size() < sizeof(WeightFileHeader)) {
+            printf("WeightStoreReader:: Cannot open weight file: %s \n", filename.c_str());
+            Close();
+            return false;
+        }
+        std::memcpy(&p->header, p->file.Data(), sizeof(WeightFileHeader));
+        const WeightFileHeader& h = p->header;
+        if (std::memcmp(h.magic, WGT_MAGIC, sizeof(WGT_MAGIC)) != 0 || h.version > WGT_VERSION) {
+            printf("WeightStoreReader:: Not a weight file or unsupported version: %s \n", filename.c_str());
+            Close();
+            return false;
+        }
+        const bool indexed = (h.flags & WGT_INDEXED);
+        const uint64_t recsize = indexed ? sizeof(WeightRecord) : sizeof(float);
+        if (p->file.Size() != sizeof(WeightFileHeader) + h.nevents * recsize) {
+            printf("WeightStoreReader:: Truncated or unfinished weight file: %s \n", filename.c_str());
+            Close();
+            return false;
+        }
+        if (h.nevents == 0) {
+            continue;
+        }
+
+        // Event range, indices of indexed files must increase
+        if (indexed) {
+            const char* data = p->file.Data() + sizeof(WeightFileHeader);
+            WeightRecord prev;
+            std::memcpy(&prev, data, sizeof(WeightRecord));
+            p->first = prev.index;
+            for (uint64_t i = 1; i < h.nevents; ++i) {
+                WeightRecord rec;
+                std::memcpy(&rec, data + i * sizeof(WeightRecord), sizeof(WeightRecord));
+                if (rec.index <= prev.index) {
+                    printf("WeightStoreReader:: Event indices not increasing at record %lu: %s \n",
+                           (unsigned long)i, filename.c_str());
+                    Close();
+                    return false;
+                }
+                prev = rec;
+            }
+            p->last = prev.index;
+        } else {
+            p->first = h.first;
+            p->last  = h.first + h.nevents - 1;
+        }
+        nentries_ += h.nevents;
+        parts_.push_back(std::move(p));
+    }
+
+    // Files in event order, without overlaps
+    std::sort(parts_.begin(), parts_.end(),
+              [](const std::unique_ptr<Part>& a, const std::unique_ptr<Part>& b) { return a->first < b->first; });
+    for (size_t k = 1; k < parts_.size(); ++k) {
+        if (parts_[k]->first <= parts_[k - 1]->last) {
+            printf("WeightStoreReader:: Weight files overlap at event %lu: %s, %s \n", (unsigned long)parts_[k]->first,
+                   parts_[k - 1]->file.GetFilename().c_str(), parts_[k]->file.GetFilename().c_str());
+            Close();
+            return false;
+        }
+    }
+    offset_ = parts_.empty() ? 0 : sizeof(WeightFileHeader);
+
+    return true;
+}
+
+void WeightStoreReader::Close() {
+    parts_.clear();
+    part_       = 0;
+    nentries_   = 0;
+    nunmatched_ = 0;
+    offset_     = 0;
+    base_       = 0;
+}
+
+bool WeightStoreReader::HasSampleHash() const {
+    for (size_t k = 0; k < parts_.size(); ++k) {
+        if (parts_[k]->header.samplehash != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool WeightStoreReader::CheckSample(uint64_t hash, const std::string& kinematicsfile) const {
+
+    for (size_t k = 0; k < parts_.size(); ++k) {
+        const WeightFileHeader& h = parts_[k]->header;
+        if (h.samplehash == 0) {
+            continue;
+        }
+        if (hash == 0) {
+            return false;
+        }
+        if (h.samplehash != hash) {
+            printf("WeightStoreReader:: %s was predicted for other kinematics than: %s \n",
+                   parts_[k]->file.GetFilename().c_str(), kinematicsfile.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t WeightStoreReader::Join(uint64_t first, size_t n, double* weight, unsigned char* found) {
+
+    std::fill(found, found + n, 0);
+    const uint64_t end = first + n;
+    size_t nfound = 0;
+
+    while (part_ < parts_.size()) {
+        Part& p = *parts_[part_];
+        const WeightFileHeader& h = p.header;
+        const char* data = p.file.Data() + sizeof(WeightFileHeader);
+
+        if (h.flags & WGT_INDEXED) {
+            for (; p.pos < h.nevents; ++p.pos) {
+                WeightRecord rec;
+                std::memcpy(&rec, data + p.pos * sizeof(WeightRecord), sizeof(WeightRecord));
+                if (rec.index >= end) {
+                    break;
+                }
+                if (rec.index < first) {
+                    ++nunmatched_;
+                    continue;
+                }
+                weight[rec.index - first] = rec.weight;
+                found[rec.index - first]  = 1;
+                ++nfound;
+            }
+        } else {
+            const float* w = reinterpret_cast<const float*>(data);
+            const uint64_t pend = p.first + h.nevents;
+            uint64_t cur = p.first + p.pos;
+            if (cur < first) {
+                const uint64_t skip = std::min(first, pend) - cur;
+                nunmatched_ += skip;
+                cur += skip;
+            }
+            const uint64_t hi = std::min(end, pend);
+            for (uint64_t i = cur; i < hi; ++i) {
+                weight[i - first] = w[i - p.first];
+                found[i - first]  = 1;
+            }
+            if (hi > cur) {
+                nfound += hi - cur;
+                cur = hi;
+            }
+            p.pos = cur - p.first;
+        }
+
+        const uint64_t recsize = (h.flags & WGT_INDEXED) ? sizeof(WeightRecord) : sizeof(float);
+        if (p.pos < h.nevents) {
+            offset_ = base_ + sizeof(WeightFileHeader) + p.pos * recsize;
+            p.file.Consumed(sizeof(WeightFileHeader) + p.pos * recsize);
+            break;
+        }
+
+        // File done
+        base_  += p.file.Size();
+        offset_ = base_;
+        p.file.Close();
+        ++part_;
+    }
+
+    return nfound;
+}
@@ -9,3 +9,6 @@ python3 deepnet.py train $MODEL
 # K+K-
 MODEL=tree2track_kKpkm
 python3 deepnet.py train $MODEL
+
+# Or natively without TensorFlow (writes ./modelsave/DEEPNET_$MODEL.mlp for deeplot --mlp)
+# make deeptrain && ./deeptrain -t 16 $MODEL